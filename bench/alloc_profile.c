@@ -0,0 +1,574 @@
+/** alloc_profile.c
+  *
+  * Profiles heap usage of the `getline` family and checks it against
+  * budgets.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+/* Build (from the repository root):
+ *
+ *     cc -O2 -DNDEBUG -o bench/alloc_profile bench/alloc_profile.c \
+ *        bench/bench_corpus.c bench/bench_getline.c bench/bench_getwline.c \
+ *        bench/bench_ggets.c
+ *
+ * Usage:
+ *
+ *     bench/alloc_profile [corpus size in MiB]
+ *
+ * For each corpus and function, reports allocation calls, bytes requested,
+ * bytes copied by `realloc`, and peak live heap.  Exits with a failure
+ * status if any budget in `budgets` is exceeded, so it can be run as a
+ * regression check.  The budgets assume a build with `NDEBUG` defined;
+ * debug builds deliberately start with tiny buffers.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+/* Declare the library's renamed entry points (see bench_library.h). */
+#define getline compat_getline
+#define getdelim compat_getdelim
+#include "../getline.h"
+#include "../getwline.h"
+#include "../ggets.h"
+#undef getline
+#undef getdelim
+
+#include "bench_corpus.h"
+
+#if __STDC_VERSION__ >= 199901L
+    #include <stdbool.h>
+#else
+    typedef enum { false, true } bool;
+#endif
+
+#define ARRAY_LENGTH(a) (sizeof (a) / sizeof *(a))
+
+enum
+{
+    defaultCorpusMiB = 4,
+    stackBufferSize = 256
+};
+
+
+/** AllocationStats
+  *
+  *     Counters maintained by the allocation hooks.
+  */
+typedef struct
+{
+    unsigned long mallocCalls;
+    unsigned long reallocCalls;
+    size_t bytesRequested;
+
+    /* Bytes moved by `realloc` calls that returned a different block. */
+    size_t bytesCopied;
+
+    size_t liveBytes;
+    size_t peakLiveBytes;
+} AllocationStats;
+
+static AllocationStats stats;
+
+
+/* Precedes each allocated block to record its size.  The union keeps the
+ * caller's block suitably aligned.
+ */
+typedef union
+{
+    size_t size;
+    long double alignLongDouble;
+    void* alignPointer;
+    long alignLong;
+} BlockHeader;
+
+
+static void
+add_live_bytes(size_t size)
+{
+    stats.liveBytes += size;
+    if (stats.liveBytes > stats.peakLiveBytes)
+    {
+        stats.peakLiveBytes = stats.liveBytes;
+    }
+}
+
+
+void*
+bench_malloc(size_t size)
+{
+    BlockHeader* header;
+
+    stats.mallocCalls++;
+    stats.bytesRequested += size;
+
+    header = malloc(sizeof *header + size);
+    if (header == NULL)
+    {
+        return NULL;
+    }
+    header->size = size;
+    add_live_bytes(size);
+    return header + 1;
+}
+
+
+void*
+bench_realloc(void* p, size_t size)
+{
+    BlockHeader* oldHeader;
+    BlockHeader* newHeader;
+    size_t oldSize;
+
+    if (p == NULL)
+    {
+        /* Count this as a `realloc` call, not a `malloc` call. */
+        void* q = bench_malloc(size);
+        stats.mallocCalls--;
+        stats.reallocCalls++;
+        return q;
+    }
+
+    stats.reallocCalls++;
+    stats.bytesRequested += size;
+
+    oldHeader = (BlockHeader*) p - 1;
+    oldSize = oldHeader->size;
+
+    newHeader = realloc(oldHeader, sizeof *newHeader + size);
+    if (newHeader == NULL)
+    {
+        return NULL;
+    }
+
+    if (newHeader != oldHeader)
+    {
+        stats.bytesCopied += (oldSize < size) ? oldSize : size;
+    }
+    newHeader->size = size;
+
+    stats.liveBytes -= oldSize;
+    add_live_bytes(size);
+    return newHeader + 1;
+}
+
+
+void
+bench_free(void* p)
+{
+    BlockHeader* header;
+    if (p == NULL)
+    {
+        return;
+    }
+    header = (BlockHeader*) p - 1;
+    stats.liveBytes -= header->size;
+    free(header);
+}
+
+
+/** Reader
+  *
+  *     A function to profile.  Reads all of `fp` and returns the number of
+  *     lines read.  All memory must be freed before returning.
+  */
+typedef struct
+{
+    const char* name;
+    size_t (*read)(FILE* fp, int delimiter);
+
+    /* Whether the function reads lines delimited by the corpus's delimiter
+     * rather than always by LF.
+     */
+    bool usesDelimiter;
+
+    bool wide;
+} Reader;
+
+
+static size_t
+read_getline(FILE* fp, int delimiter)
+{
+    char* line = NULL;
+    size_t size = 0;
+    size_t numLines = 0;
+    (void) delimiter;
+    while (compat_getline(&line, &size, fp) >= 0)
+    {
+        numLines++;
+    }
+    bench_free(line);
+    return numLines;
+}
+
+
+static size_t
+read_getdelim(FILE* fp, int delimiter)
+{
+    char* line = NULL;
+    size_t size = 0;
+    size_t numLines = 0;
+    while (compat_getdelim(&line, &size, delimiter, fp) >= 0)
+    {
+        numLines++;
+    }
+    bench_free(line);
+    return numLines;
+}
+
+
+static size_t
+read_getdelim_sb(FILE* fp, int delimiter)
+{
+    char stackBuffer[stackBufferSize];
+    char* line = NULL;
+    size_t size = 0;
+    size_t numLines = 0;
+    while (getdelim_sb(&line, &size, delimiter,
+                       stackBuffer, sizeof stackBuffer, fp) >= 0)
+    {
+        numLines++;
+    }
+    if (line != stackBuffer)
+    {
+        bench_free(line);
+    }
+    return numLines;
+}
+
+
+static size_t
+read_getline_univ(FILE* fp, int delimiter)
+{
+    char* line = NULL;
+    size_t size = 0;
+    size_t numLines = 0;
+    (void) delimiter;
+    while (getline_univ(&line, &size, fp) >= 0)
+    {
+        numLines++;
+    }
+    bench_free(line);
+    return numLines;
+}
+
+
+static size_t
+read_fggets(FILE* fp, int delimiter)
+{
+    char* line;
+    size_t numLines = 0;
+    (void) delimiter;
+    while (fggets(&line, fp) == 0)
+    {
+        numLines++;
+        bench_free(line);
+    }
+    return numLines;
+}
+
+
+static size_t
+read_fggets_univ(FILE* fp, int delimiter)
+{
+    char* line;
+    size_t numLines = 0;
+    (void) delimiter;
+    while (fggets_univ(&line, fp) == 0)
+    {
+        numLines++;
+        bench_free(line);
+    }
+    return numLines;
+}
+
+
+static size_t
+read_getwline(FILE* fp, int delimiter)
+{
+    wchar_t* line = NULL;
+    size_t size = 0;
+    size_t numLines = 0;
+    (void) delimiter;
+    while (getwline(&line, &size, fp) >= 0)
+    {
+        numLines++;
+    }
+    bench_free(line);
+    return numLines;
+}
+
+
+/** Budget
+  *
+  *     Limits for a function, applied to every corpus.  Tighten these when an
+  *     improvement lands so that later regressions are caught.
+  */
+typedef struct
+{
+    const char* name;
+
+    /* Calls to `malloc` and `realloc` per line, not counting the calls
+     * expected to grow a single buffer to the longest line (see
+     * `growth_allocations`).
+     */
+    double maxAllocationsPerLine;
+
+    /* Bytes copied by `realloc` per byte of input. */
+    double maxCopiedPerInputByte;
+
+    /* Peak live heap, as a multiple of the longest line (in bytes, or in
+     * `wchar_t`s for `getwline`), plus a fixed allowance for the initial
+     * buffer.
+     */
+    double maxPeakPerLongestLine;
+    size_t peakAllowance;
+} Budget;
+
+static const Budget budgets[] =
+{
+    { "getline", 0.1, 0.1, 2.0, 1024 },
+    { "getdelim", 0.1, 0.1, 2.0, 1024 },
+    { "getdelim_sb", 0.1, 0.1, 2.0, 1024 },
+    { "getline_univ", 0.1, 0.1, 2.0, 1024 },
+    { "fggets", 12.0, 1.5, 2.0, 1024 },
+    { "fggets_univ", 12.0, 1.5, 2.0, 1024 },
+    { "getwline", 0.1, 0.1, 2.0 * sizeof (wchar_t), 1024 * sizeof (wchar_t) },
+};
+
+
+static const Budget*
+find_budget(const char* name)
+{
+    size_t i;
+    for (i = 0; i < ARRAY_LENGTH(budgets); i++)
+    {
+        if (strcmp(budgets[i].name, name) == 0)
+        {
+            return &budgets[i];
+        }
+    }
+    return NULL;
+}
+
+
+/** growth_allocations
+  *
+  *     Returns the number of allocations needed to grow a buffer, starting
+  *     with a 1-byte `malloc` and doubling with `realloc`, to hold a line of
+  *     `longestLine` units and a terminator.  Buffers start larger than that,
+  *     so this is an upper bound that does not depend on the size of the
+  *     corpus.
+  */
+static unsigned long
+growth_allocations(size_t longestLine)
+{
+    unsigned long count = 1;
+    size_t capacity = 1;
+    while (capacity < longestLine + 1 && capacity <= (size_t) -1 / 2)
+    {
+        capacity *= 2;
+        count++;
+    }
+    return count;
+}
+
+
+/** profile
+  *
+  *     Runs `reader` over `corpus`, reports its allocation statistics, and
+  *     checks them against its budget.
+  *
+  * RETURNS:
+  *     Returns false if the run failed or exceeded its budget.
+  */
+static bool
+profile(const Reader* reader, const Corpus* corpus, size_t corpusSize)
+{
+    const Budget* budget = find_budget(reader->name);
+    size_t numLines;
+    double allocationsPerLine;
+    double excessAllocationsPerLine;
+    unsigned long growthAllocations;
+    unsigned long numAllocations;
+    double copiedPerInputByte;
+    double peakLimit;
+    bool withinBudget = true;
+    FILE* fp = fopen(corpus->path, "rb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Failed to open \"%s\".\n", corpus->path);
+        return false;
+    }
+
+    memset(&stats, 0, sizeof stats);
+    numLines = reader->read(fp, corpus->delimiter);
+    fclose(fp);
+
+    if (numLines == 0)
+    {
+        fprintf(stderr, "%s read no lines from \"%s\".\n",
+                reader->name, corpus->path);
+        return false;
+    }
+    if (stats.liveBytes != 0)
+    {
+        fprintf(stderr, "%s leaked %lu bytes.\n",
+                reader->name, (unsigned long) stats.liveBytes);
+        return false;
+    }
+
+    numAllocations = stats.mallocCalls + stats.reallocCalls;
+    allocationsPerLine = (double) numAllocations / (double) numLines;
+
+    /* A corpus of a few long lines would otherwise exceed a per-line budget
+     * just by growing the buffer once.
+     */
+    growthAllocations = growth_allocations(corpus->longestLine);
+    excessAllocationsPerLine =
+          (numAllocations > growthAllocations)
+        ? (double) (numAllocations - growthAllocations) / (double) numLines
+        : 0.0;
+    copiedPerInputByte = (double) stats.bytesCopied / (double) corpusSize;
+
+    printf("%-8s %-14s %10.4f %10.4f %12.1f %12.1f %10lu",
+           corpus->name, reader->name,
+           allocationsPerLine,
+           (double) stats.reallocCalls / (double) numLines,
+           (double) stats.bytesRequested / (double) numLines,
+           (double) stats.bytesCopied / (double) numLines,
+           (unsigned long) stats.peakLiveBytes);
+
+    if (budget != NULL)
+    {
+        peakLimit =   budget->maxPeakPerLongestLine
+                    * (double) corpus->longestLine
+                    + (double) budget->peakAllowance;
+        if (excessAllocationsPerLine > budget->maxAllocationsPerLine)
+        {
+            printf("  OVER BUDGET: allocations/line beyond growth %g > %g",
+                   excessAllocationsPerLine, budget->maxAllocationsPerLine);
+            withinBudget = false;
+        }
+        if (copiedPerInputByte > budget->maxCopiedPerInputByte)
+        {
+            printf("  OVER BUDGET: copied/input byte %g > %g",
+                   copiedPerInputByte, budget->maxCopiedPerInputByte);
+            withinBudget = false;
+        }
+        if ((double) stats.peakLiveBytes > peakLimit)
+        {
+            printf("  OVER BUDGET: peak > %.0f", peakLimit);
+            withinBudget = false;
+        }
+    }
+    printf("\n");
+    return withinBudget;
+}
+
+
+int
+main(int argc, char** argv)
+{
+    bool success = true;
+    size_t corpusSize = (size_t) defaultCorpusMiB * 1024 * 1024;
+    bool haveUtf8;
+    size_t i;
+    size_t j;
+
+    static const Reader readers[] =
+    {
+        { "getline", read_getline, false, false },
+        { "getdelim", read_getdelim, true, false },
+        { "getdelim_sb", read_getdelim_sb, true, false },
+        { "getline_univ", read_getline_univ, false, false },
+        { "fggets", read_fggets, false, false },
+        { "fggets_univ", read_fggets_univ, false, false },
+        { "getwline", read_getwline, false, true },
+    };
+
+    if (argc > 1)
+    {
+        long mebibytes = strtol(argv[1], NULL, 10);
+        if (mebibytes <= 0)
+        {
+            fprintf(stderr, "Usage: %s [corpus size in MiB]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        corpusSize = (size_t) mebibytes * 1024 * 1024;
+    }
+
+#ifndef NDEBUG
+    fprintf(stderr,
+            "Warning: NDEBUG is not defined, so budgets may be exceeded.\n");
+#endif
+
+    haveUtf8 =    setlocale(LC_CTYPE, "C.UTF-8") != NULL
+               || setlocale(LC_CTYPE, "en_US.UTF-8") != NULL;
+
+    printf("%-8s %-14s %10s %10s %12s %12s %10s\n",
+           "corpus", "function", "allocs/ln", "reallocs/ln",
+           "requested/ln", "copied/ln", "peak");
+
+    for (i = 0; i < numBenchCorpora; i++)
+    {
+        Corpus* corpus = &benchCorpora[i];
+        if (!bench_generate_corpus(corpus, corpusSize))
+        {
+            success = false;
+            break;
+        }
+
+        for (j = 0; j < ARRAY_LENGTH(readers); j++)
+        {
+            const Reader* reader = &readers[j];
+            if (reader->wide && !(corpus->wide && haveUtf8))
+            {
+                continue;
+            }
+
+            /* `longestLine` is measured using the corpus's delimiter. */
+            if (corpus->delimiter != '\n' && !reader->usesDelimiter)
+            {
+                continue;
+            }
+            success &= profile(reader, corpus, corpusSize);
+        }
+
+        remove(corpus->path);
+    }
+
+    if (!success)
+    {
+        fprintf(stderr, "Allocation budgets were exceeded.\n");
+    }
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,433 @@
+/** bench.c
+  *
+  * Benchmarks for the `getline` family of functions.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+/* Build (from the repository root):
+ *
+ *     cc -O2 -DNDEBUG -o bench/bench bench/bench.c bench/bench_corpus.c \
+ *        bench/bench_getline.c bench/bench_getwline.c bench/bench_ggets.c
+ *
+ * Usage:
+ *
+ *     bench/bench [corpus size in MiB]
+ *
+ * Results are printed and written to bench_output.txt in the current
+ * directory.  Corpora are generated deterministically, so results are
+ * comparable across runs and library versions.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wchar.h>
+
+/* Declare the library's renamed entry points (see bench_library.h). */
+#define getline compat_getline
+#define getdelim compat_getdelim
+#include "../getline.h"
+#include "../getwline.h"
+#include "../ggets.h"
+#undef getline
+#undef getdelim
+
+#include "bench_corpus.h"
+
+#if __STDC_VERSION__ >= 199901L
+    #include <stdbool.h>
+#else
+    typedef enum { false, true } bool;
+#endif
+
+#define ARRAY_LENGTH(a) (sizeof (a) / sizeof *(a))
+
+enum
+{
+    defaultCorpusMiB = 32,
+    repetitions = 3,
+    fgetsBufferSize = 4096
+};
+
+
+static unsigned long allocationCount;
+
+
+void*
+bench_malloc(size_t size)
+{
+    allocationCount++;
+    return malloc(size);
+}
+
+
+void*
+bench_realloc(void* p, size_t size)
+{
+    allocationCount++;
+    return realloc(p, size);
+}
+
+
+void
+bench_free(void* p)
+{
+    free(p);
+}
+
+
+/** Reader
+  *
+  *     A function to benchmark.  Reads all of `fp` and returns the number of
+  *     lines read and the number of bytes returned.
+  */
+typedef struct
+{
+    const char* name;
+    void (*read)(FILE* fp, int delimiter, size_t* numLines, size_t* numBytes);
+
+    /* Whether allocations can be counted.  Allocations within the C library
+     * cannot be.
+     */
+    bool counted;
+
+    bool wide;
+} Reader;
+
+
+static void
+read_getline(FILE* fp, int delimiter, size_t* numLines, size_t* numBytes)
+{
+    char* line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    (void) delimiter;
+    while ((length = compat_getline(&line, &size, fp)) >= 0)
+    {
+        (*numLines)++;
+        *numBytes += (size_t) length;
+    }
+    bench_free(line);
+}
+
+
+static void
+read_getdelim(FILE* fp, int delimiter, size_t* numLines, size_t* numBytes)
+{
+    char* line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    while ((length = compat_getdelim(&line, &size, delimiter, fp)) >= 0)
+    {
+        (*numLines)++;
+        *numBytes += (size_t) length;
+    }
+    bench_free(line);
+}
+
+
+static void
+read_getline_univ(FILE* fp, int delimiter, size_t* numLines,
+                  size_t* numBytes)
+{
+    char* line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    (void) delimiter;
+    while ((length = getline_univ(&line, &size, fp)) >= 0)
+    {
+        (*numLines)++;
+        *numBytes += (size_t) length;
+    }
+    bench_free(line);
+}
+
+
+static void
+read_fggets(FILE* fp, int delimiter, size_t* numLines, size_t* numBytes)
+{
+    char* line;
+    (void) delimiter;
+    while (fggets(&line, fp) == 0)
+    {
+        (*numLines)++;
+        *numBytes += strlen(line);
+        bench_free(line);
+    }
+}
+
+
+static void
+read_fggets_univ(FILE* fp, int delimiter, size_t* numLines,
+                 size_t* numBytes)
+{
+    char* line;
+    (void) delimiter;
+    while (fggets_univ(&line, fp) == 0)
+    {
+        (*numLines)++;
+        *numBytes += strlen(line);
+        bench_free(line);
+    }
+}
+
+
+static void
+read_getwline(FILE* fp, int delimiter, size_t* numLines, size_t* numBytes)
+{
+    wchar_t* line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    (void) delimiter;
+    while ((length = getwline(&line, &size, fp)) >= 0)
+    {
+        (*numLines)++;
+        *numBytes += (size_t) length * sizeof *line;
+    }
+    bench_free(line);
+}
+
+
+static void
+read_native_getline(FILE* fp, int delimiter, size_t* numLines,
+                    size_t* numBytes)
+{
+    char* line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    (void) delimiter;
+    while ((length = getline(&line, &size, fp)) >= 0)
+    {
+        (*numLines)++;
+        *numBytes += (size_t) length;
+    }
+    free(line);
+}
+
+
+static void
+read_native_getdelim(FILE* fp, int delimiter, size_t* numLines,
+                     size_t* numBytes)
+{
+    char* line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    while ((length = getdelim(&line, &size, delimiter, fp)) >= 0)
+    {
+        (*numLines)++;
+        *numBytes += (size_t) length;
+    }
+    free(line);
+}
+
+
+static void
+read_native_fgets(FILE* fp, int delimiter, size_t* numLines,
+                  size_t* numBytes)
+{
+    /* Lines longer than the buffer are counted once per call. */
+    char buffer[fgetsBufferSize];
+    (void) delimiter;
+    while (fgets(buffer, sizeof buffer, fp) != NULL)
+    {
+        (*numLines)++;
+        *numBytes += strlen(buffer);
+    }
+}
+
+
+static double
+now_seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec + (double) t.tv_nsec / 1e9;
+}
+
+
+/** run
+  *
+  *     Runs `reader` over `corpus` several times and reports the fastest run.
+  */
+static bool
+run(const Reader* reader, const Corpus* corpus, FILE* output)
+{
+    double bestSeconds = 0;
+    size_t numLines = 0;
+    size_t numBytes = 0;
+    unsigned long allocations = 0;
+    char line[128];
+    int i;
+
+    for (i = 0; i < repetitions; i++)
+    {
+        double start;
+        double seconds;
+        FILE* fp = fopen(corpus->path, "rb");
+        if (fp == NULL)
+        {
+            fprintf(stderr, "Failed to open \"%s\".\n", corpus->path);
+            return false;
+        }
+
+        numLines = 0;
+        numBytes = 0;
+        allocationCount = 0;
+
+        start = now_seconds();
+        reader->read(fp, corpus->delimiter, &numLines, &numBytes);
+        seconds = now_seconds() - start;
+
+        allocations = allocationCount;
+        fclose(fp);
+
+        if (i == 0 || seconds < bestSeconds)
+        {
+            bestSeconds = seconds;
+        }
+    }
+
+    if (bestSeconds <= 0)
+    {
+        bestSeconds = 1e-9;
+    }
+
+    if (reader->counted && numLines > 0)
+    {
+        sprintf(line, "%-8s %-18s %14.0f %8.3f %12.4f\n",
+                corpus->name, reader->name,
+                (double) numLines / bestSeconds,
+                (double) numBytes / bestSeconds / 1e9,
+                (double) allocations / (double) numLines);
+    }
+    else
+    {
+        sprintf(line, "%-8s %-18s %14.0f %8.3f %12s\n",
+                corpus->name, reader->name,
+                (double) numLines / bestSeconds,
+                (double) numBytes / bestSeconds / 1e9,
+                "-");
+    }
+
+    fputs(line, stdout);
+    fputs(line, output);
+    fflush(stdout);
+    return true;
+}
+
+
+int
+main(int argc, char** argv)
+{
+    bool success = true;
+    size_t corpusSize = (size_t) defaultCorpusMiB * 1024 * 1024;
+    bool haveUtf8;
+    FILE* output;
+    char header[128];
+    size_t i;
+    size_t j;
+
+    static const Reader readers[] =
+    {
+        { "getline", read_getline, true, false },
+        { "getdelim", read_getdelim, true, false },
+        { "getline_univ", read_getline_univ, true, false },
+        { "fggets", read_fggets, true, false },
+        { "fggets_univ", read_fggets_univ, true, false },
+        { "getwline", read_getwline, true, true },
+        { "native getline", read_native_getline, false, false },
+        { "native getdelim", read_native_getdelim, false, false },
+        { "native fgets", read_native_fgets, false, false },
+    };
+
+    if (argc > 1)
+    {
+        long mebibytes = strtol(argv[1], NULL, 10);
+        if (mebibytes <= 0)
+        {
+            fprintf(stderr, "Usage: %s [corpus size in MiB]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        corpusSize = (size_t) mebibytes * 1024 * 1024;
+    }
+
+    haveUtf8 =    setlocale(LC_CTYPE, "C.UTF-8") != NULL
+               || setlocale(LC_CTYPE, "en_US.UTF-8") != NULL;
+    if (!haveUtf8)
+    {
+        fprintf(stderr, "No UTF-8 locale is available; skipping getwline.\n");
+    }
+
+    output = fopen("bench_output.txt", "w");
+    if (output == NULL)
+    {
+        fprintf(stderr, "Failed to create bench_output.txt.\n");
+        return EXIT_FAILURE;
+    }
+
+    sprintf(header, "# corpus size: %lu bytes, best of %d runs\n",
+            (unsigned long) corpusSize, (int) repetitions);
+    fputs(header, stdout);
+    fputs(header, output);
+    sprintf(header, "%-8s %-18s %14s %8s %12s\n",
+            "corpus", "function", "lines/s", "GB/s", "allocs/line");
+    fputs(header, stdout);
+    fputs(header, output);
+
+    for (i = 0; i < numBenchCorpora && success; i++)
+    {
+        Corpus* corpus = &benchCorpora[i];
+        if (!bench_generate_corpus(corpus, corpusSize))
+        {
+            success = false;
+            break;
+        }
+
+        for (j = 0; j < ARRAY_LENGTH(readers) && success; j++)
+        {
+            const Reader* reader = &readers[j];
+            if (reader->wide && !(corpus->wide && haveUtf8))
+            {
+                continue;
+            }
+            success &= run(reader, corpus, output);
+        }
+
+        remove(corpus->path);
+    }
+
+    if (fclose(output) != 0)
+    {
+        fprintf(stderr, "Failed to write bench_output.txt.\n");
+        success = false;
+    }
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
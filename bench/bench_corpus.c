@@ -0,0 +1,194 @@
+/** bench_corpus.c
+  *
+  * Deterministic corpora for the benchmarks.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#include "bench_corpus.h"
+
+#include <string.h>
+
+#define ARRAY_LENGTH(a) (sizeof (a) / sizeof *(a))
+
+
+/** next_random
+  *
+  *     A linear congruential generator, so that corpora do not depend on the
+  *     C library's `rand`.
+  */
+static unsigned long
+next_random(unsigned long* state)
+{
+    *state = (*state * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+    return *state >> 8;
+}
+
+
+
+
+static size_t
+write_ascii(FILE* fp, unsigned long* state, size_t length)
+{
+    size_t i;
+    for (i = 0; i < length; i++)
+    {
+        fputc((int) (' ' + next_random(state) % 95), fp);
+    }
+    return length;
+}
+
+
+static size_t
+write_short_line(FILE* fp, unsigned long* state)
+{
+    size_t length = write_ascii(fp, state, next_random(state) % 40);
+    fputc('\n', fp);
+    return length + 1;
+}
+
+
+static size_t
+write_long_line(FILE* fp, unsigned long* state)
+{
+    size_t length = write_ascii(fp, state,
+                                1024 + next_random(state) % (63 * 1024));
+    fputc('\n', fp);
+    return length + 1;
+}
+
+
+static size_t
+write_mixed_line(FILE* fp, unsigned long* state)
+{
+    size_t length = (next_random(state) % 100 < 90)
+                    ? next_random(state) % 80
+                    : 1024 + next_random(state) % (15 * 1024);
+    length = write_ascii(fp, state, length);
+    fputc('\n', fp);
+    return length + 1;
+}
+
+
+static size_t
+write_mixed_ending_line(FILE* fp, unsigned long* state)
+{
+    static const char* lineEndings[] = { "\n", "\r", "\r\n" };
+    const char* lineEnding = lineEndings[next_random(state) % 3];
+
+    /* Avoid empty lines so that CR followed by LF is always CR-LF. */
+    size_t length = write_ascii(fp, state, 1 + next_random(state) % 60);
+    fputs(lineEnding, fp);
+    return length + strlen(lineEnding);
+}
+
+
+static size_t
+write_utf8_line(FILE* fp, unsigned long* state)
+{
+    static const char* characters[] =
+    {
+        "a", "b", "z", " ", "\xC3\xA9" /* é */, "\xCE\xBB" /* λ */,
+        "\xE4\xB8\xAD" /* 中 */, "\xE2\x82\xAC" /* € */,
+        "\xF0\x9F\x98\x80" /* 😀 */,
+    };
+    size_t numCharacters = next_random(state) % 60;
+    size_t length = 0;
+    size_t i;
+    for (i = 0; i < numCharacters; i++)
+    {
+        const char* c = characters[next_random(state)
+                                   % ARRAY_LENGTH(characters)];
+        fputs(c, fp);
+        length += strlen(c);
+    }
+    fputc('\n', fp);
+    return length + 1;
+}
+
+
+static size_t
+write_binary_record(FILE* fp, unsigned long* state)
+{
+    /* Arbitrary bytes, including LFs, terminated by a NUL. */
+    size_t length = next_random(state) % 200;
+    size_t i;
+    for (i = 0; i < length; i++)
+    {
+        fputc((int) (1 + next_random(state) % 255), fp);
+    }
+    fputc('\0', fp);
+    return length + 1;
+}
+
+
+int
+bench_generate_corpus(Corpus* corpus, size_t size)
+{
+    unsigned long state = 1;
+    size_t written = 0;
+    FILE* fp;
+
+    corpus->longestLine = 0;
+
+    sprintf(corpus->path, "bench_corpus_%s.tmp", corpus->name);
+    fp = fopen(corpus->path, "wb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Failed to create \"%s\".\n", corpus->path);
+        return 0;
+    }
+
+    while (written < size)
+    {
+        size_t length = corpus->writeLine(fp, &state);
+        if (length > corpus->longestLine)
+        {
+            corpus->longestLine = length;
+        }
+        written += length;
+    }
+
+    if (fclose(fp) != 0)
+    {
+        fprintf(stderr, "Failed to write \"%s\".\n", corpus->path);
+        return 0;
+    }
+    return 1;
+}
+
+
+
+Corpus benchCorpora[] =
+{
+    { "short", write_short_line, '\n', 0, "", 0 },
+    { "long", write_long_line, '\n', 0, "", 0 },
+    { "mixed", write_mixed_line, '\n', 0, "", 0 },
+    { "crlf", write_mixed_ending_line, '\n', 0, "", 0 },
+    { "utf8", write_utf8_line, '\n', 1, "", 0 },
+    { "binary", write_binary_record, '\0', 0, "", 0 },
+};
+
+const size_t numBenchCorpora = ARRAY_LENGTH(benchCorpora);
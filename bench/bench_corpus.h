@@ -0,0 +1,79 @@
+/** bench_corpus.h
+  *
+  * Deterministic corpora for the benchmarks.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+#include <stdio.h>
+
+
+/** Corpus
+  *
+  *     A description of a generated input file.
+  */
+typedef struct
+{
+    const char* name;
+
+    /* Writes a single line (or, for binary data, a record) to `fp` and
+     * returns its length, including its line ending.
+     */
+    size_t (*writeLine)(FILE* fp, unsigned long* state);
+
+    /* The delimiter to use with `getdelim`. */
+    int delimiter;
+
+    /* Non-zero if the corpus is UTF-8 text that `getwline` can read. */
+    int wide;
+
+    /* Set by `bench_generate_corpus`. */
+    char path[64];
+    size_t longestLine;
+} Corpus;
+
+
+/* The corpora: short, long, and mixed line lengths; mixed CR, LF, and CR-LF
+ * line endings; UTF-8 text; and NUL-delimited binary data.
+ */
+extern Corpus benchCorpora[];
+extern const size_t numBenchCorpora;
+
+
+/** bench_generate_corpus
+  *
+  *     Writes about `size` bytes of `corpus` to a file in the current
+  *     directory.  The same data is generated on every run.  The caller
+  *     should `remove(corpus->path)` when done.
+  *
+  * RETURNS:
+  *     Returns non-zero on success.  Returns 0 on failure.
+  */
+int bench_generate_corpus(Corpus* corpus, size_t size);
+
+
+#endif /* BENCH_CORPUS_H */
@@ -0,0 +1,58 @@
+/** bench_library.h
+  *
+  * Configuration for building the library's sources for the benchmarks.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+#ifndef BENCH_LIBRARY_H
+#define BENCH_LIBRARY_H
+
+/* Included before the library's sources when building them for the
+ * benchmarks.  The standard headers are included first so that their
+ * declarations are unaffected by the macros below.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+
+/* Allocation functions that count calls.  Defined in bench.c. */
+void* bench_malloc(size_t size);
+void* bench_realloc(void* p, size_t size);
+void bench_free(void* p);
+
+#define malloc bench_malloc
+#define realloc bench_realloc
+#define free bench_free
+
+/* Rename the library's versions of functions that the C library also
+ * provides so that both can be measured.
+ */
+#define getline compat_getline
+#define getdelim compat_getdelim
+
+
+#endif /* BENCH_LIBRARY_H */
@@ -0,0 +1,340 @@
+/** latency.c
+  *
+  * Measures the delay between a producer writing a line to a pipe and a
+  * consumer receiving it.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+/* Build (from the repository root):
+ *
+ *     cc -O2 -DNDEBUG -o bench/latency bench/latency.c getline.c ggets.c \
+ *        linereader.c linescan.c
+ *
+ * Usage:
+ *
+ *     bench/latency [number of lines] [microseconds between lines]
+ *
+ * For each reading method, a child process writes timestamped lines to a
+ * pipe, pausing between lines as an interactive producer would, and the
+ * parent records how long each line took to be returned.  Requires POSIX.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../getline.h"
+#include "../ggets.h"
+#include "../linereader.h"
+
+#if __STDC_VERSION__ >= 199901L
+    #include <stdbool.h>
+#else
+    typedef enum { false, true } bool;
+#endif
+
+#define ARRAY_LENGTH(a) (sizeof (a) / sizeof *(a))
+
+enum
+{
+    defaultNumLines = 2000,
+    defaultIntervalMicroseconds = 100
+};
+
+
+/* Reading methods. */
+enum
+{
+    methodGetline,
+    methodFggets,
+    methodLineReader,
+    methodLineReaderLowLatency
+};
+
+static const char* methodNames[] =
+{
+    "getline",
+    "fggets",
+    "linereader",
+    "linereader (low latency)"
+};
+
+
+static double
+now_seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec + (double) t.tv_nsec / 1e9;
+}
+
+
+/** produce
+  *
+  *     Writes `numLines` lines to `fd`, each with a single `write` call and
+  *     each starting with the time at which it was written.
+  */
+static void
+produce(int fd, size_t numLines, long intervalMicroseconds)
+{
+    struct timespec interval;
+    size_t i;
+
+    interval.tv_sec = intervalMicroseconds / 1000000;
+    interval.tv_nsec = (intervalMicroseconds % 1000000) * 1000;
+
+    for (i = 0; i < numLines; i++)
+    {
+        char line[64];
+        struct timespec t;
+        int length;
+
+        nanosleep(&interval, NULL);
+
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        length = sprintf(line, "%ld %ld some payload\n",
+                         (long) t.tv_sec, (long) t.tv_nsec);
+        if (write(fd, line, (size_t) length) != length)
+        {
+            break;
+        }
+    }
+}
+
+
+/** latency_of
+  *
+  * RETURNS:
+  *     Returns the number of seconds since `line` was written.
+  */
+static double
+latency_of(const char* line, double now)
+{
+    char* end;
+    long seconds = strtol(line, &end, 10);
+    long nanoseconds = strtol(end, NULL, 10);
+    return now - ((double) seconds + (double) nanoseconds / 1e9);
+}
+
+
+/** consume
+  *
+  *     Reads lines from `fp` using `method`, storing the latency of each in
+  *     `latencies`.
+  *
+  * RETURNS:
+  *     Returns the number of lines read.
+  */
+static size_t
+consume(FILE* fp, int method, double* latencies, size_t maxLines)
+{
+    size_t numLines = 0;
+
+    if (method == methodGetline)
+    {
+        char* line = NULL;
+        size_t size = 0;
+        while (numLines < maxLines && getline(&line, &size, fp) >= 0)
+        {
+            latencies[numLines++] = latency_of(line, now_seconds());
+        }
+        free(line);
+    }
+    else if (method == methodFggets)
+    {
+        char* line;
+        while (numLines < maxLines && fggets(&line, fp) == 0)
+        {
+            latencies[numLines++] = latency_of(line, now_seconds());
+            free(line);
+        }
+    }
+    else
+    {
+        const char* line;
+        LineReader* reader = linereader_new(fp);
+        if (reader == NULL)
+        {
+            return 0;
+        }
+        if (method == methodLineReaderLowLatency)
+        {
+            linereader_set_low_latency(reader, '\n');
+        }
+
+        /* Lines are views that are not NUL-terminated, but each contains a
+         * space after its timestamp, which ends the number.
+         */
+        while (   numLines < maxLines
+               && linereader_next(reader, &line, '\n') >= 0)
+        {
+            latencies[numLines++] = latency_of(line, now_seconds());
+        }
+        linereader_free(reader);
+    }
+
+    return numLines;
+}
+
+
+static int
+compare_doubles(const void* a, const void* b)
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+
+static double
+percentile(const double* sorted, size_t count, double fraction)
+{
+    size_t i = (size_t) (fraction * (double) (count - 1) + 0.5);
+    return sorted[i];
+}
+
+
+/** run
+  *
+  *     Measures the latencies of `method`.
+  */
+static bool
+run(int method, size_t numLines, long intervalMicroseconds,
+    double* latencies)
+{
+    int fds[2];
+    pid_t child;
+    FILE* fp;
+    size_t count;
+
+    if (pipe(fds) != 0)
+    {
+        perror("pipe");
+        return false;
+    }
+
+    child = fork();
+    if (child < 0)
+    {
+        perror("fork");
+        return false;
+    }
+    if (child == 0)
+    {
+        close(fds[0]);
+        produce(fds[1], numLines, intervalMicroseconds);
+        close(fds[1]);
+        _exit(EXIT_SUCCESS);
+    }
+
+    close(fds[1]);
+    fp = fdopen(fds[0], "r");
+    if (fp == NULL)
+    {
+        perror("fdopen");
+        close(fds[0]);
+        waitpid(child, NULL, 0);
+        return false;
+    }
+
+    count = consume(fp, method, latencies, numLines);
+    fclose(fp);
+    waitpid(child, NULL, 0);
+
+    if (count != numLines)
+    {
+        fprintf(stderr, "%s read %lu of %lu lines.\n", methodNames[method],
+                (unsigned long) count, (unsigned long) numLines);
+        return false;
+    }
+
+    qsort(latencies, count, sizeof *latencies, compare_doubles);
+    printf("%-26s %10.1f %10.1f %10.1f\n", methodNames[method],
+           percentile(latencies, count, 0.50) * 1e6,
+           percentile(latencies, count, 0.99) * 1e6,
+           latencies[count - 1] * 1e6);
+    fflush(stdout);
+    return true;
+}
+
+
+int
+main(int argc, char** argv)
+{
+    bool success = true;
+    size_t numLines = defaultNumLines;
+    long intervalMicroseconds = defaultIntervalMicroseconds;
+    double* latencies;
+    size_t i;
+
+    if (argc > 1)
+    {
+        long value = strtol(argv[1], NULL, 10);
+        if (value <= 0)
+        {
+            fprintf(stderr,
+                    "Usage: %s [number of lines] [microseconds between "
+                    "lines]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+        numLines = (size_t) value;
+    }
+    if (argc > 2)
+    {
+        intervalMicroseconds = strtol(argv[2], NULL, 10);
+        if (intervalMicroseconds < 0)
+        {
+            fprintf(stderr, "Invalid interval.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    latencies = malloc(numLines * sizeof *latencies);
+    if (latencies == NULL)
+    {
+        fprintf(stderr, "Out of memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("# %lu lines, %ld us apart; latencies in us\n",
+           (unsigned long) numLines, intervalMicroseconds);
+    printf("%-26s %10s %10s %10s\n", "method", "p50", "p99", "max");
+
+    for (i = 0; i < ARRAY_LENGTH(methodNames) && success; i++)
+    {
+        success &= run((int) i, numLines, intervalMicroseconds, latencies);
+    }
+
+    free(latencies);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
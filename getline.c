@@ -70,6 +70,10 @@ enum
     #define UNGETC ungetwc
     #define GETTLINE_UNIV getwline_univ
     #define GETTDELIMOF getwdelimof
+    #define GETTDELIMSTR getwdelimstr
+    #define GETTDELIM_BOUNDED getwdelim_bounded
+    #define GETTDELIM_SB getwdelim_sb
+    #define GETTDELIM_INTERNAL getwdelim_internal
 #else
     typedef char TCHAR;
     typedef int TINT;
@@ -81,30 +85,112 @@ enum
     #define UNGETC ungetc
     #define GETTLINE_UNIV getline_univ
     #define GETTDELIMOF getdelimof
+    #define GETTDELIMSTR getdelimstr
+    #define GETTDELIM_BOUNDED getdelim_bounded
+    #define GETTDELIM_SB getdelim_sb
+    #define GETTDELIM_INTERNAL getdelim_internal
 #endif
 
 
-/** getdelimof
+/** is_delimiter
   *
-  *     Like `getdelim`, but retrieves the next line from `stream` delimited by
-  *     any of the characters (each represented as an `unsigned char`) from
-  *     `delimiters`.
+  * RETURNS:
+  *     Returns true if `c` is one of `delimiters`.
+  */
+static bool
+is_delimiter(TINT c, const TINT* delimiters, size_t numDelimiters)
+{
+    size_t i;
+    for (i = 0; i < numDelimiters && delimiters[i] != c; i++) { }
+    return i != numDelimiters;
+}
+
+
+/** DelimOptions
+  *
+  *     Options for `getdelim_internal`.
+  */
+typedef struct
+{
+    /* Lines are delimited either by any of the characters from `delimiters`
+     * or by the sequence of characters `sequence`.  Exactly one of the two
+     * must be non-`NULL`.
+     */
+    const TINT* delimiters;
+    size_t numDelimiters;
+    const TCHAR* sequence;
+    size_t sequenceLength;
+
+    /* Lines longer than `maxLength` characters (including the delimiter) are
+     * handled according to `mode` (see `getdelim_bounded`).  `maxLength` must
+     * be `(size_t) -1` when delimiting by `sequence`.
+     */
+    size_t maxLength;
+    int mode;
+    int* truncated;
+
+    /* A caller-owned buffer that must never be reallocated or freed (see
+     * `getdelim_sb`), or `NULL`.
+     */
+    TCHAR* callerBuffer;
+} DelimOptions;
+
+
+/** init_delim_options
+  *
+  *     Initializes `options` for reading unbounded lines into heap-allocated
+  *     buffers.  The caller must set either `delimiters` or `sequence`.
+  */
+static void
+init_delim_options(DelimOptions* options)
+{
+    options->delimiters = NULL;
+    options->numDelimiters = 0;
+    options->sequence = NULL;
+    options->sequenceLength = 0;
+    options->maxLength = (size_t) -1;
+    options->mode = GETLINE_TRUNCATE_LONG;
+    options->truncated = NULL;
+    options->callerBuffer = NULL;
+}
+
+
+/** getdelim_internal
+  *
+  *     Retrieves the next line from `stream` as specified by `options`.
   *
   *     Returns the number of characters read, including the delimiter but not
   *     including a `NUL`-terminator, which is always written.
   */
 static ssize_t
-GETTDELIMOF(TCHAR** lineptr, size_t* n,
-            const TINT* delimiters, size_t numDelimiters,
-            FILE* stream)
+GETTDELIM_INTERNAL(TCHAR** lineptr, size_t* n, const DelimOptions* options,
+                   FILE* stream)
 {
+    const TINT* delimiters = options->delimiters;
+    size_t numDelimiters = options->numDelimiters;
+    const TCHAR* sequence = options->sequence;
+    size_t sequenceLength = options->sequenceLength;
+    size_t maxLength = options->maxLength;
+    int mode = options->mode;
+    int* truncated = options->truncated;
+
     ssize_t ret = -1;
     TCHAR* buffer = NULL;
     size_t bufferSize;
     size_t bufferPos = 0;
 
+    if (truncated != NULL)
+    {
+        *truncated = 0;
+    }
+
     if (   lineptr == NULL || n == NULL
-        || delimiters == NULL || numDelimiters == 0)
+        || (delimiters == NULL) == (sequence == NULL)
+        || (delimiters != NULL && numDelimiters == 0)
+        || (sequence != NULL && sequenceLength == 0)
+        || (sequence != NULL && maxLength != (size_t) -1)
+        || maxLength == 0
+        || (mode != GETLINE_TRUNCATE_LONG && mode != GETLINE_SKIP_LONG))
     {
         assert(false);
     #ifdef EINVAL
@@ -130,6 +216,11 @@ GETTDELIMOF(TCHAR** lineptr, size_t* n,
             bufferSize = defaultBufferSize;
         }
 
+        if (maxLength < bufferSize)
+        {
+            bufferSize = maxLength + 1;
+        }
+
         if (bufferSize > (size_t) SSIZE_MAX / sizeof *buffer)
         {
         #ifdef EOVERFLOW
@@ -164,6 +255,39 @@ GETTDELIMOF(TCHAR** lineptr, size_t* n,
             }
         }
 
+        if (bufferPos == maxLength)
+        {
+            /* The line is too long.  Discard the rest of it without storing
+             * it.
+             */
+            while (c != TEOF && !is_delimiter(c, delimiters, numDelimiters))
+            {
+                c = FGETC(stream);
+            }
+
+            if (c == TEOF && ferror(stream))
+            {
+                goto exit;
+            }
+
+            if (mode == GETLINE_TRUNCATE_LONG)
+            {
+                if (truncated != NULL)
+                {
+                    *truncated = 1;
+                }
+                break;
+            }
+
+            /* Skip the line and read the next one. */
+            bufferPos = 0;
+            if (c == TEOF)
+            {
+                goto exit;
+            }
+            continue;
+        }
+
         if (bufferPos + 1 == bufferSize)
         {
             size_t newSize;
@@ -179,7 +303,25 @@ GETTDELIMOF(TCHAR** lineptr, size_t* n,
             }
 
             newSize = bufferSize * 2;
-            tempBuffer = realloc(buffer, newSize * sizeof *buffer);
+            if (newSize > maxLength)
+            {
+                /* Never allocate more than a maximum-length line needs. */
+                newSize = maxLength + 1;
+            }
+
+            if (buffer == options->callerBuffer)
+            {
+                /* Spill from the caller's buffer to the heap. */
+                tempBuffer = malloc(newSize * sizeof *buffer);
+                if (tempBuffer != NULL)
+                {
+                    memcpy(tempBuffer, buffer, bufferPos * sizeof *buffer);
+                }
+            }
+            else
+            {
+                tempBuffer = realloc(buffer, newSize * sizeof *buffer);
+            }
             if (tempBuffer == NULL)
             {
             #ifdef EOVERFLOW
@@ -201,15 +343,23 @@ GETTDELIMOF(TCHAR** lineptr, size_t* n,
         buffer[bufferPos++] = (char) (unsigned char) c;
 #endif
 
+        if (sequence != NULL)
         {
-            size_t i;
-            for (i = 0; i < numDelimiters && delimiters[i] != c; i++) { }
-            if (i != numDelimiters)
+            /* Only compare the whole sequence when its last character
+             * matches.
+             */
+            if (   buffer[bufferPos - 1] == sequence[sequenceLength - 1]
+                && bufferPos >= sequenceLength
+                && memcmp(&buffer[bufferPos - sequenceLength], sequence,
+                          sequenceLength * sizeof *buffer) == 0)
             {
-                /* We found a delimiter. */
                 break;
             }
         }
+        else if (is_delimiter(c, delimiters, numDelimiters))
+        {
+            break;
+        }
     }
 
     assert(bufferPos < (size_t) SSIZE_MAX);
@@ -231,6 +381,87 @@ exit:
 }
 
 
+/** getdelimof
+  *
+  *     Like `getdelim`, but retrieves the next line from `stream` delimited by
+  *     any of the characters (each represented as an `unsigned char`) from
+  *     `delimiters`.
+  */
+static ssize_t
+GETTDELIMOF(TCHAR** lineptr, size_t* n,
+            const TINT* delimiters, size_t numDelimiters,
+            FILE* stream)
+{
+    DelimOptions options;
+    init_delim_options(&options);
+    options.delimiters = delimiters;
+    options.numDelimiters = numDelimiters;
+    return GETTDELIM_INTERNAL(lineptr, n, &options, stream);
+}
+
+
+ssize_t
+GETTDELIMSTR(TCHAR** lineptr, size_t* n,
+             const TCHAR* delimiter, size_t delimiterLength,
+             FILE* stream)
+{
+    DelimOptions options;
+    init_delim_options(&options);
+    options.sequence = delimiter;
+    options.sequenceLength = delimiterLength;
+    return GETTDELIM_INTERNAL(lineptr, n, &options, stream);
+}
+
+
+ssize_t
+GETTDELIM_BOUNDED(TCHAR** lineptr, size_t* n, TINT delimiter,
+                  size_t maxLength, int mode, int* truncated,
+                  FILE* stream)
+{
+    DelimOptions options;
+    init_delim_options(&options);
+    options.delimiters = &delimiter;
+    options.numDelimiters = 1;
+    options.maxLength = maxLength;
+    options.mode = mode;
+    options.truncated = truncated;
+    return GETTDELIM_INTERNAL(lineptr, n, &options, stream);
+}
+
+
+ssize_t
+GETTDELIM_SB(TCHAR** lineptr, size_t* n, TINT delimiter,
+             TCHAR* initialBuffer, size_t initialSize,
+             FILE* stream)
+{
+    DelimOptions options;
+
+    if (   lineptr == NULL || n == NULL
+        || initialBuffer == NULL || initialSize == 0)
+    {
+        assert(false);
+    #ifdef EINVAL
+        errno = EINVAL;
+    #else
+        errno = EDOM;
+    #endif
+        return -1;
+    }
+
+    if (*lineptr == NULL || *lineptr == initialBuffer)
+    {
+        *lineptr = initialBuffer;
+        *n = initialSize;
+    }
+
+    init_delim_options(&options);
+    options.delimiters = &delimiter;
+    options.numDelimiters = 1;
+    options.callerBuffer = initialBuffer;
+    return GETTDELIM_INTERNAL(lineptr, n, &options, stream);
+}
+
+
 #if !defined _WITH_GETLINE && !defined GETLINE_USE_WCHAR
 ssize_t
 getdelim(char** lineptr, size_t* n, int delimiter, FILE* stream)
@@ -92,6 +92,89 @@ ssize_t getline(char** lineptr, size_t* n, FILE* stream);
 #endif /* _WITH_GETLINE */
 
 
+/** getdelimstr
+  *
+  *     Like `getdelim`, but lines are delimited by a sequence of
+  *     `delimiterLength` bytes (e.g. "\r\n\r\n") instead of by a single
+  *     character.  The delimiter may contain `NUL` bytes.
+  *
+  *     Returns the number of bytes read, including the delimiter.
+  *
+  *     For large inputs, `linereader_next_str` is considerably faster.
+  */
+ssize_t getdelimstr(char** lineptr, size_t* n,
+                    const char* delimiter, size_t delimiterLength,
+                    FILE* stream);
+
+
+/* Modes for `getdelim_bounded`. */
+#ifndef GETLINE_TRUNCATE_LONG
+    #define GETLINE_TRUNCATE_LONG 0
+    #define GETLINE_SKIP_LONG 1
+#endif
+
+
+/** getdelim_bounded
+  *
+  *     Like `getdelim`, but never stores more than `maxLength` characters of
+  *     a line, so that a corrupt or hostile stream without delimiters cannot
+  *     exhaust memory.  The buffer is never grown beyond `maxLength + 1`
+  *     bytes.
+  *
+  *     The remainder of a line longer than `maxLength` bytes (including the
+  *     delimiter) is read and discarded without being stored.
+  *
+  * PARAMETERS:
+  *     IN maxLength  : The maximum line length, including the delimiter.
+  *                     Must be non-zero.
+  *     IN mode       : `GETLINE_TRUNCATE_LONG` to return the first
+  *                     `maxLength` bytes of long lines, or
+  *                     `GETLINE_SKIP_LONG` to skip long lines entirely.
+  *     OUT truncated : Optional.  Set to non-zero if the returned line was
+  *                     truncated and to 0 otherwise.  (Skipped lines are not
+  *                     reported.)
+  *
+  * RETURNS:
+  *     Returns the same as `getdelim`.  A truncated line does not end with
+  *     the delimiter.
+  */
+ssize_t getdelim_bounded(char** lineptr, size_t* n, int delimiter,
+                         size_t maxLength, int mode, int* truncated,
+                         FILE* stream);
+
+
+/** getdelim_sb
+  *
+  *     Like `getdelim`, but reads into a caller-owned buffer (e.g. an array on
+  *     the stack) and allocates memory only for lines that do not fit in it.
+  *
+  *     Initialize `*lineptr` to `NULL` (or to `initialBuffer`) before the
+  *     first call.  If a line does not fit, it is copied to a newly allocated
+  *     buffer, and `*lineptr` and `*n` are updated to refer to it.  Later
+  *     calls reuse (and grow) that allocated buffer.
+  *
+  *     `initialBuffer` itself is never reallocated or freed.
+  *
+  * PARAMETERS:
+  *     IN/OUT lineptr   : The buffer that holds the line.  After the call,
+  *                        the line is in `initialBuffer` if `*lineptr ==
+  *                        initialBuffer` and in allocated memory otherwise.
+  *     IN/OUT n         : The size of `*lineptr`.
+  *     IN delimiter     : The line delimiter.
+  *     IN initialBuffer : The caller-owned buffer.
+  *     IN initialSize   : The size of `initialBuffer`.  Must be non-zero.
+  *
+  * RETURNS:
+  *     Returns the same as `getdelim`.
+  *
+  *     If `*lineptr != initialBuffer` afterward, the caller is responsible for
+  *     freeing `*lineptr` with `free`.
+  */
+ssize_t getdelim_sb(char** lineptr, size_t* n, int delimiter,
+                    char* initialBuffer, size_t initialSize,
+                    FILE* stream);
+
+
 /** getline_univ
   *
   *     A version of `getline` that recognizes CR, LF, or CR-LF as line
@@ -83,6 +83,42 @@ ssize_t getwdelim(wchar_t** lineptr, size_t* n, wint_t delimiter,
 ssize_t getwline(wchar_t** lineptr, size_t* n, FILE* stream);
 
 
+/** getwdelimstr
+  *
+  *     A `wchar_t` version of `getdelimstr`.
+  */
+ssize_t getwdelimstr(wchar_t** lineptr, size_t* n,
+                     const wchar_t* delimiter, size_t delimiterLength,
+                     FILE* stream);
+
+
+/* Modes for `getwdelim_bounded`. */
+#ifndef GETLINE_TRUNCATE_LONG
+    #define GETLINE_TRUNCATE_LONG 0
+    #define GETLINE_SKIP_LONG 1
+#endif
+
+
+/** getwdelim_bounded
+  *
+  *     A `wchar_t` version of `getdelim_bounded`.  `maxLength` is measured in
+  *     `wchar_t`s.
+  */
+ssize_t getwdelim_bounded(wchar_t** lineptr, size_t* n, wint_t delimiter,
+                          size_t maxLength, int mode, int* truncated,
+                          FILE* stream);
+
+
+/** getwdelim_sb
+  *
+  *     A `wchar_t` version of `getdelim_sb`.  `initialSize` is measured in
+  *     `wchar_t`s.
+  */
+ssize_t getwdelim_sb(wchar_t** lineptr, size_t* n, wint_t delimiter,
+                     wchar_t* initialBuffer, size_t initialSize,
+                     FILE* stream);
+
+
 /** getwline_univ
   *
   *     A version of `getwline` that recognizes CR, LF, or CR-LF as line
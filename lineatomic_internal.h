@@ -0,0 +1,73 @@
+/** lineatomic_internal.h
+  *
+  * Minimal atomic operations shared by the multithreaded readers.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef LINEATOMIC_INTERNAL_H
+#define LINEATOMIC_INTERNAL_H
+
+/* Declare atomic variables as `LINEATOMIC(type) name;` and initialize them
+ * with `lineatomic_init` before sharing them between threads.  Loads
+ * acquire, stores release, and read-modify-write operations do both.
+ *
+ * The GCC/Clang builtins are preferred because they also work in pre-C11
+ * language modes.
+ */
+#if defined __GNUC__
+    #define LINEATOMIC(type) type
+
+    #define lineatomic_init(p, value) (*(p) = (value))
+    #define lineatomic_load(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+    #define lineatomic_store(p, value) \
+        __atomic_store_n(p, value, __ATOMIC_RELEASE)
+    #define lineatomic_fetch_add(p, n) \
+        __atomic_fetch_add(p, n, __ATOMIC_ACQ_REL)
+    #define lineatomic_compare_exchange(p, expected, desired) \
+        __atomic_compare_exchange_n(p, expected, desired, 0, \
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#elif __STDC_VERSION__ >= 201112L && !defined __STDC_NO_ATOMICS__
+    #include <stdatomic.h>
+
+    #define LINEATOMIC(type) _Atomic type
+
+    #define lineatomic_init(p, value) atomic_init(p, value)
+    #define lineatomic_load(p) \
+        atomic_load_explicit(p, memory_order_acquire)
+    #define lineatomic_store(p, value) \
+        atomic_store_explicit(p, value, memory_order_release)
+    #define lineatomic_fetch_add(p, n) \
+        atomic_fetch_add_explicit(p, n, memory_order_acq_rel)
+    #define lineatomic_compare_exchange(p, expected, desired) \
+        atomic_compare_exchange_strong_explicit(p, expected, desired, \
+                                                memory_order_acq_rel, \
+                                                memory_order_acquire)
+#else
+    #error Atomic operations are required.
+#endif
+
+
+#endif /* LINEATOMIC_INTERNAL_H */
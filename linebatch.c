@@ -0,0 +1,176 @@
+/** linebatch.c
+  *
+  * Batches of lines that own their data.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#include "linebatch.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "getline.h"
+
+#if __STDC_VERSION__ >= 199901L
+    #include <stdbool.h>
+#else
+    typedef enum { false, true } bool;
+#endif
+
+enum
+{
+#ifdef NDEBUG
+    initialBatchLines = 64,
+    initialBatchBytes = 4096
+#else
+    /* Use small sizes in debug builds to exercise growth. */
+    initialBatchLines = 1,
+    initialBatchBytes = 1
+#endif /* NDEBUG */
+};
+
+
+static void
+set_errno_invalid(void)
+{
+#ifdef EINVAL
+    errno = EINVAL;
+#else
+    errno = EDOM;
+#endif
+}
+
+
+const char*
+linebatch_line(const LineBatch* batch, size_t i, size_t* length)
+{
+    assert(batch != NULL);
+    assert(i < batch->count);
+    assert(length != NULL);
+
+    *length = batch->bounds[i + 1] - batch->bounds[i];
+    return &batch->data[batch->bounds[i]];
+}
+
+
+int
+linebatch_append(LineBatch* batch, const char* line, size_t length)
+{
+    size_t used;
+
+    if (batch == NULL || (line == NULL && length > 0))
+    {
+        assert(false);
+        set_errno_invalid();
+        return -1;
+    }
+
+    if (batch->count + 2 > batch->boundsCapacity)
+    {
+        size_t newCapacity = (batch->boundsCapacity == 0)
+                             ? initialBatchLines + 1
+                             : batch->boundsCapacity;
+        size_t* newBounds;
+
+        while (newCapacity < batch->count + 2)
+        {
+            if (newCapacity > (size_t) -1 / sizeof *newBounds / 2)
+            {
+                errno = ENOMEM;
+                return -1;
+            }
+            newCapacity *= 2;
+        }
+
+        newBounds = realloc(batch->bounds, newCapacity * sizeof *newBounds);
+        if (newBounds == NULL)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+        batch->bounds = newBounds;
+        batch->boundsCapacity = newCapacity;
+    }
+
+    if (batch->count == 0)
+    {
+        batch->bounds[0] = 0;
+    }
+    used = batch->bounds[batch->count];
+
+    if (length > batch->dataCapacity - used)
+    {
+        size_t newCapacity = (batch->dataCapacity == 0)
+                             ? initialBatchBytes
+                             : batch->dataCapacity;
+        char* newData;
+
+        while (newCapacity - used < length)
+        {
+            if (newCapacity > (size_t) SSIZE_MAX / 2)
+            {
+                errno = ENOMEM;
+                return -1;
+            }
+            newCapacity *= 2;
+        }
+
+        newData = realloc(batch->data, newCapacity);
+        if (newData == NULL)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+        batch->data = newData;
+        batch->dataCapacity = newCapacity;
+    }
+
+    if (length > 0)
+    {
+        memcpy(&batch->data[used], line, length);
+    }
+    batch->count++;
+    batch->bounds[batch->count] = used + length;
+    return 0;
+}
+
+
+void
+linebatch_free(LineBatch* batch)
+{
+    if (batch != NULL)
+    {
+        free(batch->data);
+        free(batch->bounds);
+        batch->data = NULL;
+        batch->bounds = NULL;
+        batch->count = 0;
+        batch->dataCapacity = 0;
+        batch->boundsCapacity = 0;
+    }
+}
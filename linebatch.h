@@ -0,0 +1,88 @@
+/** linebatch.h
+  *
+  * Batches of lines that own their data.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef LINEBATCH_COMPATIBLE_H
+#define LINEBATCH_COMPATIBLE_H
+
+#include <stddef.h>
+
+
+/** LineBatch
+  *
+  *     A batch of lines that owns its data, so that it can be handed from one
+  *     thread to another.
+  *
+  *     Line `i` (0 <= `i` < `count`) begins at `data + bounds[i]` and is
+  *     `bounds[i + 1] - bounds[i]` bytes long, including its delimiter (if
+  *     any).  Use `linebatch_line` to retrieve it.
+  *
+  *     Initialize with `LINEBATCH_INIT`.  Set `count` to 0 to reuse a batch
+  *     without releasing its memory, and release it with `linebatch_free`.
+  */
+typedef struct
+{
+    char* data;
+    size_t* bounds;
+    size_t count;
+
+    size_t dataCapacity;
+    size_t boundsCapacity;
+} LineBatch;
+
+#define LINEBATCH_INIT { NULL, NULL, 0, 0, 0 }
+
+
+/** linebatch_line
+  *
+  * RETURNS:
+  *     Returns a pointer to line `i` of `batch` and sets `*length` to its
+  *     length.  The line is not `NUL`-terminated.
+  */
+const char* linebatch_line(const LineBatch* batch, size_t i, size_t* length);
+
+
+/** linebatch_append
+  *
+  *     Copies a line to the end of `batch`, growing it if necessary.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+int linebatch_append(LineBatch* batch, const char* line, size_t length);
+
+
+/** linebatch_free
+  *
+  *     Releases the memory owned by `batch` and empties it.  Does nothing if
+  *     `batch` is `NULL`.
+  */
+void linebatch_free(LineBatch* batch);
+
+
+#endif /* LINEBATCH_COMPATIBLE_H */
@@ -0,0 +1,475 @@
+/** linechunk.c
+  *
+  * Splitting a file into line-aligned chunks that several threads can
+  * claim and parse concurrently.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef _POSIX_C_SOURCE
+    #define _POSIX_C_SOURCE 200809L
+#endif
+#ifndef _FILE_OFFSET_BITS
+    #define _FILE_OFFSET_BITS 64
+#endif
+
+#include "linechunk.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "lineatomic_internal.h"
+
+#if __STDC_VERSION__ >= 199901L
+    #include <stdbool.h>
+#else
+    typedef enum { false, true } bool;
+#endif
+
+enum
+{
+#ifdef NDEBUG
+    /* How much to read at a time past the end of a chunk to complete its
+     * last line.
+     */
+    extensionSize = 4096
+#else
+    /* Use a small size in debug builds to exercise growth. */
+    extensionSize = 3
+#endif /* NDEBUG */
+};
+
+
+struct LineChunker
+{
+    int fd;
+    int delimiter;
+    size_t chunkSize;
+
+    /* The size of the file when the chunker was opened. */
+    off_t fileSize;
+
+    /* The index of the next chunk to claim. */
+    LINEATOMIC(unsigned long) next;
+};
+
+
+struct LineChunk
+{
+    LineChunker* chunker;
+
+    /* Holds file data beginning at `bufferOffset`. */
+    char* buffer;
+    size_t capacity;
+    off_t bufferOffset;
+
+    /* The claimed chunk's lines are in `buffer[position, limit)`. */
+    size_t position;
+    size_t limit;
+};
+
+
+static void
+set_errno_invalid(void)
+{
+#ifdef EINVAL
+    errno = EINVAL;
+#else
+    errno = EDOM;
+#endif
+}
+
+
+static void
+set_errno_overflow(void)
+{
+#ifdef EOVERFLOW
+    errno = EOVERFLOW;
+#else
+    errno = ERANGE;
+#endif
+}
+
+
+/** read_at
+  *
+  *     Reads `size` bytes at `offset` into `buffer`, stopping early only at
+  *     the end of the file.
+  *
+  * RETURNS:
+  *     Returns the number of bytes read.  Returns -1 on failure.
+  */
+static ssize_t
+read_at(int fd, char* buffer, size_t size, off_t offset)
+{
+    size_t total = 0;
+    while (total < size)
+    {
+        ssize_t bytesRead = pread(fd, &buffer[total], size - total,
+                                  offset + (off_t) total);
+        if (bytesRead < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if (bytesRead == 0)
+        {
+            break;
+        }
+        total += (size_t) bytesRead;
+    }
+    return (ssize_t) total;
+}
+
+
+/** reserve
+  *
+  *     Ensures that `chunk->buffer` can hold at least `size` bytes, preserving
+  *     its contents.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+static int
+reserve(LineChunk* chunk, size_t size)
+{
+    size_t newCapacity = chunk->capacity;
+    char* newBuffer;
+
+    if (size <= chunk->capacity)
+    {
+        return 0;
+    }
+
+    while (newCapacity < size)
+    {
+        if (newCapacity > (size_t) SSIZE_MAX / 2)
+        {
+            set_errno_overflow();
+            return -1;
+        }
+        newCapacity *= 2;
+    }
+
+    newBuffer = realloc(chunk->buffer, newCapacity);
+    if (newBuffer == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    chunk->buffer = newBuffer;
+    chunk->capacity = newCapacity;
+    return 0;
+}
+
+
+LineChunker*
+linechunker_open(const char* path, int delimiter, size_t chunkSize)
+{
+    LineChunker* chunker = NULL;
+    struct stat st;
+    int fd = -1;
+
+    if (   path == NULL || chunkSize == 0 || chunkSize > (size_t) SSIZE_MAX
+        || delimiter < 0 || delimiter > UCHAR_MAX)
+    {
+        assert(false);
+        set_errno_invalid();
+        goto exit;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        goto exit;
+    }
+
+    if (fstat(fd, &st) != 0)
+    {
+        goto exit;
+    }
+    if (!S_ISREG(st.st_mode))
+    {
+        errno = ESPIPE;
+        goto exit;
+    }
+
+    chunker = malloc(sizeof *chunker);
+    if (chunker == NULL)
+    {
+        errno = ENOMEM;
+        goto exit;
+    }
+
+    chunker->fd = fd;
+    chunker->delimiter = delimiter;
+    chunker->chunkSize = chunkSize;
+    chunker->fileSize = st.st_size;
+    lineatomic_init(&chunker->next, 0);
+    fd = -1;
+
+exit:
+    if (fd >= 0)
+    {
+        int savedErrno = errno;
+        close(fd);
+        errno = savedErrno;
+    }
+    return chunker;
+}
+
+
+void
+linechunker_close(LineChunker* chunker)
+{
+    if (chunker != NULL)
+    {
+        close(chunker->fd);
+        free(chunker);
+    }
+}
+
+
+LineChunk*
+linechunk_new(LineChunker* chunker)
+{
+    LineChunk* chunk;
+
+    if (chunker == NULL)
+    {
+        assert(false);
+        set_errno_invalid();
+        return NULL;
+    }
+
+    chunk = calloc(1, sizeof *chunk);
+    if (chunk == NULL)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    /* Room for a chunk and the byte that precedes it. */
+    chunk->capacity = chunker->chunkSize + 1;
+    chunk->buffer = malloc(chunk->capacity);
+    if (chunk->buffer == NULL)
+    {
+        free(chunk);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    chunk->chunker = chunker;
+    return chunk;
+}
+
+
+void
+linechunk_free(LineChunk* chunk)
+{
+    if (chunk != NULL)
+    {
+        free(chunk->buffer);
+        free(chunk);
+    }
+}
+
+
+int
+linechunk_claim(LineChunk* chunk, unsigned long* sequence)
+{
+    LineChunker* chunker;
+    unsigned long index;
+    off_t begin;
+    off_t end;
+    size_t length;
+    ssize_t bytesRead;
+    const char* found;
+    int delimiter;
+
+    if (chunk == NULL)
+    {
+        assert(false);
+        set_errno_invalid();
+        return -1;
+    }
+
+    chunker = chunk->chunker;
+    delimiter = chunker->delimiter;
+    chunk->position = chunk->limit = 0;
+
+    index = lineatomic_fetch_add(&chunker->next, 1);
+    if (   (off_t) index < 0
+        || (off_t) index > chunker->fileSize / (off_t) chunker->chunkSize)
+    {
+        return 0;
+    }
+
+    begin = (off_t) index * (off_t) chunker->chunkSize;
+    if (begin >= chunker->fileSize)
+    {
+        return 0;
+    }
+    end = (chunker->fileSize - begin > (off_t) chunker->chunkSize)
+          ? begin + (off_t) chunker->chunkSize
+          : chunker->fileSize;
+
+    if (sequence != NULL)
+    {
+        *sequence = index;
+    }
+
+    /* Also read the byte before the chunk to tell whether a line starts at
+     * `begin`.
+     */
+    chunk->bufferOffset = (begin > 0) ? begin - 1 : 0;
+    length = (size_t) (end - chunk->bufferOffset);
+    bytesRead = read_at(chunker->fd, chunk->buffer, length,
+                        chunk->bufferOffset);
+    if (bytesRead < 0)
+    {
+        return -1;
+    }
+    if ((size_t) bytesRead < length)
+    {
+        /* The file was truncated.  Use what there is. */
+        length = (size_t) bytesRead;
+        end = chunk->bufferOffset + (off_t) length;
+    }
+
+    /* Find the first line that starts within the chunk. */
+    if (begin > 0)
+    {
+        found = memchr(chunk->buffer, delimiter, length);
+        if (found == NULL || (size_t) (found - chunk->buffer) + 1 >= length)
+        {
+            /* The chunk is within a line that started earlier. */
+            return 1;
+        }
+        chunk->position = (size_t) (found - chunk->buffer) + 1;
+    }
+
+    if (length == 0)
+    {
+        return 1;
+    }
+
+    /* The chunk's last line ends with the first delimiter at or after the
+     * chunk's last byte.
+     */
+    while (chunk->buffer[length - 1] != (char) delimiter)
+    {
+        size_t extension;
+        size_t toRead = extensionSize;
+        off_t remaining = chunker->fileSize
+                          - (chunk->bufferOffset + (off_t) length);
+
+        /* Data appended after the chunker was opened is ignored. */
+        if (remaining <= 0)
+        {
+            /* The final line is unterminated. */
+            break;
+        }
+        if (remaining < (off_t) toRead)
+        {
+            toRead = (size_t) remaining;
+        }
+
+        if (length > (size_t) SSIZE_MAX - extensionSize)
+        {
+            set_errno_overflow();
+            return -1;
+        }
+        if (reserve(chunk, length + extensionSize) != 0)
+        {
+            return -1;
+        }
+
+        bytesRead = read_at(chunker->fd, &chunk->buffer[length], toRead,
+                            chunk->bufferOffset + (off_t) length);
+        if (bytesRead < 0)
+        {
+            return -1;
+        }
+        if (bytesRead == 0)
+        {
+            /* The final line is unterminated. */
+            break;
+        }
+
+        extension = (size_t) bytesRead;
+        found = memchr(&chunk->buffer[length], delimiter, extension);
+        if (found != NULL)
+        {
+            length = (size_t) (found - chunk->buffer) + 1;
+            break;
+        }
+        length += extension;
+    }
+
+    chunk->limit = length;
+    return 1;
+}
+
+
+ssize_t
+linechunk_next(LineChunk* chunk, const char** line)
+{
+    const char* found;
+    size_t length;
+
+    if (chunk == NULL || line == NULL)
+    {
+        assert(false);
+        set_errno_invalid();
+        return -1;
+    }
+
+    if (chunk->position >= chunk->limit)
+    {
+        return -1;
+    }
+
+    *line = &chunk->buffer[chunk->position];
+    found = memchr(*line, chunk->chunker->delimiter,
+                   chunk->limit - chunk->position);
+    length = (found != NULL)
+             ? (size_t) (found - *line) + 1
+             : chunk->limit - chunk->position;
+    chunk->position += length;
+
+    assert(length <= (size_t) SSIZE_MAX);
+    return (ssize_t) length;
+}
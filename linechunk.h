@@ -0,0 +1,153 @@
+/** linechunk.h
+  *
+  * Splitting a file into line-aligned chunks that several threads can
+  * claim and parse concurrently.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef LINECHUNK_COMPATIBLE_H
+#define LINECHUNK_COMPATIBLE_H
+
+#include "getline.h"
+
+
+/** LineChunker
+  *
+  *     Divides a file into fixed-size chunks that worker threads claim in
+  *     turn.  Claiming a chunk is a single atomic increment, so workers do
+  *     not contend on a lock or on a shared queue of lines.
+  *
+  *     Each chunk is aligned to line boundaries: a line belongs to the chunk
+  *     in which it starts, and a worker reads past the end of its chunk as
+  *     necessary to complete that chunk's last line.
+  *
+  *     The file must support random access.  Data appended to it after the
+  *     chunker is opened is ignored.
+  *
+  *     Requires POSIX.  Claiming is thread-safe, but a `LineChunk` must be
+  *     used by only one thread at a time.
+  */
+typedef struct LineChunker LineChunker;
+
+
+/** LineChunk
+  *
+  *     A worker's view of the chunk that it most recently claimed.
+  */
+typedef struct LineChunk LineChunk;
+
+
+/** linechunker_open
+  *
+  * PARAMETERS:
+  *     IN path      : The path of the file to read.
+  *     IN delimiter : The line delimiter.
+  *     IN chunkSize : The number of bytes in each chunk.  Larger chunks
+  *                    reduce the number of claims; smaller chunks balance
+  *                    work more evenly.  Must be non-zero.
+  *
+  * RETURNS:
+  *     Returns the new chunker on success.  Returns `NULL` on failure and
+  *     sets `errno`.
+  *
+  *     The caller is responsible for releasing the returned chunker with
+  *     `linechunker_close` after all of its `LineChunk`s have been freed.
+  */
+LineChunker* linechunker_open(const char* path, int delimiter,
+                              size_t chunkSize);
+
+
+/** linechunker_close
+  *
+  *     Releases a chunker returned by `linechunker_open`.  Does nothing if
+  *     `chunker` is `NULL`.
+  */
+void linechunker_close(LineChunker* chunker);
+
+
+/** linechunk_new
+  *
+  *     Creates a worker's chunk buffer.  Each worker thread should have its
+  *     own.
+  *
+  * RETURNS:
+  *     Returns the new chunk on success.  Returns `NULL` on failure and sets
+  *     `errno`.
+  *
+  *     The caller is responsible for releasing the returned chunk with
+  *     `linechunk_free`.
+  */
+LineChunk* linechunk_new(LineChunker* chunker);
+
+
+/** linechunk_free
+  *
+  *     Releases a chunk returned by `linechunk_new`.  Does nothing if `chunk`
+  *     is `NULL`.
+  */
+void linechunk_free(LineChunk* chunk);
+
+
+/** linechunk_claim
+  *
+  *     Claims the next unclaimed chunk of the file and reads its lines.
+  *
+  *     A chunk that lies entirely within a line that began in an earlier
+  *     chunk has no lines.  Such chunks are still claimed so that sequence
+  *     numbers have no gaps.
+  *
+  * PARAMETERS:
+  *     IN/OUT chunk : The worker's chunk.
+  *     OUT sequence : If not `NULL`, set to the index of the claimed chunk.
+  *                    Chunks are numbered from 0 in file order, so results
+  *                    can be put back in order by sorting on this number.
+  *
+  * RETURNS:
+  *     Returns 1 if a chunk was claimed.  Returns 0 if every chunk has been
+  *     claimed.  Returns -1 on failure and sets `errno`.
+  */
+int linechunk_claim(LineChunk* chunk, unsigned long* sequence);
+
+
+/** linechunk_next
+  *
+  *     Retrieves a view of the next line of the most recently claimed chunk.
+  *     Views are not `NUL`-terminated and remain valid until the next call to
+  *     `linechunk_claim` with the same chunk.
+  *
+  * PARAMETERS:
+  *     IN/OUT chunk : The worker's chunk.
+  *     OUT line     : Set to the start of the line.
+  *
+  * RETURNS:
+  *     Returns the length of the line, including its delimiter (if any; the
+  *     final line of the file might be unterminated).  Returns -1 if there
+  *     are no more lines in the chunk.
+  */
+ssize_t linechunk_next(LineChunk* chunk, const char** line);
+
+
+#endif /* LINECHUNK_COMPATIBLE_H */
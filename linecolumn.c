@@ -0,0 +1,361 @@
+/** linecolumn.c
+  *
+  * Reading lines into columnar (offsets and contiguous data) batches.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#include "linecolumn.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "linereader_internal.h"
+
+enum
+{
+#ifdef NDEBUG
+    initialDataCapacity = 64 * 1024,
+    initialNumOffsets = 1024
+#else
+    /* Use small sizes in debug builds to exercise growth. */
+    initialDataCapacity = 1,
+    initialNumOffsets = 2
+#endif /* NDEBUG */
+};
+
+
+/** reserve_aligned
+  *
+  *     Ensures that an aligned buffer can hold at least `needed` bytes,
+  *     preserving its first `used` bytes.  Capacities are rounded up to a
+  *     multiple of `LINECOLUMN_ALIGNMENT` and are doubled when they grow.
+  *
+  * PARAMETERS:
+  *     IN/OUT block    : The allocated block that contains the buffer.
+  *     IN/OUT aligned  : The aligned start of the buffer within `block`.
+  *     IN/OUT capacity : The capacity of the buffer.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+static int
+reserve_aligned(void** block, void** aligned, size_t* capacity,
+                size_t used, size_t needed)
+{
+    size_t newCapacity = *capacity;
+    char* newBlock;
+    char* newAligned;
+
+    if (needed <= *capacity && *block != NULL)
+    {
+        return 0;
+    }
+
+    if (newCapacity < LINECOLUMN_ALIGNMENT)
+    {
+        newCapacity = LINECOLUMN_ALIGNMENT;
+    }
+    while (newCapacity < needed)
+    {
+        if (newCapacity > ((size_t) -1 - LINECOLUMN_ALIGNMENT) / 2)
+        {
+            linereader_set_errno_overflow();
+            return -1;
+        }
+        newCapacity *= 2;
+    }
+
+    /* C89 has no aligned allocation, so over-allocate and align within the
+     * block.  `realloc` could change the alignment of the data, so copy it
+     * instead.
+     */
+    newBlock = malloc(newCapacity + LINECOLUMN_ALIGNMENT - 1);
+    if (newBlock == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    newAligned = newBlock
+                 + (LINECOLUMN_ALIGNMENT
+                    - (uintptr_t) newBlock % LINECOLUMN_ALIGNMENT)
+                   % LINECOLUMN_ALIGNMENT;
+
+    if (used > 0)
+    {
+        memcpy(newAligned, *aligned, used);
+    }
+    free(*block);
+
+    *block = newBlock;
+    *aligned = newAligned;
+    *capacity = newCapacity;
+    return 0;
+}
+
+
+/** reserve_offsets
+  *
+  *     Ensures that `column` can hold at least `numOffsets` offsets.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+static int
+reserve_offsets(LineColumn* column, size_t numOffsets)
+{
+    void* aligned = (column->offsetWidth == LINECOLUMN_INT32)
+                    ? (void*) column->offsets32
+                    : (void*) column->offsets64;
+    size_t width = (size_t) column->offsetWidth;
+    size_t used = (column->offsetsBlock != NULL)
+                  ? (column->count + 1) * width
+                  : 0;
+
+    if (numOffsets > (size_t) -1 / width)
+    {
+        linereader_set_errno_overflow();
+        return -1;
+    }
+
+    if (reserve_aligned(&column->offsetsBlock, &aligned,
+                        &column->offsetsCapacity, used,
+                        numOffsets * width) != 0)
+    {
+        return -1;
+    }
+
+    if (column->offsetWidth == LINECOLUMN_INT32)
+    {
+        column->offsets32 = aligned;
+    }
+    else
+    {
+        column->offsets64 = aligned;
+    }
+    return 0;
+}
+
+
+/** reserve_data
+  *
+  *     Ensures that `column->data` can hold at least `length` bytes.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+static int
+reserve_data(LineColumn* column, size_t length)
+{
+    void* aligned = column->data;
+
+    if (reserve_aligned(&column->dataBlock, &aligned, &column->dataCapacity,
+                        column->length, length) != 0)
+    {
+        return -1;
+    }
+
+    column->data = aligned;
+    return 0;
+}
+
+
+int
+linecolumn_init(LineColumn* column, int offsetWidth)
+{
+    if (   column == NULL
+        || (offsetWidth != LINECOLUMN_INT32 && offsetWidth != LINECOLUMN_INT64))
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+    memset(column, 0, sizeof *column);
+    column->offsetWidth = offsetWidth;
+
+    if (   reserve_offsets(column, initialNumOffsets) != 0
+        || reserve_data(column, initialDataCapacity) != 0)
+    {
+        linecolumn_free(column);
+        return -1;
+    }
+
+    linecolumn_reset(column);
+    return 0;
+}
+
+
+void
+linecolumn_reset(LineColumn* column)
+{
+    assert(column != NULL);
+
+    column->count = 0;
+    column->length = 0;
+    if (column->offsets32 != NULL)
+    {
+        column->offsets32[0] = 0;
+    }
+    if (column->offsets64 != NULL)
+    {
+        column->offsets64[0] = 0;
+    }
+}
+
+
+void
+linecolumn_free(LineColumn* column)
+{
+    if (column != NULL)
+    {
+        free(column->dataBlock);
+        free(column->offsetsBlock);
+        memset(column, 0, sizeof *column);
+    }
+}
+
+
+const char*
+linecolumn_value(const LineColumn* column, size_t i, size_t* length)
+{
+    size_t start;
+    size_t end;
+
+    assert(column != NULL);
+    assert(length != NULL);
+    assert(i < column->count);
+
+    if (column->offsetWidth == LINECOLUMN_INT32)
+    {
+        start = (size_t) column->offsets32[i];
+        end = (size_t) column->offsets32[i + 1];
+    }
+    else
+    {
+        start = (size_t) column->offsets64[i];
+        end = (size_t) column->offsets64[i + 1];
+    }
+
+    *length = end - start;
+    return &column->data[start];
+}
+
+
+ssize_t
+linereader_next_column(LineReader* reader, LineColumn* column,
+                       size_t maxLines, int delimiter)
+{
+    size_t count = 0;
+
+    if (   reader == NULL || column == NULL || maxLines == 0
+        || (   column->offsetWidth != LINECOLUMN_INT32
+            && column->offsetWidth != LINECOLUMN_INT64))
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+    while (count < maxLines)
+    {
+        const char* line;
+        size_t contentLength;
+        ssize_t length = linereader_find_line_end(reader, delimiter);
+        if (length < 0)
+        {
+            return -1;
+        }
+        if (length == 0)
+        {
+            break;
+        }
+
+        line = &reader->buffer[reader->start];
+        contentLength = (size_t) length;
+        if (delimiter == LINEREADER_UNIV)
+        {
+            if (contentLength > 0 && line[contentLength - 1] == '\n')
+            {
+                contentLength--;
+            }
+            if (contentLength > 0 && line[contentLength - 1] == '\r')
+            {
+                contentLength--;
+            }
+        }
+        else if (   contentLength > 0
+                 && (unsigned char) line[contentLength - 1]
+                    == (unsigned char) delimiter)
+        {
+            contentLength--;
+        }
+
+        if (contentLength > ((column->offsetWidth == LINECOLUMN_INT32)
+                             ? (size_t) INT32_MAX
+                             : (size_t) SSIZE_MAX) - column->length)
+        {
+            /* Leave the line for the next batch. */
+            if (count > 0)
+            {
+                break;
+            }
+            linereader_set_errno_overflow();
+            return -1;
+        }
+
+        if (   reserve_offsets(column, column->count + 2) != 0
+            || reserve_data(column, column->length + contentLength) != 0)
+        {
+            return -1;
+        }
+
+        memcpy(&column->data[column->length], line, contentLength);
+        column->length += contentLength;
+        column->count++;
+        if (column->offsetWidth == LINECOLUMN_INT32)
+        {
+            column->offsets32[column->count] = (int32_t) column->length;
+        }
+        else
+        {
+            column->offsets64[column->count] = (int64_t) column->length;
+        }
+
+        reader->start += (size_t) length;
+        linereader_count_line(reader, (size_t) length);
+        count++;
+    }
+
+    if (count == 0)
+    {
+        return -1;
+    }
+
+    assert(count <= (size_t) SSIZE_MAX);
+    return (ssize_t) count;
+}
@@ -0,0 +1,158 @@
+/** linecolumn.h
+  *
+  * Reading lines into columnar (offsets and contiguous data) batches.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef LINECOLUMN_COMPATIBLE_H
+#define LINECOLUMN_COMPATIBLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "linereader.h"
+
+
+/* Offset widths for `linecolumn_init`, matching Apache Arrow's `string` and
+ * `large_string` layouts.
+ */
+#define LINECOLUMN_INT32 4
+#define LINECOLUMN_INT64 8
+
+/* The alignment of a column's buffers.  Their capacities are also multiples
+ * of this, so vectorized consumers may read whole blocks past the last value.
+ */
+#define LINECOLUMN_ALIGNMENT 64
+
+
+/** LineColumn
+  *
+  *     A batch of lines in the layout of a variable-length string column: the
+  *     values are stored back to back in `data`, and value `i`
+  *     (0 <= `i` < `count`) occupies `data[offsets[i], offsets[i + 1])`.
+  *     `offsets` always has `count + 1` entries, the first of which is 0.
+  *
+  *     Depending on the width passed to `linecolumn_init`, the offsets are in
+  *     `offsets32` or in `offsets64`; the other is `NULL`.  Both `data` and
+  *     the offsets are aligned to `LINECOLUMN_ALIGNMENT` bytes.
+  *
+  *     The remaining fields are private.
+  */
+typedef struct
+{
+    char* data;
+    int32_t* offsets32;
+    int64_t* offsets64;
+    size_t count;
+
+    /* The number of bytes of `data` in use. */
+    size_t length;
+
+    int offsetWidth;
+    void* dataBlock;
+    void* offsetsBlock;
+    size_t dataCapacity;
+    size_t offsetsCapacity;
+} LineColumn;
+
+
+/** linecolumn_init
+  *
+  *     Initializes an empty column.
+  *
+  * PARAMETERS:
+  *     OUT column     : The column to initialize.
+  *     IN offsetWidth : `LINECOLUMN_INT32` or `LINECOLUMN_INT64`.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  *
+  *     On success, the caller is responsible for releasing the column's
+  *     memory with `linecolumn_free`.
+  */
+int linecolumn_init(LineColumn* column, int offsetWidth);
+
+
+/** linecolumn_reset
+  *
+  *     Empties a column so that it can hold the next batch.  Its memory is
+  *     kept, so once a column has grown to the size of a typical batch, later
+  *     batches allocate nothing.
+  */
+void linecolumn_reset(LineColumn* column);
+
+
+/** linecolumn_free
+  *
+  *     Releases the memory owned by `column`.  Does nothing if `column` is
+  *     `NULL`.
+  */
+void linecolumn_free(LineColumn* column);
+
+
+/** linecolumn_value
+  *
+  * RETURNS:
+  *     Returns a pointer to value `i` of `column` and sets `*length` to its
+  *     length.  The value is not `NUL`-terminated.
+  */
+const char* linecolumn_value(const LineColumn* column, size_t i,
+                             size_t* length);
+
+
+/** linereader_next_column
+  *
+  *     Appends up to `maxLines` lines to `column`, copying each line directly
+  *     from the reader's buffer into `column->data`.  Line endings are
+  *     removed: the delimiter, or with `LINEREADER_UNIV`, a CR, LF, or CR-LF.
+  *
+  *     Lines are appended to any that are already in the column; call
+  *     `linecolumn_reset` between batches.
+  *
+  * PARAMETERS:
+  *     IN/OUT reader : The reader.
+  *     IN/OUT column : The column.
+  *     IN maxLines   : The maximum number of lines to append.  Must be
+  *                     non-zero.
+  *     IN delimiter  : The line delimiter, or `LINEREADER_UNIV`.
+  *
+  * RETURNS:
+  *     Returns the number of lines appended, which is at least 1.  Fewer
+  *     than `maxLines` lines are appended at the end of the stream or if the
+  *     next line would not fit within 32-bit offsets.
+  *
+  *     Returns -1 at the end of the stream or on failure.  As with `getline`,
+  *     use `feof` or `ferror` on the underlying stream to distinguish the
+  *     two.  If no line could be appended because 32-bit offsets would
+  *     overflow, sets `errno` to `EOVERFLOW` (`ERANGE` if `EOVERFLOW` is
+  *     unavailable) and leaves the line unread, so it can be read after
+  *     resetting the column.
+  */
+ssize_t linereader_next_column(LineReader* reader, LineColumn* column,
+                               size_t maxLines, int delimiter);
+
+
+#endif /* LINECOLUMN_COMPATIBLE_H */
@@ -0,0 +1,356 @@
+/** linecount.c
+  *
+  * Counting and skipping lines without copying them.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#include "linecount.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "linescan.h"
+
+#if __STDC_VERSION__ >= 199901L
+    #include <stdbool.h>
+#else
+    typedef enum { false, true } bool;
+#endif
+
+/* Where text and binary streams are identical, seekable streams can be read
+ * ahead and then repositioned backward by a byte count.
+ */
+#if    defined __unix__ \
+    || defined __linux__ \
+    || (defined __APPLE__ && defined __MACH__)
+    #define LINECOUNT_SEEK_BACK
+#endif
+
+enum
+{
+#ifdef NDEBUG
+    blockSize = 64 * 1024
+#else
+    /* Use a small, odd size in debug builds to exercise block boundaries. */
+    blockSize = 37
+#endif /* NDEBUG */
+};
+
+/* The delimiter value for universal newlines. */
+#define DELIMITER_UNIV (-2)
+
+
+static bool
+is_line_end(int c, int delimiter)
+{
+    return (delimiter == DELIMITER_UNIV)
+           ? (c == '\r' || c == '\n')
+           : (c == delimiter);
+}
+
+
+static ssize_t
+count_internal(FILE* stream, int delimiter)
+{
+    ssize_t ret = -1;
+    size_t count = 0;
+    bool midLine = false;
+    int afterCR = 0;
+    char* buffer;
+
+    if (stream == NULL)
+    {
+        assert(false);
+    #ifdef EINVAL
+        errno = EINVAL;
+    #else
+        errno = EDOM;
+    #endif
+        return -1;
+    }
+
+    buffer = malloc(blockSize);
+    if (buffer == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    while (true)
+    {
+        size_t len = fread(buffer, 1, blockSize, stream);
+        if (len == 0)
+        {
+            if (ferror(stream))
+            {
+                goto exit;
+            }
+            break;
+        }
+
+        count += (delimiter == DELIMITER_UNIV)
+                 ? linescan_count_univ(buffer, len, &afterCR)
+                 : linescan_count(buffer, len, delimiter);
+        midLine = !is_line_end((unsigned char) buffer[len - 1], delimiter);
+    }
+
+    if (midLine)
+    {
+        count++;
+    }
+
+    if (count > (size_t) SSIZE_MAX)
+    {
+    #ifdef EOVERFLOW
+        errno = EOVERFLOW;
+    #else
+        errno = ERANGE;
+    #endif
+        goto exit;
+    }
+    ret = (ssize_t) count;
+
+exit:
+    free(buffer);
+    return ret;
+}
+
+
+/** consume_lf_after_cr
+  *
+  *     Consumes the next character from `stream` if it is an LF that
+  *     completes a CR-LF sequence.
+  */
+static void
+consume_lf_after_cr(FILE* stream)
+{
+    int c = getc(stream);
+    if (c == EOF)
+    {
+        clearerr(stream);
+    }
+    else if (c != '\n')
+    {
+        ungetc(c, stream);
+    }
+}
+
+
+/** skip_by_char
+  *
+  *     Implementation of `skip_lines` for streams that cannot be repositioned.
+  *
+  * RETURNS:
+  *     Returns the number of lines skipped, or `(size_t) -1` on failure.
+  */
+static size_t
+skip_by_char(FILE* stream, size_t n, int delimiter)
+{
+    size_t skipped = 0;
+    bool midLine = false;
+
+    while (skipped < n)
+    {
+        int c = getc(stream);
+        if (c == EOF)
+        {
+            if (ferror(stream))
+            {
+                return (size_t) -1;
+            }
+            break;
+        }
+
+        midLine = true;
+        if (is_line_end(c, delimiter))
+        {
+            skipped++;
+            midLine = false;
+            if (delimiter == DELIMITER_UNIV && c == '\r')
+            {
+                consume_lf_after_cr(stream);
+            }
+        }
+    }
+
+    return skipped + midLine;
+}
+
+
+#ifdef LINECOUNT_SEEK_BACK
+/** skip_by_block
+  *
+  *     Implementation of `skip_lines` for seekable streams.
+  *
+  * RETURNS:
+  *     Returns the number of lines skipped, or `(size_t) -1` on failure.
+  */
+static size_t
+skip_by_block(FILE* stream, size_t n, int delimiter)
+{
+    size_t ret = (size_t) -1;
+    size_t remaining = n;
+    bool midLine = false;
+    int afterCR = 0;
+    char* buffer;
+
+    buffer = malloc(blockSize);
+    if (buffer == NULL)
+    {
+        errno = ENOMEM;
+        return (size_t) -1;
+    }
+
+    while (remaining > 0)
+    {
+        const char* found;
+        size_t len = fread(buffer, 1, blockSize, stream);
+        if (len == 0)
+        {
+            if (ferror(stream))
+            {
+                goto exit;
+            }
+            break;
+        }
+
+        found = (delimiter == DELIMITER_UNIV)
+                ? linescan_find_nth_univ(buffer, len, &remaining, &afterCR)
+                : linescan_find_nth(buffer, len, delimiter, &remaining);
+        if (found == NULL)
+        {
+            midLine = !is_line_end((unsigned char) buffer[len - 1],
+                                   delimiter);
+            continue;
+        }
+
+        {
+            size_t consumed = (size_t) (found - buffer) + 1;
+            midLine = false;
+
+            if (delimiter == DELIMITER_UNIV && *found == '\r')
+            {
+                if (consumed == len)
+                {
+                    consume_lf_after_cr(stream);
+                }
+                else if (buffer[consumed] == '\n')
+                {
+                    consumed++;
+                }
+            }
+
+            if (   consumed < len
+                && fseek(stream, -(long) (len - consumed), SEEK_CUR) != 0)
+            {
+                goto exit;
+            }
+        }
+    }
+
+    ret = n - remaining + midLine;
+
+exit:
+    free(buffer);
+    return ret;
+}
+#endif /* LINECOUNT_SEEK_BACK */
+
+
+static ssize_t
+skip_internal(FILE* stream, size_t n, int delimiter)
+{
+    size_t skipped;
+
+    if (stream == NULL)
+    {
+        assert(false);
+    #ifdef EINVAL
+        errno = EINVAL;
+    #else
+        errno = EDOM;
+    #endif
+        return -1;
+    }
+
+    if (n > (size_t) SSIZE_MAX)
+    {
+    #ifdef EOVERFLOW
+        errno = EOVERFLOW;
+    #else
+        errno = ERANGE;
+    #endif
+        return -1;
+    }
+
+    if (n == 0)
+    {
+        return 0;
+    }
+
+#ifdef LINECOUNT_SEEK_BACK
+    if (ftell(stream) >= 0)
+    {
+        skipped = skip_by_block(stream, n, delimiter);
+    }
+    else
+#endif
+    {
+        skipped = skip_by_char(stream, n, delimiter);
+    }
+
+    return (skipped == (size_t) -1) ? -1 : (ssize_t) skipped;
+}
+
+
+ssize_t
+count_lines(FILE* stream, int delimiter)
+{
+    return count_internal(stream, (unsigned char) delimiter);
+}
+
+
+ssize_t
+count_lines_univ(FILE* stream)
+{
+    return count_internal(stream, DELIMITER_UNIV);
+}
+
+
+ssize_t
+skip_lines(FILE* stream, size_t n)
+{
+    return skip_internal(stream, n, '\n');
+}
+
+
+ssize_t
+skip_lines_univ(FILE* stream, size_t n)
+{
+    return skip_internal(stream, n, DELIMITER_UNIV);
+}
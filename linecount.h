@@ -0,0 +1,90 @@
+/** linecount.h
+  *
+  * Counting and skipping lines without copying them.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef LINECOUNT_COMPATIBLE_H
+#define LINECOUNT_COMPATIBLE_H
+
+#include <stdio.h>
+
+#include "getline.h"
+
+
+/** count_lines
+  *
+  *     Counts the lines delimited by `delimiter` from the current position of
+  *     `stream` to its end, leaving `stream` at EOF.
+  *
+  *     Lines are never copied, and no line buffer is allocated; `stream` is
+  *     read in large blocks that are scanned with vectorized code where
+  *     available.
+  *
+  * RETURNS:
+  *     Returns the number of lines, the same as the number of times that
+  *     `getdelim` would succeed.  (That is, a final line that is not
+  *     terminated by a delimiter is counted.)
+  *
+  *     Returns -1 on failure and sets `errno`.
+  */
+ssize_t count_lines(FILE* stream, int delimiter);
+
+
+/** count_lines_univ
+  *
+  *     A version of `count_lines` that recognizes CR, LF, or CR-LF as line
+  *     endings, consistent with `getline_univ`.
+  */
+ssize_t count_lines_univ(FILE* stream);
+
+
+/** skip_lines
+  *
+  *     Advances `stream` past the next `n` LF-terminated lines.
+  *
+  *     On POSIX systems, seekable streams are read in blocks and then
+  *     repositioned to just after the last skipped line.  Other streams are
+  *     read a character at a time.  Either way, no line buffer is allocated.
+  *
+  * RETURNS:
+  *     Returns the number of lines skipped, which is less than `n` only if the
+  *     end of the stream was reached.
+  *
+  *     Returns -1 on failure and sets `errno`.
+  */
+ssize_t skip_lines(FILE* stream, size_t n);
+
+
+/** skip_lines_univ
+  *
+  *     A version of `skip_lines` that recognizes CR, LF, or CR-LF as line
+  *     endings, consistent with `getline_univ`.
+  */
+ssize_t skip_lines_univ(FILE* stream, size_t n);
+
+
+#endif /* LINECOUNT_COMPATIBLE_H */
@@ -0,0 +1,211 @@
+/** linecsv.c
+  *
+  * Reading RFC 4180 CSV records, including quoted fields that span lines.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#include "linecsv.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+#include "linereader_internal.h"
+#include "linescan.h"
+
+enum
+{
+    blockSize = 64
+};
+
+/* Indices into the masks computed for each block. */
+enum
+{
+    quoteMask,
+    separatorMask,
+    newlineMask,
+
+    maskCount
+};
+
+
+ssize_t
+linereader_next_csv(LineReader* reader, const char** record,
+                    int separator, LineFields* fields)
+{
+    char classes[maskCount];
+    size_t scanned = 0;
+    size_t numSeparators = 0;
+    size_t contentLength = 0;
+    size_t length = 0;
+
+    /* All ones while inside quotes at the end of the previous block. */
+    uint64_t quoteCarry = 0;
+
+    if (reader == NULL || record == NULL || fields == NULL)
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+    if (linefields_reserve(fields, 2) != 0)
+    {
+        return -1;
+    }
+    fields->bounds[0] = 0;
+
+    classes[quoteMask] = '"';
+    classes[separatorMask] = (char) separator;
+    classes[newlineMask] = '\n';
+
+    while (length == 0)
+    {
+        uint64_t masks[maskCount];
+        uint64_t inQuotes;
+        uint64_t structural;
+        const char* p = &reader->buffer[reader->start + scanned];
+        size_t available = reader->end - reader->start - scanned;
+        bool partial = (available < blockSize && !reader->eof);
+        size_t savedSeparators = numSeparators;
+        uint64_t savedQuoteCarry = quoteCarry;
+
+        /* In low-latency mode, a partial block is classified rather than
+         * waiting for the rest of it, since the record may already be
+         * complete.
+         */
+        if (partial && (!reader->lowLatency || available == 0))
+        {
+            if (linereader_fill(reader) < 0)
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        if (available == 0)
+        {
+            if (scanned == 0)
+            {
+                return -1;
+            }
+
+            /* The final record is unterminated. */
+            length = contentLength = scanned;
+            break;
+        }
+
+        if (available > blockSize)
+        {
+            available = blockSize;
+        }
+
+        linescan_match_masks(p, available, classes, maskCount, masks);
+        inQuotes = linescan_prefix_xor(masks[quoteMask]) ^ quoteCarry;
+        quoteCarry = (uint64_t) 0 - (inQuotes >> 63);
+
+        structural = (masks[separatorMask] | masks[newlineMask]) & ~inQuotes;
+        for (; structural != 0; structural &= structural - 1)
+        {
+            unsigned i = LINESCAN_LOWEST_BIT64(structural);
+            if ((masks[newlineMask] >> i) & 1)
+            {
+                length = scanned + i + 1;
+                contentLength = scanned + i;
+                if (   contentLength > 0
+                    && reader->buffer[reader->start + contentLength - 1]
+                       == '\r')
+                {
+                    contentLength--;
+                }
+                break;
+            }
+
+            if (   numSeparators + 2 >= fields->capacity
+                && linefields_reserve(fields, numSeparators + 3) != 0)
+            {
+                return -1;
+            }
+            fields->bounds[++numSeparators] = scanned + i + 1;
+        }
+
+        if (partial && length == 0)
+        {
+            /* Scan the block again once more of it has arrived. */
+            numSeparators = savedSeparators;
+            quoteCarry = savedQuoteCarry;
+            if (linereader_fill(reader) < 0)
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        scanned += available;
+    }
+
+    fields->bounds[numSeparators + 1] = contentLength + 1;
+    fields->count = numSeparators + 1;
+
+    *record = &reader->buffer[reader->start];
+    reader->start += length;
+    linereader_count_line(reader, length);
+
+    assert(length <= (size_t) SSIZE_MAX);
+    return (ssize_t) length;
+}
+
+
+size_t
+csv_unquote(const char* field, size_t length, char* out)
+{
+    const char* end = field + length;
+    char* outStart = out;
+    int inQuotes = 0;
+
+    assert(field != NULL || length == 0);
+    assert(out != NULL || length == 0);
+
+    while (field < end)
+    {
+        char c = *field++;
+        if (c != '"')
+        {
+            *out++ = c;
+        }
+        else if (inQuotes && field < end && *field == '"')
+        {
+            /* An escaped quote. */
+            *out++ = '"';
+            field++;
+        }
+        else
+        {
+            inQuotes = !inQuotes;
+        }
+    }
+
+    return (size_t) (out - outStart);
+}
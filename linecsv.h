@@ -0,0 +1,88 @@
+/** linecsv.h
+  *
+  * Reading RFC 4180 CSV records, including quoted fields that span lines.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef LINECSV_COMPATIBLE_H
+#define LINECSV_COMPATIBLE_H
+
+#include <stddef.h>
+
+#include "linereader.h"
+
+
+/** linereader_next_csv
+  *
+  *     Retrieves a view of the next CSV record (see RFC 4180) and the
+  *     boundaries of its fields.
+  *
+  *     Unlike with `linereader_next_fields`, separators and newlines inside
+  *     double-quoted fields are part of the field, so a record may span
+  *     several lines.  Quote state is tracked 64 bytes at a time with
+  *     bitmasks instead of character by character.
+  *
+  *     Records end with an LF or CR-LF outside of quotes; the line ending is
+  *     included in the returned length but excluded from the final field.
+  *     Fields are returned as they appear in the input, including any
+  *     enclosing quotes; use `csv_unquote` to decode them.
+  *
+  * PARAMETERS:
+  *     IN/OUT reader : The reader.
+  *     OUT record    : Set to the start of the record.
+  *     IN separator  : The field separator (usually ',').
+  *     IN/OUT fields : Receives the field boundaries, as described for
+  *                     `LineFields`.
+  *
+  * RETURNS:
+  *     Returns the length of the record, including its line ending.
+  *
+  *     Returns -1 at the end of the stream or on failure.  As with `getline`,
+  *     use `feof` or `ferror` on the underlying stream to distinguish the
+  *     two.
+  */
+ssize_t linereader_next_csv(LineReader* reader, const char** record,
+                            int separator, LineFields* fields);
+
+
+/** csv_unquote
+  *
+  *     Decodes a CSV field by removing enclosing quotes and replacing each
+  *     escaped `""` within quotes with a single `"`.
+  *
+  * PARAMETERS:
+  *     IN field  : The field, as returned by `linereader_next_csv`.
+  *     IN length : The length of `field`.
+  *     OUT out   : Receives the decoded field.  Must have room for `length`
+  *                 characters.  Is not `NUL`-terminated.
+  *
+  * RETURNS:
+  *     Returns the length of the decoded field.
+  */
+size_t csv_unquote(const char* field, size_t length, char* out);
+
+
+#endif /* LINECSV_COMPATIBLE_H */
@@ -0,0 +1,206 @@
+/** linefilter.c
+  *
+  * Reading only the lines that contain a substring or any of a set of bytes.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+#include "linefilter.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "linereader_internal.h"
+#include "linescan.h"
+
+
+/** find_last
+  *
+  * RETURNS:
+  *     Returns a pointer to the last occurrence of `c` in `p`.  Returns `NULL`
+  *     if there is none.
+  */
+static const char*
+find_last(const char* p, size_t len, int c)
+{
+    const char* q = p + len;
+    while (q > p)
+    {
+        if (*--q == (char) c)
+        {
+            return q;
+        }
+    }
+    return NULL;
+}
+
+
+/** next_matching
+  *
+  *     Retrieves the next line that contains `pattern` (if `anyOf` is false)
+  *     or any of the bytes in `pattern` (if `anyOf` is true).
+  *
+  *     Complete lines that cannot contain a match are dropped from the buffer
+  *     before each refill, so the buffer only ever holds the current partial
+  *     line and new data.
+  */
+static ssize_t
+next_matching(LineReader* reader, const char** line, int delimiter,
+              const char* pattern, size_t patternLength, bool anyOf)
+{
+    /* Offsets relative to `reader->start`. */
+    size_t searchFrom = 0;
+    size_t delimiterSearchFrom = 0;
+    size_t matchEnd;
+    size_t lineStart;
+    size_t lineEnd;
+
+    /* The number of trailing bytes that must be searched again after a
+     * refill in case a match straddles it.
+     */
+    size_t overlap = anyOf ? 0 : patternLength - 1;
+
+    if (   reader == NULL || line == NULL
+        || pattern == NULL || patternLength == 0
+        || delimiter == LINEREADER_UNIV
+        || memchr(pattern, delimiter, patternLength) != NULL)
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+    while (true)
+    {
+        const char* base = &reader->buffer[reader->start];
+        size_t available = reader->end - reader->start;
+        const char* found = NULL;
+        const char* lastDelimiter;
+        ssize_t bytesRead;
+
+        if (available > searchFrom)
+        {
+            found = anyOf
+                    ? linescan_find_any(&base[searchFrom],
+                                        available - searchFrom,
+                                        pattern, patternLength)
+                    : linescan_find_str(&base[searchFrom],
+                                        available - searchFrom,
+                                        pattern, patternLength);
+        }
+
+        if (found != NULL)
+        {
+            matchEnd = (size_t) (found - base) + (anyOf ? 1 : patternLength);
+            lineStart = (size_t) (found - base);
+            while (lineStart > 0 && base[lineStart - 1] != (char) delimiter)
+            {
+                lineStart--;
+            }
+            break;
+        }
+
+        /* No complete line in the buffer matches, so drop them all. */
+        lastDelimiter = find_last(&base[delimiterSearchFrom],
+                                  available - delimiterSearchFrom, delimiter);
+        if (lastDelimiter != NULL)
+        {
+            size_t discarded = (size_t) (lastDelimiter - base) + 1;
+            reader->start += discarded;
+            available -= discarded;
+            searchFrom = 0;
+        }
+        delimiterSearchFrom = available;
+
+        if (available > overlap && available - overlap > searchFrom)
+        {
+            searchFrom = available - overlap;
+        }
+
+        bytesRead = linereader_fill(reader);
+        if (bytesRead < 0)
+        {
+            return -1;
+        }
+        if (bytesRead == 0)
+        {
+            reader->start = reader->end;
+            return -1;
+        }
+    }
+
+    /* Find the end of the matching line. */
+    lineEnd = matchEnd;
+    while (true)
+    {
+        size_t available = reader->end - reader->start;
+        const char* found = memchr(&reader->buffer[reader->start + lineEnd],
+                                   delimiter, available - lineEnd);
+        ssize_t bytesRead;
+
+        if (found != NULL)
+        {
+            lineEnd = (size_t) (found - &reader->buffer[reader->start]) + 1;
+            break;
+        }
+        lineEnd = available;
+
+        bytesRead = linereader_fill(reader);
+        if (bytesRead < 0)
+        {
+            return -1;
+        }
+        if (bytesRead == 0)
+        {
+            /* The matching line is unterminated. */
+            break;
+        }
+    }
+
+    *line = &reader->buffer[reader->start + lineStart];
+    reader->start += lineEnd;
+    linereader_count_line(reader, lineEnd - lineStart);
+
+    assert(lineEnd - lineStart <= (size_t) SSIZE_MAX);
+    return (ssize_t) (lineEnd - lineStart);
+}
+
+
+ssize_t
+linereader_next_containing(LineReader* reader, const char** line,
+                           int delimiter,
+                           const char* needle, size_t needleLength)
+{
+    return next_matching(reader, line, delimiter, needle, needleLength,
+                         false);
+}
+
+
+ssize_t
+linereader_next_containing_any(LineReader* reader, const char** line,
+                               int delimiter,
+                               const char* bytes, size_t numBytes)
+{
+    return next_matching(reader, line, delimiter, bytes, numBytes, true);
+}
@@ -0,0 +1,79 @@
+/** linefilter.h
+  *
+  * Reading only the lines that contain a substring or any of a set of bytes.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+#ifndef LINEFILTER_COMPATIBLE_H
+#define LINEFILTER_COMPATIBLE_H
+
+#include <stddef.h>
+
+#include "linereader.h"
+
+
+/** linereader_next_containing
+  *
+  *     Like `linereader_next`, but skips lines that do not contain `needle`.
+  *
+  *     The search runs over the reader's buffer, not line by line, so lines
+  *     that do not match are skipped without being examined individually.
+  *
+  * PARAMETERS:
+  *     IN/OUT reader   : The reader.
+  *     OUT line        : Set to the start of the matching line.
+  *     IN delimiter    : The line delimiter.  `LINEREADER_UNIV` is not
+  *                       supported.
+  *     IN needle       : The substring to search for.  Must not contain
+  *                       `delimiter`.
+  *     IN needleLength : The length of `needle`.  Must be non-zero.
+  *
+  * RETURNS:
+  *     Returns the length of the matching line, including its delimiter.
+  *
+  *     Returns -1 if there are no more matching lines or on failure.  As with
+  *     `getline`, use `feof` or `ferror` on the underlying stream to
+  *     distinguish the two.
+  */
+ssize_t linereader_next_containing(LineReader* reader, const char** line,
+                                   int delimiter,
+                                   const char* needle, size_t needleLength);
+
+
+/** linereader_next_containing_any
+  *
+  *     Like `linereader_next_containing`, but skips lines that do not contain
+  *     any of the bytes in `bytes`.
+  *
+  * PARAMETERS:
+  *     IN bytes    : The bytes to search for.  Must not contain `delimiter`.
+  *     IN numBytes : The number of elements in `bytes`.  Must be non-zero.
+  */
+ssize_t linereader_next_containing_any(LineReader* reader, const char** line,
+                                       int delimiter,
+                                       const char* bytes, size_t numBytes);
+
+
+#endif /* LINEFILTER_COMPATIBLE_H */
@@ -0,0 +1,572 @@
+/** linefollow.c
+  *
+  * Following a growing file, as with `tail -f`.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef _POSIX_C_SOURCE
+    #define _POSIX_C_SOURCE 200809L
+#endif
+#ifndef _FILE_OFFSET_BITS
+    #define _FILE_OFFSET_BITS 64
+#endif
+
+#include "linefollow.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined __linux__ && !defined LINEFOLLOW_NO_INOTIFY
+    #define LINEFOLLOW_USE_INOTIFY
+    #include <sys/inotify.h>
+#endif
+
+#if __STDC_VERSION__ >= 199901L
+    #include <stdbool.h>
+#else
+    typedef enum { false, true } bool;
+#endif
+
+enum
+{
+#ifdef NDEBUG
+    defaultBufferSize = 128,
+    readSize = 64 * 1024
+#else
+    defaultBufferSize = 1,
+    readSize = 4
+#endif /* NDEBUG */
+};
+
+
+struct LineFollower
+{
+    char* path;
+    int fd;
+
+    /* The offset in the file of `buffer[end]`. */
+    off_t readOffset;
+
+    /* Unreturned data is in `buffer[start, end)`; no newline occurs in
+     * `buffer[start, scanned)`.
+     */
+    char* buffer;
+    size_t capacity;
+    size_t start;
+    size_t scanned;
+    size_t end;
+
+#ifdef LINEFOLLOW_USE_INOTIFY
+    int notifyFd;
+    int fileWatch;
+#endif
+};
+
+
+/** monotonic_ms
+  *
+  * RETURNS:
+  *     Returns the current time of a monotonic clock in milliseconds.
+  */
+static long long
+monotonic_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
+#ifdef LINEFOLLOW_USE_INOTIFY
+/** watch_file
+  *
+  *     (Re)establishes the inotify watch on the followed file.
+  */
+static int
+watch_file(LineFollower* follower)
+{
+    if (follower->fileWatch >= 0)
+    {
+        /* Fails harmlessly if the old file was deleted. */
+        inotify_rm_watch(follower->notifyFd, follower->fileWatch);
+    }
+
+    follower->fileWatch = inotify_add_watch(follower->notifyFd,
+                                            follower->path,
+                                            IN_MODIFY | IN_ATTRIB
+                                            | IN_MOVE_SELF | IN_DELETE_SELF);
+    return (follower->fileWatch < 0) ? -1 : 0;
+}
+
+
+/** watch_directory
+  *
+  *     Watches the followed file's directory so that we wake up when a
+  *     replacement file is created.
+  */
+static int
+watch_directory(LineFollower* follower)
+{
+    int ret;
+    char* directory;
+    char* slash;
+
+    directory = malloc(strlen(follower->path) + sizeof "/.");
+    if (directory == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    strcpy(directory, follower->path);
+    slash = strrchr(directory, '/');
+    if (slash == NULL)
+    {
+        strcpy(directory, ".");
+    }
+    else if (slash == directory)
+    {
+        slash[1] = '\0';
+    }
+    else
+    {
+        *slash = '\0';
+    }
+
+    ret = inotify_add_watch(follower->notifyFd, directory,
+                            IN_CREATE | IN_MOVED_TO);
+    free(directory);
+    return (ret < 0) ? -1 : 0;
+}
+#endif /* LINEFOLLOW_USE_INOTIFY */
+
+
+/** wait_for_change
+  *
+  *     Blocks until the followed file might have changed or until
+  *     `timeoutMilliseconds` elapses.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+static int
+wait_for_change(LineFollower* follower, int timeoutMilliseconds)
+{
+#ifdef LINEFOLLOW_USE_INOTIFY
+    struct pollfd pfd;
+    int result;
+
+    pfd.fd = follower->notifyFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    result = poll(&pfd, 1, timeoutMilliseconds);
+    if (result < 0)
+    {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    if (result > 0)
+    {
+        /* We only care that something happened, so just drain the queued
+         * events.
+         */
+        char events[4096];
+        while (read(follower->notifyFd, events, sizeof events) > 0) { }
+    }
+    return 0;
+#else
+    struct timespec delay;
+    if (   timeoutMilliseconds < 0
+        || timeoutMilliseconds > LINEFOLLOW_POLL_INTERVAL_MS)
+    {
+        timeoutMilliseconds = LINEFOLLOW_POLL_INTERVAL_MS;
+    }
+    delay.tv_sec = timeoutMilliseconds / 1000;
+    delay.tv_nsec = (long) (timeoutMilliseconds % 1000) * 1000000;
+    nanosleep(&delay, NULL);
+    return 0;
+#endif /* LINEFOLLOW_USE_INOTIFY */
+}
+
+
+/** check_replaced
+  *
+  *     Checks whether the followed file has been truncated or replaced since
+  *     it was opened, reopening or rewinding as appropriate.
+  *
+  * RETURNS:
+  *     Returns 1 if the file was replaced, 2 if it was truncated and has
+  *     been rewound, 0 if it is unchanged, and -1 on failure.
+  */
+static int
+check_replaced(LineFollower* follower)
+{
+    struct stat current;
+    struct stat latest;
+    int newFd;
+
+    if (fstat(follower->fd, &current) != 0)
+    {
+        return -1;
+    }
+
+    if (current.st_size < follower->readOffset)
+    {
+        /* Truncated.  Whatever we were holding is stale. */
+        if (lseek(follower->fd, 0, SEEK_SET) != 0)
+        {
+            return -1;
+        }
+        follower->readOffset = 0;
+        follower->start = follower->scanned = follower->end = 0;
+        return 2;
+    }
+
+    if (stat(follower->path, &latest) != 0)
+    {
+        /* The file was moved away, and its replacement doesn't exist yet. */
+        return (errno == ENOENT) ? 0 : -1;
+    }
+
+    if (latest.st_ino == current.st_ino && latest.st_dev == current.st_dev)
+    {
+        return 0;
+    }
+
+    newFd = open(follower->path, O_RDONLY | O_CLOEXEC);
+    if (newFd < 0)
+    {
+        return (errno == ENOENT) ? 0 : -1;
+    }
+
+    close(follower->fd);
+    follower->fd = newFd;
+    follower->readOffset = 0;
+
+#ifdef LINEFOLLOW_USE_INOTIFY
+    if (watch_file(follower) != 0)
+    {
+        return -1;
+    }
+#endif
+    return 1;
+}
+
+
+/** copy_out
+  *
+  *     Copies `length` unreturned characters to `*lineptr` and consumes them.
+  *
+  * RETURNS:
+  *     Returns the number of characters copied on success.  Returns -1 on
+  *     failure and sets `errno`.
+  */
+static ssize_t
+copy_out(char** lineptr, size_t* n, LineFollower* follower, size_t length)
+{
+    if (*lineptr == NULL || *n < length + 1 /* NUL */)
+    {
+        size_t newSize = (*n != 0) ? *n : defaultBufferSize;
+        char* newBuffer;
+
+        while (newSize < length + 1)
+        {
+            newSize *= 2;
+        }
+
+        newBuffer = realloc(*lineptr, newSize);
+        if (newBuffer == NULL)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+        *lineptr = newBuffer;
+        *n = newSize;
+    }
+
+    memcpy(*lineptr, &follower->buffer[follower->start], length);
+    (*lineptr)[length] = '\0';
+
+    follower->start += length;
+    follower->scanned = follower->start;
+
+    assert(length <= (size_t) SSIZE_MAX);
+    return (ssize_t) length;
+}
+
+
+/** make_room
+  *
+  *     Ensures that there is space to read at least `readSize` more bytes,
+  *     moving unreturned data to the front of the buffer or growing it.
+  */
+static int
+make_room(LineFollower* follower)
+{
+    if (follower->start > 0)
+    {
+        size_t pending = follower->end - follower->start;
+        memmove(follower->buffer, &follower->buffer[follower->start], pending);
+        follower->scanned -= follower->start;
+        follower->end = pending;
+        follower->start = 0;
+    }
+
+    if (follower->capacity - follower->end < readSize)
+    {
+        size_t newCapacity = (follower->capacity == 0)
+                             ? readSize
+                             : follower->capacity * 2;
+        char* newBuffer;
+
+        if (follower->capacity > (size_t) SSIZE_MAX / 2)
+        {
+        #ifdef EOVERFLOW
+            errno = EOVERFLOW;
+        #else
+            errno = ERANGE;
+        #endif
+            return -1;
+        }
+
+        newBuffer = realloc(follower->buffer, newCapacity);
+        if (newBuffer == NULL)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+        follower->buffer = newBuffer;
+        follower->capacity = newCapacity;
+    }
+    return 0;
+}
+
+
+LineFollower*
+linefollow_open(const char* path, int flags)
+{
+    LineFollower* follower = NULL;
+
+    if (path == NULL)
+    {
+        assert(false);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    follower = calloc(1, sizeof *follower);
+    if (follower == NULL)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    follower->fd = -1;
+#ifdef LINEFOLLOW_USE_INOTIFY
+    follower->notifyFd = -1;
+    follower->fileWatch = -1;
+#endif
+
+    follower->path = malloc(strlen(path) + 1);
+    if (follower->path == NULL)
+    {
+        errno = ENOMEM;
+        goto fail;
+    }
+    strcpy(follower->path, path);
+
+    follower->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (follower->fd < 0)
+    {
+        goto fail;
+    }
+
+    if (flags & LINEFOLLOW_FROM_END)
+    {
+        follower->readOffset = lseek(follower->fd, 0, SEEK_END);
+        if (follower->readOffset < 0)
+        {
+            goto fail;
+        }
+    }
+
+#ifdef LINEFOLLOW_USE_INOTIFY
+    follower->notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (   follower->notifyFd < 0
+        || watch_file(follower) != 0
+        || watch_directory(follower) != 0)
+    {
+        goto fail;
+    }
+#endif
+
+    return follower;
+
+fail:
+    {
+        int savedErrno = errno;
+        linefollow_close(follower);
+        errno = savedErrno;
+    }
+    return NULL;
+}
+
+
+void
+linefollow_close(LineFollower* follower)
+{
+    if (follower == NULL)
+    {
+        return;
+    }
+
+#ifdef LINEFOLLOW_USE_INOTIFY
+    if (follower->notifyFd >= 0)
+    {
+        close(follower->notifyFd);
+    }
+#endif
+    if (follower->fd >= 0)
+    {
+        close(follower->fd);
+    }
+    free(follower->buffer);
+    free(follower->path);
+    free(follower);
+}
+
+
+ssize_t
+getline_follow(char** lineptr, size_t* n, LineFollower* follower,
+               int timeoutMilliseconds)
+{
+    long long deadline = 0;
+
+    if (lineptr == NULL || n == NULL || follower == NULL)
+    {
+        assert(false);
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (timeoutMilliseconds > 0)
+    {
+        deadline = monotonic_ms() + timeoutMilliseconds;
+    }
+
+    while (true)
+    {
+        ssize_t bytesRead;
+        const char* newline = NULL;
+        if (follower->end > follower->scanned)
+        {
+            newline = memchr(&follower->buffer[follower->scanned], '\n',
+                             follower->end - follower->scanned);
+        }
+
+        if (newline != NULL)
+        {
+            return copy_out(lineptr, n, follower,
+                            (size_t) (newline - follower->buffer) + 1
+                            - follower->start);
+        }
+        follower->scanned = follower->end;
+
+        if (make_room(follower) != 0)
+        {
+            return -1;
+        }
+
+        bytesRead = read(follower->fd, &follower->buffer[follower->end],
+                         follower->capacity - follower->end);
+        if (bytesRead > 0)
+        {
+            follower->end += (size_t) bytesRead;
+            follower->readOffset += bytesRead;
+            continue;
+        }
+        if (bytesRead < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+
+        /* We're at the end of the available data. */
+        switch (check_replaced(follower))
+        {
+            case -1:
+                return -1;
+            case 1:
+                if (follower->end > follower->start)
+                {
+                    /* Flush the old file's unterminated final line. */
+                    return copy_out(lineptr, n, follower,
+                                    follower->end - follower->start);
+                }
+                continue;
+            case 2:
+                /* Read the new contents before waiting; the notification
+                 * for data written since the truncation may already have
+                 * been consumed.
+                 */
+                continue;
+            default:
+                break;
+        }
+
+        {
+            int remaining = timeoutMilliseconds;
+            if (timeoutMilliseconds > 0)
+            {
+                long long now = monotonic_ms();
+                remaining = (now >= deadline) ? 0 : (int) (deadline - now);
+            }
+
+            if (remaining == 0)
+            {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+
+            if (wait_for_change(follower, remaining) != 0)
+            {
+                return -1;
+            }
+        }
+    }
+}
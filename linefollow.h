@@ -0,0 +1,125 @@
+/** linefollow.h
+  *
+  * Following a growing file, as with `tail -f`.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef LINEFOLLOW_COMPATIBLE_H
+#define LINEFOLLOW_COMPATIBLE_H
+
+#include <stdio.h>
+
+#include "getline.h"
+
+
+/** LineFollower
+  *
+  *     Reads lines from a file that is being appended to, waiting for more
+  *     data at the end of the file instead of reporting EOF.
+  *
+  *     On Linux, waiting is done with inotify, so appended lines are delivered
+  *     as soon as they are written without any polling.  On other POSIX
+  *     systems, the file is polled every `LINEFOLLOW_POLL_INTERVAL_MS`
+  *     milliseconds, as it is on Linux if `LINEFOLLOW_NO_INOTIFY` is
+  *     defined.
+  *
+  *     The followed file is reopened if it is replaced (e.g. by log rotation
+  *     that renames the old file and creates a new one).  If the file is
+  *     truncated, reading restarts from its beginning.
+  *
+  *     Requires POSIX.
+  */
+typedef struct LineFollower LineFollower;
+
+#ifndef LINEFOLLOW_POLL_INTERVAL_MS
+    #define LINEFOLLOW_POLL_INTERVAL_MS 250
+#endif
+
+enum
+{
+    /* Start reading from the beginning of the file. */
+    LINEFOLLOW_FROM_START = 0,
+
+    /* Start reading from the current end of the file. */
+    LINEFOLLOW_FROM_END = 1 << 0
+};
+
+
+/** linefollow_open
+  *
+  * PARAMETERS:
+  *     IN path  : The path of the file to follow.  The path is retained and
+  *                checked for replacement whenever the end of the data is
+  *                reached.
+  *     IN flags : `LINEFOLLOW_FROM_START` or `LINEFOLLOW_FROM_END`.
+  *
+  * RETURNS:
+  *     Returns the new follower on success.  Returns `NULL` on failure and
+  *     sets `errno`.
+  *
+  *     The caller is responsible for releasing the returned follower with
+  *     `linefollow_close`.
+  */
+LineFollower* linefollow_open(const char* path, int flags);
+
+
+/** linefollow_close
+  *
+  *     Releases a follower returned by `linefollow_open`.  Does nothing if
+  *     `follower` is `NULL`.
+  */
+void linefollow_close(LineFollower* follower);
+
+
+/** getline_follow
+  *
+  *     Retrieves the next LF-terminated line, waiting for it to be written if
+  *     necessary.
+  *
+  *     A partially written line is retained across calls until its newline
+  *     arrives.  The one exception is when the file is replaced: the
+  *     unterminated remainder of the old file is then returned as is before
+  *     reading from the new file.  Any partial line is discarded if the file
+  *     is truncated.
+  *
+  *     `lineptr` and `n` follow the same conventions as for `getline`.
+  *
+  * PARAMETERS:
+  *     IN timeoutMilliseconds : The maximum time to wait for a complete line.
+  *                              Pass 0 to never wait or -1 to wait
+  *                              indefinitely.
+  *
+  * RETURNS:
+  *     Returns the number of characters read, including the newline.
+  *
+  *     Returns -1 on failure and sets `errno`.  If no line is available before
+  *     the timeout expires, sets `errno` to `ETIMEDOUT`.
+  */
+ssize_t getline_follow(char** lineptr, size_t* n, LineFollower* follower,
+                       int timeoutMilliseconds);
+
+
+#endif /* LINEFOLLOW_COMPATIBLE_H */
@@ -0,0 +1,691 @@
+/** lineindex.c
+  *
+  * Persistent line-offset indices for random access to lines by number.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+#if    defined __unix__ \
+    || defined __linux__ \
+    || (defined __APPLE__ && defined __MACH__)
+    #define LINEINDEX_USE_MMAP
+
+    /* For `fseeko`, `ftello`, and for 64-bit `off_t` on 32-bit systems. */
+    #ifndef _POSIX_C_SOURCE
+        #define _POSIX_C_SOURCE 200809L
+    #endif
+    #ifndef _FILE_OFFSET_BITS
+        #define _FILE_OFFSET_BITS 64
+    #endif
+#endif
+
+#include "lineindex.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef LINEINDEX_USE_MMAP
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/types.h>
+    #include <unistd.h>
+
+    typedef off_t file_offset;
+    #define FSEEK fseeko
+    #define FTELL ftello
+#elif defined _MSC_VER
+    typedef __int64 file_offset;
+    #define FSEEK _fseeki64
+    #define FTELL _ftelli64
+#else
+    typedef long file_offset;
+    #define FSEEK fseek
+    #define FTELL ftell
+#endif
+
+#if __STDC_VERSION__ >= 199901L
+    #include <stdbool.h>
+#else
+    typedef enum { false, true } bool;
+#endif
+
+#define ARRAY_LENGTH(a) (sizeof (a) / sizeof *(a))
+
+#define LINEINDEX_MAGIC      UINT64_C(0x3158444E494C4E47) /* "GLNIDX1" */
+#define LINEINDEX_BYTE_ORDER UINT64_C(0x0102030405060708)
+
+/* The delimiter value recorded for indices of universal newlines. */
+#define LINEINDEX_DELIMITER_UNIV UINT64_MAX
+
+enum
+{
+    scanBufferSize = 64 * 1024,
+    entryBufferLength = 512
+};
+
+/* Fields of the on-disk header, each stored as a `uint64_t`. */
+enum
+{
+    headerMagic,
+    headerByteOrder,
+    headerStride,
+    headerDelimiter,
+    headerIndexedSize,
+    headerLineCount,
+    headerScanState,
+    headerReserved,
+
+    headerFieldCount
+};
+
+/* Whether the next byte to be scanned begins a new line. */
+enum
+{
+    scanMidLine,
+    scanAtLineStart,
+
+    /* The previous byte was a CR.  The next byte begins a new line unless it
+     * is an LF that completes a CR-LF sequence.
+     */
+    scanAfterCR
+};
+
+
+struct LineIndex
+{
+    const uint64_t* header;
+    const uint64_t* entries;
+
+    void* storage;
+    size_t storageSize;
+    bool mapped;
+};
+
+
+/** IndexBuilder
+  *
+  *     State for scanning a stream and appending entries to an index file.
+  */
+typedef struct
+{
+    FILE* indexFile;
+
+    uint64_t stride;
+    uint64_t delimiter;
+    uint64_t lineCount;
+    uint64_t scanState;
+
+    uint64_t pending[entryBufferLength];
+    size_t numPending;
+} IndexBuilder;
+
+
+static void
+set_errno_invalid(void)
+{
+#ifdef EINVAL
+    errno = EINVAL;
+#else
+    errno = EDOM;
+#endif
+}
+
+
+static uint64_t
+entry_count(uint64_t lineCount, uint64_t stride)
+{
+    return (lineCount == 0) ? 0 : (lineCount - 1) / stride + 1;
+}
+
+
+static int
+flush_entries(IndexBuilder* builder)
+{
+    if (   builder->numPending != 0
+        && fwrite(builder->pending, sizeof builder->pending[0],
+                  builder->numPending, builder->indexFile)
+           != builder->numPending)
+    {
+        return -1;
+    }
+    builder->numPending = 0;
+    return 0;
+}
+
+
+/** record_line_start
+  *
+  *     Counts a line beginning at `offset`, recording its offset if it falls
+  *     on a stride boundary.
+  */
+static int
+record_line_start(IndexBuilder* builder, uint64_t offset)
+{
+    if (builder->lineCount % builder->stride == 0)
+    {
+        if (   builder->numPending == ARRAY_LENGTH(builder->pending)
+            && flush_entries(builder) != 0)
+        {
+            return -1;
+        }
+        builder->pending[builder->numPending++] = offset;
+    }
+    builder->lineCount++;
+    return 0;
+}
+
+
+/** find_line_end
+  *
+  * RETURNS:
+  *     Returns a pointer to the first delimiter in `[p, p + len)`, or `NULL`
+  *     if there is none.  For universal newlines, the delimiter is the first
+  *     CR or LF.
+  */
+static const char*
+find_line_end(const char* p, size_t len, uint64_t delimiter)
+{
+    const char* end = p + len;
+
+    if (delimiter != LINEINDEX_DELIMITER_UNIV)
+    {
+        return memchr(p, (int) delimiter, len);
+    }
+
+    for (; p < end; p++)
+    {
+        if (*p == '\n' || *p == '\r')
+        {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+
+/** scan_stream
+  *
+  *     Scans `stream` from its current position, which must correspond to
+  *     `baseOffset` in the indexed file, until EOF.
+  *
+  * RETURNS:
+  *     Returns the offset one past the last byte scanned on success.  Returns
+  *     `UINT64_MAX` on failure.
+  */
+static uint64_t
+scan_stream(IndexBuilder* builder, FILE* stream, uint64_t baseOffset)
+{
+    uint64_t ret = UINT64_MAX;
+    char* buffer = malloc(scanBufferSize);
+    if (buffer == NULL)
+    {
+        errno = ENOMEM;
+        goto exit;
+    }
+
+    while (true)
+    {
+        size_t i = 0;
+        size_t len = fread(buffer, 1, scanBufferSize, stream);
+        if (len == 0)
+        {
+            if (ferror(stream))
+            {
+                goto exit;
+            }
+            break;
+        }
+
+        if (builder->scanState == scanAfterCR)
+        {
+            if (buffer[0] == '\n')
+            {
+                i = 1;
+            }
+            builder->scanState = scanAtLineStart;
+        }
+
+        while (i < len)
+        {
+            const char* lineEnd;
+
+            if (builder->scanState == scanAtLineStart)
+            {
+                if (record_line_start(builder, baseOffset + i) != 0)
+                {
+                    goto exit;
+                }
+                builder->scanState = scanMidLine;
+            }
+
+            lineEnd = find_line_end(&buffer[i], len - i, builder->delimiter);
+            if (lineEnd == NULL)
+            {
+                break;
+            }
+
+            i = (size_t) (lineEnd - buffer) + 1;
+            builder->scanState = scanAtLineStart;
+
+            if (   builder->delimiter == LINEINDEX_DELIMITER_UNIV
+                && *lineEnd == '\r')
+            {
+                if (i == len)
+                {
+                    builder->scanState = scanAfterCR;
+                }
+                else if (buffer[i] == '\n')
+                {
+                    i++;
+                }
+            }
+        }
+
+        baseOffset += len;
+    }
+
+    if (flush_entries(builder) != 0)
+    {
+        goto exit;
+    }
+
+    ret = baseOffset;
+
+exit:
+    free(buffer);
+    return ret;
+}
+
+
+static int
+write_header(FILE* indexFile, const IndexBuilder* builder,
+             uint64_t indexedSize)
+{
+    uint64_t header[headerFieldCount] = { 0 };
+    header[headerMagic] = LINEINDEX_MAGIC;
+    header[headerByteOrder] = LINEINDEX_BYTE_ORDER;
+    header[headerStride] = builder->stride;
+    header[headerDelimiter] = builder->delimiter;
+    header[headerIndexedSize] = indexedSize;
+    header[headerLineCount] = builder->lineCount;
+    header[headerScanState] = builder->scanState;
+
+    if (   FSEEK(indexFile, 0, SEEK_SET) != 0
+        || fwrite(header, sizeof header, 1, indexFile) != 1
+        || fflush(indexFile) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+
+static int
+read_header(FILE* indexFile, uint64_t* header)
+{
+    if (   FSEEK(indexFile, 0, SEEK_SET) != 0
+        || fread(header, sizeof *header, headerFieldCount, indexFile)
+           != headerFieldCount)
+    {
+        if (!ferror(indexFile))
+        {
+            set_errno_invalid();
+        }
+        return -1;
+    }
+
+    if (   header[headerMagic] != LINEINDEX_MAGIC
+        || header[headerByteOrder] != LINEINDEX_BYTE_ORDER
+        || header[headerStride] == 0
+        || (   header[headerDelimiter] > UCHAR_MAX
+            && header[headerDelimiter] != LINEINDEX_DELIMITER_UNIV))
+    {
+        set_errno_invalid();
+        return -1;
+    }
+    return 0;
+}
+
+
+static int
+build_internal(FILE* stream, FILE* indexFile, uint64_t stride,
+               uint64_t delimiter)
+{
+    IndexBuilder builder = { 0 };
+    uint64_t indexedSize;
+
+    if (stream == NULL || indexFile == NULL || stride == 0)
+    {
+        assert(false);
+        set_errno_invalid();
+        return -1;
+    }
+
+    builder.indexFile = indexFile;
+    builder.stride = stride;
+    builder.delimiter = delimiter;
+    builder.scanState = scanAtLineStart;
+
+    if (   FSEEK(stream, 0, SEEK_SET) != 0
+        || FSEEK(indexFile, headerFieldCount * sizeof (uint64_t), SEEK_SET)
+           != 0)
+    {
+        return -1;
+    }
+
+    indexedSize = scan_stream(&builder, stream, 0);
+    if (indexedSize == UINT64_MAX)
+    {
+        return -1;
+    }
+
+    return write_header(indexFile, &builder, indexedSize);
+}
+
+
+int
+lineindex_build(FILE* stream, FILE* indexFile, unsigned long stride,
+                int delimiter)
+{
+    return build_internal(stream, indexFile, stride,
+                          (unsigned char) delimiter);
+}
+
+
+int
+lineindex_build_univ(FILE* stream, FILE* indexFile, unsigned long stride)
+{
+    return build_internal(stream, indexFile, stride,
+                          LINEINDEX_DELIMITER_UNIV);
+}
+
+
+int
+lineindex_extend(FILE* stream, FILE* indexFile)
+{
+    uint64_t header[headerFieldCount];
+    IndexBuilder builder = { 0 };
+    file_offset currentSize;
+    uint64_t indexedSize;
+
+    if (stream == NULL || indexFile == NULL)
+    {
+        assert(false);
+        set_errno_invalid();
+        return -1;
+    }
+
+    if (read_header(indexFile, header) != 0)
+    {
+        return -1;
+    }
+
+    if (   FSEEK(stream, 0, SEEK_END) != 0
+        || (currentSize = FTELL(stream)) < 0)
+    {
+        return -1;
+    }
+
+    if ((uint64_t) currentSize < header[headerIndexedSize])
+    {
+        /* The file was truncated or replaced; start over. */
+        return build_internal(stream, indexFile, header[headerStride],
+                              header[headerDelimiter]);
+    }
+
+    builder.indexFile = indexFile;
+    builder.stride = header[headerStride];
+    builder.delimiter = header[headerDelimiter];
+    builder.lineCount = header[headerLineCount];
+    builder.scanState = header[headerScanState];
+
+    if (   FSEEK(stream, (file_offset) header[headerIndexedSize], SEEK_SET)
+           != 0
+        || FSEEK(indexFile,
+                 (file_offset) ((headerFieldCount
+                                 + entry_count(builder.lineCount,
+                                               builder.stride))
+                                * sizeof (uint64_t)),
+                 SEEK_SET) != 0)
+    {
+        return -1;
+    }
+
+    indexedSize = scan_stream(&builder, stream, header[headerIndexedSize]);
+    if (indexedSize == UINT64_MAX)
+    {
+        return -1;
+    }
+
+    return write_header(indexFile, &builder, indexedSize);
+}
+
+
+LineIndex*
+lineindex_open(FILE* indexFile)
+{
+    LineIndex* index = NULL;
+    uint64_t header[headerFieldCount];
+    uint64_t entryCount;
+    uint64_t requiredSize;
+
+    if (indexFile == NULL)
+    {
+        assert(false);
+        set_errno_invalid();
+        goto fail;
+    }
+
+    if (fflush(indexFile) != 0 || read_header(indexFile, header) != 0)
+    {
+        goto fail;
+    }
+
+    /* A corrupt header must not be able to make the size wrap around. */
+    entryCount = entry_count(header[headerLineCount], header[headerStride]);
+    if (   entryCount > UINT64_MAX / sizeof (uint64_t) - headerFieldCount
+        || (headerFieldCount + entryCount) * sizeof (uint64_t) > SIZE_MAX)
+    {
+    #ifdef EOVERFLOW
+        errno = EOVERFLOW;
+    #else
+        errno = ERANGE;
+    #endif
+        goto fail;
+    }
+    requiredSize = (headerFieldCount + entryCount) * sizeof (uint64_t);
+
+    index = calloc(1, sizeof *index);
+    if (index == NULL)
+    {
+        errno = ENOMEM;
+        goto fail;
+    }
+    index->storageSize = (size_t) requiredSize;
+
+#ifdef LINEINDEX_USE_MMAP
+    {
+        struct stat st;
+        void* mapping;
+        if (fstat(fileno(indexFile), &st) != 0)
+        {
+            goto fail;
+        }
+        if ((uint64_t) st.st_size < requiredSize)
+        {
+            set_errno_invalid();
+            goto fail;
+        }
+
+        mapping = mmap(NULL, index->storageSize, PROT_READ, MAP_SHARED,
+                       fileno(indexFile), 0);
+        if (mapping != MAP_FAILED)
+        {
+            index->storage = mapping;
+            index->mapped = true;
+        }
+    }
+#endif /* LINEINDEX_USE_MMAP */
+
+    if (!index->mapped)
+    {
+        index->storage = malloc(index->storageSize);
+        if (index->storage == NULL)
+        {
+            errno = ENOMEM;
+            goto fail;
+        }
+
+        if (   FSEEK(indexFile, 0, SEEK_SET) != 0
+            || fread(index->storage, 1, index->storageSize, indexFile)
+               != index->storageSize)
+        {
+            if (!ferror(indexFile))
+            {
+                set_errno_invalid();
+            }
+            goto fail;
+        }
+    }
+
+    index->header = index->storage;
+    index->entries = index->header + headerFieldCount;
+    return index;
+
+fail:
+    lineindex_close(index);
+    return NULL;
+}
+
+
+void
+lineindex_close(LineIndex* index)
+{
+    if (index == NULL)
+    {
+        return;
+    }
+
+#ifdef LINEINDEX_USE_MMAP
+    if (index->mapped)
+    {
+        munmap(index->storage, index->storageSize);
+        index->storage = NULL;
+    }
+#endif
+    free(index->storage);
+    free(index);
+}
+
+
+uint64_t
+lineindex_line_count(const LineIndex* index)
+{
+    assert(index != NULL);
+    return index->header[headerLineCount];
+}
+
+
+int
+seek_to_line(FILE* stream, const LineIndex* index, uint64_t lineNumber)
+{
+    uint64_t stride;
+    uint64_t delimiter;
+    uint64_t remaining;
+
+    if (stream == NULL || index == NULL)
+    {
+        assert(false);
+        set_errno_invalid();
+        return -1;
+    }
+
+    if (lineNumber >= index->header[headerLineCount])
+    {
+        errno = ERANGE;
+        return -1;
+    }
+
+    stride = index->header[headerStride];
+    delimiter = index->header[headerDelimiter];
+
+    if (FSEEK(stream, (file_offset) index->entries[lineNumber / stride],
+              SEEK_SET) != 0)
+    {
+        return -1;
+    }
+
+    for (remaining = lineNumber % stride; remaining > 0; remaining--)
+    {
+        int c;
+        do
+        {
+            c = getc(stream);
+            if (c == EOF)
+            {
+                /* The file changed since it was indexed. */
+                if (!ferror(stream))
+                {
+                    errno = ERANGE;
+                }
+                return -1;
+            }
+        } while (delimiter == LINEINDEX_DELIMITER_UNIV
+                 ? (c != '\n' && c != '\r')
+                 : (uint64_t) c != delimiter);
+
+        if (delimiter == LINEINDEX_DELIMITER_UNIV && c == '\r')
+        {
+            c = getc(stream);
+            if (c != '\n' && c != EOF)
+            {
+                ungetc(c, stream);
+            }
+        }
+    }
+    return 0;
+}
+
+
+ssize_t
+read_line_n(char** lineptr, size_t* n, FILE* stream,
+            const LineIndex* index, uint64_t lineNumber)
+{
+    uint64_t delimiter;
+
+    if (seek_to_line(stream, index, lineNumber) != 0)
+    {
+        return -1;
+    }
+
+    delimiter = index->header[headerDelimiter];
+    return (delimiter == LINEINDEX_DELIMITER_UNIV)
+           ? getline_univ(lineptr, n, stream)
+           : getdelim(lineptr, n, (int) delimiter, stream);
+}
@@ -0,0 +1,163 @@
+/** lineindex.h
+  *
+  * Persistent line-offset indices for random access to lines by number.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+#ifndef LINEINDEX_COMPATIBLE_H
+#define LINEINDEX_COMPATIBLE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "getline.h"
+
+
+/** LineIndex
+  *
+  *     A loaded line-offset index.
+  *
+  *     An index file (a "sidecar") records the byte offset of every `stride`th
+  *     line of an indexed file.  It consists of a 64-byte header followed by
+  *     an array of `uint64_t` offsets, all in host byte order, so that it can
+  *     be mapped directly into memory.
+  *
+  *     Indices are built from streams opened in binary mode; offsets are
+  *     meaningless for text-mode streams on platforms that translate line
+  *     endings.
+  */
+typedef struct LineIndex LineIndex;
+
+
+/** lineindex_build
+  *
+  *     Scans `stream` from its beginning and writes an index of the lines
+  *     delimited by `delimiter` to `indexFile`.
+  *
+  * PARAMETERS:
+  *     IN/OUT stream    : The binary stream to index.
+  *     IN/OUT indexFile : A binary stream opened for update (e.g. "w+b") to
+  *                        write the index to.
+  *     IN stride        : The number of lines between recorded offsets.
+  *                        Smaller values make `seek_to_line` faster at the
+  *                        expense of a larger index.
+  *     IN delimiter     : The line delimiter.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+int lineindex_build(FILE* stream, FILE* indexFile, unsigned long stride,
+                    int delimiter);
+
+
+/** lineindex_build_univ
+  *
+  *     A version of `lineindex_build` that recognizes CR, LF, or CR-LF as line
+  *     endings, consistent with `getline_univ`.
+  */
+int lineindex_build_univ(FILE* stream, FILE* indexFile, unsigned long stride);
+
+
+/** lineindex_extend
+  *
+  *     Updates an existing index after data has been appended to the indexed
+  *     file.  Only the appended data is scanned.
+  *
+  *     If the indexed file is now smaller than when it was last indexed, the
+  *     index is rebuilt from scratch.  Modifications that do not change the
+  *     file's size cannot be detected.
+  *
+  *     Any `LineIndex` previously loaded from `indexFile` must be reloaded
+  *     with `lineindex_open` afterward.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+int lineindex_extend(FILE* stream, FILE* indexFile);
+
+
+/** lineindex_open
+  *
+  *     Loads an index previously written by `lineindex_build`.  Where
+  *     supported, the index is memory-mapped instead of being read.
+  *
+  * RETURNS:
+  *     Returns the loaded index on success.  Returns `NULL` on failure and
+  *     sets `errno`.
+  *
+  *     The caller is responsible for releasing the returned index with
+  *     `lineindex_close`.
+  */
+LineIndex* lineindex_open(FILE* indexFile);
+
+
+/** lineindex_close
+  *
+  *     Releases an index returned by `lineindex_open`.  Does nothing if
+  *     `index` is `NULL`.
+  */
+void lineindex_close(LineIndex* index);
+
+
+/** lineindex_line_count
+  *
+  * RETURNS:
+  *     Returns the number of lines in the indexed file.  A final line that is
+  *     not terminated by a delimiter is counted.
+  */
+uint64_t lineindex_line_count(const LineIndex* index);
+
+
+/** seek_to_line
+  *
+  *     Positions `stream` at the beginning of the specified line.
+  *
+  * PARAMETERS:
+  *     IN/OUT stream  : The binary stream that `index` describes.
+  *     IN index       : The index for `stream`.
+  *     IN lineNumber  : The 0-based number of the line to seek to.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.  If
+  *     `lineNumber` is out of range, sets `errno` to `ERANGE`.
+  */
+int seek_to_line(FILE* stream, const LineIndex* index, uint64_t lineNumber);
+
+
+/** read_line_n
+  *
+  *     Reads the specified line.  Equivalent to calling `seek_to_line`
+  *     followed by `getdelim` or `getline_univ`, as appropriate for how the
+  *     index was built.
+  *
+  * RETURNS:
+  *     Returns the number of characters read, as with `getdelim`.  Returns -1
+  *     on failure and sets `errno`.
+  */
+ssize_t read_line_n(char** lineptr, size_t* n, FILE* stream,
+                    const LineIndex* index, uint64_t lineNumber);
+
+
+#endif /* LINEINDEX_COMPATIBLE_H */
@@ -0,0 +1,434 @@
+/** lineingest.c
+  *
+  * Reading the lines of many files on a pool of threads.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef _POSIX_C_SOURCE
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "lineingest.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lineatomic_internal.h"
+
+#if __STDC_VERSION__ >= 199901L
+    #include <stdbool.h>
+#else
+    typedef enum { false, true } bool;
+#endif
+
+enum
+{
+    defaultNumThreads = 4,
+    defaultOpenFilesPerThread = 4
+};
+
+
+/** OpenFile
+  *
+  *     A file that has been opened but not yet taken by a worker.
+  */
+typedef struct
+{
+    size_t index;
+    FILE* stream;
+} OpenFile;
+
+
+typedef struct
+{
+    LineIngestFunction fn;
+    LineIngestFileDone fileDone;
+    void* context;
+    int delimiter;
+
+    /* Set when anything fails so that workers stop early. */
+    LINEATOMIC(int) cancelled;
+
+    /* Guards the fields below and is used with the condition variables. */
+    pthread_mutex_t lock;
+    pthread_cond_t fileAvailable;
+    pthread_cond_t fileClosed;
+
+    /* A ring of files waiting for a worker. */
+    OpenFile* pending;
+    size_t head;
+    size_t count;
+
+    /* The number of files that are open, whether pending or being read. */
+    size_t numOpen;
+    size_t maxOpen;
+
+    bool finished;
+    int firstError;
+} Ingest;
+
+
+static void
+set_errno_invalid(void)
+{
+#ifdef EINVAL
+    errno = EINVAL;
+#else
+    errno = EDOM;
+#endif
+}
+
+
+static void
+set_errno_cancelled(void)
+{
+#ifdef ECANCELED
+    errno = ECANCELED;
+#else
+    errno = EDOM;
+#endif
+}
+
+
+/** record_error
+  *
+  *     Records `error` as the result of the ingest (unless an earlier error
+  *     has already been recorded) and tells every thread to stop.  The caller
+  *     must hold `ingest->lock`.
+  */
+static void
+record_error(Ingest* ingest, int error)
+{
+    if (ingest->firstError == 0)
+    {
+        ingest->firstError = error;
+    }
+    lineatomic_store(&ingest->cancelled, 1);
+    pthread_cond_broadcast(&ingest->fileClosed);
+}
+
+
+/** read_file
+  *
+  *     Passes every line of `file` to the line function.
+  *
+  * PARAMETERS:
+  *     IN/OUT reader : The worker's reader, which is created on first use.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+static int
+read_file(Ingest* ingest, const OpenFile* file, LineReader** reader)
+{
+    if (*reader == NULL)
+    {
+        *reader = linereader_new(file->stream);
+        if (*reader == NULL)
+        {
+            return -1;
+        }
+    }
+    else if (linereader_reset(*reader, file->stream) != 0)
+    {
+        return -1;
+    }
+
+    while (true)
+    {
+        const char* line;
+        ssize_t length;
+
+        if (lineatomic_load(&ingest->cancelled))
+        {
+            set_errno_cancelled();
+            return -1;
+        }
+
+        length = linereader_next(*reader, &line, ingest->delimiter);
+        if (length < 0)
+        {
+            /* The reader also fails without setting the stream's error
+             * indicator if it cannot grow its buffer for a long line.
+             */
+            if (!feof(file->stream))
+            {
+                return -1;
+            }
+            break;
+        }
+
+        errno = 0;
+        if (ingest->fn(file->index, line, (size_t) length,
+                       ingest->context) != 0)
+        {
+            return -1;
+        }
+    }
+
+    errno = 0;
+    if (   ingest->fileDone != NULL
+        && ingest->fileDone(file->index, ingest->context) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+
+static void*
+worker_main(void* arg)
+{
+    Ingest* ingest = arg;
+    LineReader* reader = NULL;
+
+    while (true)
+    {
+        OpenFile file;
+        int error = 0;
+
+        pthread_mutex_lock(&ingest->lock);
+        while (ingest->count == 0 && !ingest->finished)
+        {
+            pthread_cond_wait(&ingest->fileAvailable, &ingest->lock);
+        }
+        if (ingest->count == 0)
+        {
+            pthread_mutex_unlock(&ingest->lock);
+            break;
+        }
+        file = ingest->pending[ingest->head];
+        ingest->head = (ingest->head + 1) % ingest->maxOpen;
+        ingest->count--;
+        pthread_mutex_unlock(&ingest->lock);
+
+        /* Files that were opened before a failure are closed unread. */
+        if (   !lineatomic_load(&ingest->cancelled)
+            && read_file(ingest, &file, &reader) != 0)
+        {
+            if (errno == 0)
+            {
+                set_errno_cancelled();
+            }
+            error = errno;
+        }
+        fclose(file.stream);
+
+        pthread_mutex_lock(&ingest->lock);
+        if (error != 0)
+        {
+            record_error(ingest, error);
+        }
+        ingest->numOpen--;
+        pthread_cond_signal(&ingest->fileClosed);
+        pthread_mutex_unlock(&ingest->lock);
+    }
+
+    linereader_free(reader);
+    return NULL;
+}
+
+
+void
+lineingest_init_options(LineIngestOptions* options)
+{
+    long numCPUs = -1;
+
+    assert(options != NULL);
+    memset(options, 0, sizeof *options);
+
+#ifdef _SC_NPROCESSORS_ONLN
+    numCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    options->delimiter = '\n';
+    options->numThreads = (numCPUs > 0) ? (size_t) numCPUs
+                                        : defaultNumThreads;
+    options->maxOpenFiles = defaultOpenFilesPerThread * options->numThreads;
+}
+
+
+int
+for_each_line_in_files(const char* const* paths, size_t numPaths,
+                       LineIngestFunction fn, void* context,
+                       const LineIngestOptions* options)
+{
+    LineIngestOptions defaultOptions;
+    Ingest ingest;
+    pthread_t* threads = NULL;
+    size_t numStarted = 0;
+    bool lockInitialized = false;
+    int error = 0;
+    size_t i;
+
+    if (options == NULL)
+    {
+        lineingest_init_options(&defaultOptions);
+        options = &defaultOptions;
+    }
+
+    if (   (paths == NULL && numPaths > 0) || fn == NULL
+        || options->numThreads == 0 || options->maxOpenFiles == 0
+        || options->maxOpenFiles > (size_t) -1 / sizeof *ingest.pending
+        || options->numThreads > (size_t) -1 / sizeof *threads)
+    {
+        assert(false);
+        set_errno_invalid();
+        return -1;
+    }
+
+    memset(&ingest, 0, sizeof ingest);
+    ingest.fn = fn;
+    ingest.fileDone = options->fileDone;
+    ingest.context = context;
+    ingest.delimiter = options->delimiter;
+    ingest.maxOpen = options->maxOpenFiles;
+    lineatomic_init(&ingest.cancelled, 0);
+
+    ingest.pending = malloc(ingest.maxOpen * sizeof *ingest.pending);
+    threads = malloc(options->numThreads * sizeof *threads);
+    if (ingest.pending == NULL || threads == NULL)
+    {
+        error = ENOMEM;
+        goto exit;
+    }
+
+    if (   pthread_mutex_init(&ingest.lock, NULL) != 0
+        || pthread_cond_init(&ingest.fileAvailable, NULL) != 0
+        || pthread_cond_init(&ingest.fileClosed, NULL) != 0)
+    {
+        error = ENOMEM;
+        goto exit;
+    }
+    lockInitialized = true;
+
+    for (numStarted = 0; numStarted < options->numThreads; numStarted++)
+    {
+        error = pthread_create(&threads[numStarted], NULL, worker_main,
+                               &ingest);
+        if (error != 0)
+        {
+            goto exit;
+        }
+    }
+
+    for (i = 0; i < numPaths; i++)
+    {
+        OpenFile file;
+
+        /* Reserve a file descriptor before opening the file. */
+        pthread_mutex_lock(&ingest.lock);
+        while (   ingest.numOpen == ingest.maxOpen
+               && !lineatomic_load(&ingest.cancelled))
+        {
+            pthread_cond_wait(&ingest.fileClosed, &ingest.lock);
+        }
+        if (lineatomic_load(&ingest.cancelled))
+        {
+            pthread_mutex_unlock(&ingest.lock);
+            break;
+        }
+        ingest.numOpen++;
+        pthread_mutex_unlock(&ingest.lock);
+
+        file.index = i;
+        errno = 0;
+        file.stream = fopen(paths[i], "rb");
+        if (file.stream == NULL)
+        {
+            if (errno == 0)
+            {
+                set_errno_cancelled();
+            }
+            error = errno;
+
+            pthread_mutex_lock(&ingest.lock);
+            ingest.numOpen--;
+            record_error(&ingest, error);
+            pthread_mutex_unlock(&ingest.lock);
+            break;
+        }
+
+    #ifdef POSIX_FADV_WILLNEED
+        /* Start reading the whole file in the background.  This is only
+         * advice, so failures are ignored.
+         */
+        (void) posix_fadvise(fileno(file.stream), 0, 0,
+                             POSIX_FADV_WILLNEED);
+    #endif
+
+        pthread_mutex_lock(&ingest.lock);
+        assert(ingest.count < ingest.maxOpen);
+        ingest.pending[(ingest.head + ingest.count) % ingest.maxOpen] = file;
+        ingest.count++;
+        pthread_cond_signal(&ingest.fileAvailable);
+        pthread_mutex_unlock(&ingest.lock);
+    }
+
+exit:
+    if (lockInitialized)
+    {
+        pthread_mutex_lock(&ingest.lock);
+        if (error != 0)
+        {
+            record_error(&ingest, error);
+        }
+        ingest.finished = true;
+        pthread_cond_broadcast(&ingest.fileAvailable);
+        pthread_mutex_unlock(&ingest.lock);
+    }
+
+    for (i = 0; i < numStarted; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    if (lockInitialized)
+    {
+        assert(ingest.count == 0 && ingest.numOpen == 0);
+        error = ingest.firstError;
+
+        pthread_cond_destroy(&ingest.fileClosed);
+        pthread_cond_destroy(&ingest.fileAvailable);
+        pthread_mutex_destroy(&ingest.lock);
+    }
+
+    free(ingest.pending);
+    free(threads);
+
+    if (error != 0)
+    {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+/** lineingest.h
+  *
+  * Reading the lines of many files on a pool of threads.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef LINEINGEST_COMPATIBLE_H
+#define LINEINGEST_COMPATIBLE_H
+
+#include <stddef.h>
+
+#include "linereader.h"
+
+
+/** LineIngestFunction
+  *
+  *     Processes one line of file number `file` (an index into the list
+  *     passed to `for_each_line_in_files`).  The lines of a file are passed
+  *     in order from a single thread, but different files are processed
+  *     concurrently, so access to `context` must be thread-safe.
+  *
+  * RETURNS:
+  *     Returns 0 to continue.  Returns non-zero to stop; in that case,
+  *     `errno` should be set.
+  */
+typedef int (*LineIngestFunction)(size_t file, const char* line,
+                                  size_t length, void* context);
+
+
+/** LineIngestFileDone
+  *
+  *     Called after the last line of file number `file` has been processed,
+  *     on the same thread that processed its lines.
+  *
+  * RETURNS:
+  *     As for `LineIngestFunction`.
+  */
+typedef int (*LineIngestFileDone)(size_t file, void* context);
+
+
+/** LineIngestOptions
+  *
+  *     Initialize with `lineingest_init_options` and then override fields as
+  *     needed.
+  */
+typedef struct
+{
+    /* The line delimiter, or `LINEREADER_UNIV`.  Defaults to '\n'. */
+    int delimiter;
+
+    /* The number of worker threads.  Defaults to the number of online CPUs
+     * where that can be determined.
+     */
+    size_t numThreads;
+
+    /* The maximum number of files that may be open at once, counting both
+     * the files being read and the files opened ahead of time.  Files opened
+     * ahead are prefetched with `posix_fadvise`, so values larger than
+     * `numThreads` let the storage device work on several files at once.
+     * Defaults to 4 times `numThreads`.
+     */
+    size_t maxOpenFiles;
+
+    /* If not `NULL`, called after each file.  Passed the same context as the
+     * line function.
+     */
+    LineIngestFileDone fileDone;
+} LineIngestOptions;
+
+
+/** lineingest_init_options
+  *
+  *     Sets `options` to defaults.
+  */
+void lineingest_init_options(LineIngestOptions* options);
+
+
+/** for_each_line_in_files
+  *
+  *     Runs `fn` on every line of every file in `paths` on a pool of worker
+  *     threads.  The calling thread opens files in order, asks the system to
+  *     start reading them in the background, and hands them to idle workers;
+  *     each worker reads one file at a time with a `LineReader` that it
+  *     reuses for every file.
+  *
+  *     Requires POSIX threads.
+  *
+  * PARAMETERS:
+  *     IN paths    : The paths of the files to read.
+  *     IN numPaths : The number of elements in `paths`.
+  *     IN fn       : The function to apply to each line.
+  *     IN context  : Passed to `fn` and to `options->fileDone`.
+  *     IN options  : The options, or `NULL` for defaults.
+  *
+  * RETURNS:
+  *     Returns 0 if every line of every file was processed.  Returns -1 on
+  *     failure (including a file that cannot be opened or read and a non-zero
+  *     return from a callback) and sets `errno`.  Once a failure occurs, no
+  *     more files are opened, and no more lines are passed to `fn`.
+  */
+int for_each_line_in_files(const char* const* paths, size_t numPaths,
+                           LineIngestFunction fn, void* context,
+                           const LineIngestOptions* options);
+
+
+#endif /* LINEINGEST_COMPATIBLE_H */
@@ -0,0 +1,567 @@
+/** lineintern.c
+  *
+  * Deduplicating lines by interning them.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#include "lineintern.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "linereader_internal.h"
+
+enum
+{
+#ifdef NDEBUG
+    initialTableCapacity = 1024,
+    arenaChunkSize = 64 * 1024
+#else
+    /* Use small sizes in debug builds to exercise growth. */
+    initialTableCapacity = 2,
+    arenaChunkSize = 16
+#endif /* NDEBUG */
+};
+
+
+/* Word-at-a-time helpers.  See
+ * <https://graphics.stanford.edu/~seander/bithacks.html#ZeroInWord>.
+ */
+#define ONES_WORD ((unsigned long) -1 / UCHAR_MAX)
+#define HIGHS_WORD (ONES_WORD * (UCHAR_MAX / 2 + 1))
+#define LOWS_WORD (ONES_WORD * (UCHAR_MAX / 2))
+
+#define HASH_SEED UINT64_C(0x9E3779B97F4A7C15)
+#define HASH_MULTIPLIER UINT64_C(0xFF51AFD7ED558CCD)
+
+
+/** ArenaChunk
+  *
+  *     A block of interned line data.  Its data immediately follows it.
+  */
+typedef struct ArenaChunk
+{
+    struct ArenaChunk* next;
+    size_t used;
+    size_t capacity;
+} ArenaChunk;
+
+
+typedef struct
+{
+    const char* data;
+    size_t length;
+    size_t count;
+    uint64_t hash;
+} InternedLine;
+
+
+struct LineInterner
+{
+    /* Indexed by handle. */
+    InternedLine* lines;
+    size_t numLines;
+    size_t linesCapacity;
+
+    /* An open-addressing table with linear probing.  Each slot holds a
+     * handle plus 1, or 0 if the slot is empty.  The capacity is a power of
+     * 2, and the table is at most half full.
+     */
+    size_t* table;
+    size_t tableCapacity;
+
+    /* The chunk that new lines are copied into is first. */
+    ArenaChunk* chunks;
+};
+
+
+/** hash_word
+  *
+  *     Mixes a word of line data into a hash.
+  */
+static uint64_t
+hash_word(uint64_t hash, unsigned long word)
+{
+    hash = (hash ^ (uint64_t) word) * HASH_MULTIPLIER;
+    return hash ^ (hash >> 32);
+}
+
+
+/** hash_tail
+  *
+  *     Mixes the final `length` bytes (fewer than a word) of a line into a
+  *     hash.
+  */
+static uint64_t
+hash_tail(uint64_t hash, const char* p, size_t length)
+{
+    unsigned long word = 0;
+
+    assert(length < sizeof word);
+    if (length == 0)
+    {
+        return hash;
+    }
+    memcpy(&word, p, length);
+    return hash_word(hash, word);
+}
+
+
+/** hash_finish
+  *
+  * RETURNS:
+  *     Returns the final hash of a line of `length` bytes.
+  */
+static uint64_t
+hash_finish(uint64_t hash, size_t length)
+{
+    hash ^= (uint64_t) length;
+    hash ^= hash >> 33;
+    hash *= HASH_MULTIPLIER;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+
+/** hash_line
+  *
+  *     Hashes a line in the same way as `scan_line`.
+  */
+static uint64_t
+hash_line(const char* line, size_t length)
+{
+    uint64_t hash = HASH_SEED;
+    size_t i = 0;
+
+    for (; length - i >= sizeof (unsigned long); i += sizeof (unsigned long))
+    {
+        unsigned long word;
+        memcpy(&word, &line[i], sizeof word);
+        hash = hash_word(hash, word);
+    }
+    hash = hash_tail(hash, &line[i], length - i);
+    return hash_finish(hash, length);
+}
+
+
+/** scan_line
+  *
+  *     Finds the end of the line that begins at `reader->start` and hashes
+  *     its contents at the same time, a word at a time.
+  *
+  * PARAMETERS:
+  *     OUT contentLength : Set to the length of the line without its
+  *                         delimiter.
+  *     OUT hash          : Set to the hash of the line without its
+  *                         delimiter.
+  *
+  * RETURNS:
+  *     Returns the length of the line, including its delimiter.  Returns 0 if
+  *     there are no more lines.  Returns -1 on failure.
+  */
+static ssize_t
+scan_line(LineReader* reader, int delimiter, size_t* contentLength,
+          uint64_t* hash)
+{
+    unsigned long pattern = ONES_WORD * (unsigned char) delimiter;
+    uint64_t h = HASH_SEED;
+
+    /* The number of bytes hashed so far, always a multiple of the word
+     * size.  `linereader_fill` preserves offsets from `reader->start`, so
+     * this remains valid across refills.
+     */
+    size_t scanned = 0;
+
+    while (true)
+    {
+        const char* p = &reader->buffer[reader->start];
+        size_t available = reader->end - reader->start;
+        const char* found = NULL;
+        ssize_t bytesRead;
+
+        while (available - scanned >= sizeof (unsigned long))
+        {
+            unsigned long word;
+            unsigned long x;
+            memcpy(&word, &p[scanned], sizeof word);
+
+            x = word ^ pattern;
+            if ((((x & LOWS_WORD) + LOWS_WORD) | x | LOWS_WORD) != ~0UL)
+            {
+                found = memchr(&p[scanned], delimiter, sizeof word);
+                assert(found != NULL);
+                break;
+            }
+            h = hash_word(h, word);
+            scanned += sizeof word;
+        }
+
+        if (found == NULL && available > scanned)
+        {
+            found = memchr(&p[scanned], delimiter, available - scanned);
+        }
+
+        if (found != NULL)
+        {
+            size_t length = (size_t) (found - p);
+            h = hash_tail(h, &p[scanned], length - scanned);
+            *contentLength = length;
+            *hash = hash_finish(h, length);
+            return (ssize_t) (length + 1);
+        }
+
+        bytesRead = linereader_fill(reader);
+        if (bytesRead < 0)
+        {
+            return -1;
+        }
+        if (bytesRead == 0)
+        {
+            /* Return any unterminated final line. */
+            available = reader->end - reader->start;
+            p = &reader->buffer[reader->start];
+            h = hash_tail(h, &p[scanned], available - scanned);
+            *contentLength = available;
+            *hash = hash_finish(h, available);
+            return (ssize_t) available;
+        }
+    }
+}
+
+
+/** arena_copy
+  *
+  * RETURNS:
+  *     Returns a copy of `line` in the arena of `interner`.  Returns `NULL`
+  *     on failure and sets `errno`.
+  */
+static const char*
+arena_copy(LineInterner* interner, const char* line, size_t length)
+{
+    ArenaChunk* chunk = interner->chunks;
+    char* copy;
+
+    if (length == 0)
+    {
+        return "";
+    }
+
+    if (chunk == NULL || chunk->capacity - chunk->used < length)
+    {
+        size_t capacity = (length > arenaChunkSize) ? length
+                                                    : arenaChunkSize;
+        if (capacity > (size_t) -1 - sizeof *chunk)
+        {
+            linereader_set_errno_overflow();
+            return NULL;
+        }
+
+        chunk = malloc(sizeof *chunk + capacity);
+        if (chunk == NULL)
+        {
+            errno = ENOMEM;
+            return NULL;
+        }
+        chunk->used = 0;
+        chunk->capacity = capacity;
+
+        /* A line longer than a chunk gets a chunk of its own, which is
+         * linked behind the current one so that the free space left in the
+         * current one is still used by later lines.
+         */
+        if (length > arenaChunkSize && interner->chunks != NULL)
+        {
+            chunk->next = interner->chunks->next;
+            interner->chunks->next = chunk;
+        }
+        else
+        {
+            chunk->next = interner->chunks;
+            interner->chunks = chunk;
+        }
+    }
+
+    copy = (char*) (chunk + 1) + chunk->used;
+    memcpy(copy, line, length);
+    chunk->used += length;
+    return copy;
+}
+
+
+/** grow_table
+  *
+  *     Doubles the capacity of the hash table and reinserts every line.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+static int
+grow_table(LineInterner* interner)
+{
+    size_t newCapacity = interner->tableCapacity * 2;
+    size_t* newTable;
+    size_t i;
+
+    if (newCapacity / 2 != interner->tableCapacity
+        || newCapacity > (size_t) -1 / sizeof *newTable)
+    {
+        linereader_set_errno_overflow();
+        return -1;
+    }
+
+    newTable = calloc(newCapacity, sizeof *newTable);
+    if (newTable == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (i = 0; i < interner->numLines; i++)
+    {
+        size_t slot = (size_t) interner->lines[i].hash & (newCapacity - 1);
+        while (newTable[slot] != 0)
+        {
+            slot = (slot + 1) & (newCapacity - 1);
+        }
+        newTable[slot] = i + 1;
+    }
+
+    free(interner->table);
+    interner->table = newTable;
+    interner->tableCapacity = newCapacity;
+    return 0;
+}
+
+
+/** intern_hashed
+  *
+  *     Adds an occurrence of a line whose hash has already been computed.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+static int
+intern_hashed(LineInterner* interner, const char* line, size_t length,
+              uint64_t hash, size_t* handle)
+{
+    size_t mask;
+    size_t slot;
+    InternedLine* entry;
+
+    /* Keep the table at most half full so that probe sequences stay short.
+     * Grow it beforehand so that a failure leaves the interner unchanged.
+     */
+    if (   interner->numLines + 1 > interner->tableCapacity / 2
+        && grow_table(interner) != 0)
+    {
+        return -1;
+    }
+
+    mask = interner->tableCapacity - 1;
+    for (slot = (size_t) hash & mask;
+         interner->table[slot] != 0;
+         slot = (slot + 1) & mask)
+    {
+        entry = &interner->lines[interner->table[slot] - 1];
+        if (   entry->hash == hash && entry->length == length
+            && memcmp(entry->data, line, length) == 0)
+        {
+            entry->count++;
+            *handle = interner->table[slot] - 1;
+            return 0;
+        }
+    }
+
+    if (interner->numLines == interner->linesCapacity)
+    {
+        size_t newCapacity = interner->linesCapacity * 2;
+        InternedLine* newLines;
+
+        if (newCapacity > (size_t) -1 / sizeof *newLines)
+        {
+            linereader_set_errno_overflow();
+            return -1;
+        }
+        newLines = realloc(interner->lines, newCapacity * sizeof *newLines);
+        if (newLines == NULL)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+        interner->lines = newLines;
+        interner->linesCapacity = newCapacity;
+    }
+
+    entry = &interner->lines[interner->numLines];
+    entry->data = arena_copy(interner, line, length);
+    if (entry->data == NULL)
+    {
+        return -1;
+    }
+    entry->length = length;
+    entry->count = 1;
+    entry->hash = hash;
+
+    interner->table[slot] = interner->numLines + 1;
+    *handle = interner->numLines;
+    interner->numLines++;
+    return 0;
+}
+
+
+LineInterner*
+lineinterner_new(void)
+{
+    LineInterner* interner = calloc(1, sizeof *interner);
+    if (interner == NULL)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    interner->tableCapacity = initialTableCapacity;
+    interner->linesCapacity = initialTableCapacity / 2;
+    interner->table = calloc(interner->tableCapacity,
+                             sizeof *interner->table);
+    interner->lines = malloc(interner->linesCapacity
+                             * sizeof *interner->lines);
+    if (interner->table == NULL || interner->lines == NULL)
+    {
+        lineinterner_free(interner);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return interner;
+}
+
+
+void
+lineinterner_free(LineInterner* interner)
+{
+    if (interner != NULL)
+    {
+        ArenaChunk* chunk = interner->chunks;
+        while (chunk != NULL)
+        {
+            ArenaChunk* next = chunk->next;
+            free(chunk);
+            chunk = next;
+        }
+
+        free(interner->table);
+        free(interner->lines);
+        free(interner);
+    }
+}
+
+
+int
+lineinterner_add(LineInterner* interner, const char* line, size_t length,
+                 size_t* handle)
+{
+    size_t dummy;
+
+    if (interner == NULL || (line == NULL && length > 0))
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+    return intern_hashed(interner, line, length, hash_line(line, length),
+                         (handle == NULL) ? &dummy : handle);
+}
+
+
+ssize_t
+linereader_next_interned(LineReader* reader, LineInterner* interner,
+                         int delimiter, size_t* handle)
+{
+    size_t contentLength = 0;
+    uint64_t hash = 0;
+    ssize_t length;
+
+    if (   reader == NULL || interner == NULL || handle == NULL
+        || delimiter < 0 || delimiter > UCHAR_MAX)
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+    length = scan_line(reader, delimiter, &contentLength, &hash);
+    if (length <= 0)
+    {
+        return -1;
+    }
+
+    if (intern_hashed(interner, &reader->buffer[reader->start],
+                      contentLength, hash, handle) != 0)
+    {
+        return -1;
+    }
+
+    reader->start += (size_t) length;
+    linereader_count_line(reader, (size_t) length);
+
+    assert(contentLength <= (size_t) SSIZE_MAX);
+    return (ssize_t) contentLength;
+}
+
+
+const char*
+lineinterner_line(const LineInterner* interner, size_t handle,
+                  size_t* length)
+{
+    assert(interner != NULL);
+    assert(length != NULL);
+    assert(handle < interner->numLines);
+
+    *length = interner->lines[handle].length;
+    return interner->lines[handle].data;
+}
+
+
+size_t
+lineinterner_count(const LineInterner* interner, size_t handle)
+{
+    assert(interner != NULL);
+    assert(handle < interner->numLines);
+
+    return interner->lines[handle].count;
+}
+
+
+size_t
+lineinterner_size(const LineInterner* interner)
+{
+    assert(interner != NULL);
+    return interner->numLines;
+}
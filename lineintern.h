@@ -0,0 +1,144 @@
+/** lineintern.h
+  *
+  * Deduplicating lines by interning them.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef LINEINTERN_COMPATIBLE_H
+#define LINEINTERN_COMPATIBLE_H
+
+#include <stddef.h>
+
+#include "linereader.h"
+
+
+/** LineInterner
+  *
+  *     A set of distinct lines, each stored once, with a count of how many
+  *     times it has been seen.  Lines are identified by handles, which are
+  *     assigned consecutively from 0 in the order that lines are first seen.
+  *
+  *     The contents of an interned line never move, so pointers returned by
+  *     `lineinterner_line` remain valid until the interner is freed.
+  */
+typedef struct LineInterner LineInterner;
+
+
+/** lineinterner_new
+  *
+  * RETURNS:
+  *     Returns a new, empty `LineInterner` on success.  Returns `NULL` on
+  *     failure and sets `errno`.
+  *
+  *     The caller is responsible for releasing the returned interner with
+  *     `lineinterner_free`.
+  */
+LineInterner* lineinterner_new(void);
+
+
+/** lineinterner_free
+  *
+  *     Releases an interner and all of its lines.  Does nothing if
+  *     `interner` is `NULL`.
+  */
+void lineinterner_free(LineInterner* interner);
+
+
+/** lineinterner_add
+  *
+  *     Adds an occurrence of a line.  If an identical line has been added
+  *     before, only its count is incremented; otherwise the line is copied
+  *     into the interner.
+  *
+  * PARAMETERS:
+  *     IN/OUT interner : The interner.
+  *     IN line         : The line, which need not be `NUL`-terminated.
+  *     IN length       : The length of `line`.
+  *     OUT handle      : Set to the line's handle.  May be `NULL`.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+int lineinterner_add(LineInterner* interner, const char* line, size_t length,
+                     size_t* handle);
+
+
+/** linereader_next_interned
+  *
+  *     Reads the next line and adds it to `interner`.  The line is hashed in
+  *     the same pass that searches for its delimiter, and it is not copied
+  *     unless it has not been seen before.
+  *
+  *     Line endings are not part of interned lines, so a final line without
+  *     a delimiter is identical to the same line with one.
+  *
+  * PARAMETERS:
+  *     IN/OUT reader   : The reader.
+  *     IN/OUT interner : The interner.
+  *     IN delimiter    : The line delimiter.  `LINEREADER_UNIV` is not
+  *                       supported.
+  *     OUT handle      : Set to the line's handle.
+  *
+  * RETURNS:
+  *     Returns the length of the line, excluding its delimiter.
+  *
+  *     Returns -1 at the end of the stream or on failure.  As with `getline`,
+  *     use `feof` or `ferror` on the underlying stream to distinguish the
+  *     two.
+  */
+ssize_t linereader_next_interned(LineReader* reader, LineInterner* interner,
+                                 int delimiter, size_t* handle);
+
+
+/** lineinterner_line
+  *
+  * RETURNS:
+  *     Returns a pointer to the line with the specified handle and sets
+  *     `*length` to its length.  The line is not `NUL`-terminated.
+  */
+const char* lineinterner_line(const LineInterner* interner, size_t handle,
+                              size_t* length);
+
+
+/** lineinterner_count
+  *
+  * RETURNS:
+  *     Returns the number of times that the line with the specified handle
+  *     has been added.
+  */
+size_t lineinterner_count(const LineInterner* interner, size_t handle);
+
+
+/** lineinterner_size
+  *
+  * RETURNS:
+  *     Returns the number of distinct lines in `interner`.  Valid handles
+  *     are less than this.
+  */
+size_t lineinterner_size(const LineInterner* interner);
+
+
+#endif /* LINEINTERN_COMPATIBLE_H */
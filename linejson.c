@@ -0,0 +1,343 @@
+/** linejson.c
+  *
+  * Reading newline-delimited JSON records with structural validation.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+#include "linejson.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+#include "linereader_internal.h"
+#include "linescan.h"
+
+enum
+{
+    blockSize = 64
+};
+
+/* Indices into the masks computed for each block. */
+enum
+{
+    quoteMask,
+    backslashMask,
+    openBraceMask,
+    closeBraceMask,
+    openBracketMask,
+    closeBracketMask,
+    newlineMask,
+    spaceMask,
+    tabMask,
+    crMask,
+
+    maskCount
+};
+
+static const char classes[maskCount] =
+{
+    '"', '\\', '{', '}', '[', ']', '\n', ' ', '\t', '\r'
+};
+
+#define EVEN_BITS UINT64_C(0x5555555555555555)
+#define ODD_BITS (~EVEN_BITS)
+
+
+/** JsonScanState
+  *
+  *     The state carried from one block of a record to the next.
+  */
+typedef struct
+{
+    /* All ones while inside a string at the end of the previous block. */
+    uint64_t stringCarry;
+
+    /* 1 if the previous block ended with an odd-length run of
+     * backslashes.
+     */
+    uint64_t backslashCarry;
+
+    /* Bit `i % 64` of `stack[i / 64]` is set if the container at depth `i`
+     * is an array and clear if it is an object.
+     */
+    uint64_t stack[NDJSON_MAX_DEPTH / 64];
+    size_t depth;
+
+    int sawValue;
+    int valid;
+} JsonScanState;
+
+
+/** escaped_mask
+  *
+  *     Finds the characters that are escaped by a preceding odd-length run of
+  *     backslashes.
+  *
+  * PARAMETERS:
+  *     IN backslashes : The positions of backslashes within the block.
+  *     IN/OUT carry   : On input, 1 if the previous block ended with an odd-
+  *                      length run of backslashes.  On output, the same for
+  *                      this block.
+  *
+  * RETURNS:
+  *     Returns the positions of escaped characters.
+  */
+static uint64_t
+escaped_mask(uint64_t backslashes, uint64_t* carry)
+{
+    /* Treat each run of backslashes as a number and add 1 at its start; the
+     * carry ripples to the first character after the run.  Runs that start
+     * at even positions and end at odd positions (or vice versa) have odd
+     * lengths.  (This is the approach used by simdjson.)
+     */
+    uint64_t startEdges = backslashes & ~(backslashes << 1);
+    uint64_t evenStartMask = EVEN_BITS ^ *carry;
+    uint64_t evenStarts = startEdges & evenStartMask;
+    uint64_t oddStarts = startEdges & ~evenStartMask;
+    uint64_t evenCarries = backslashes + evenStarts;
+    uint64_t oddCarries = backslashes + oddStarts;
+    uint64_t evenCarryEnds;
+    uint64_t oddCarryEnds;
+    uint64_t previousCarry = *carry;
+
+    *carry = (oddCarries < backslashes) ? 1 : 0;
+    oddCarries |= previousCarry;
+
+    evenCarryEnds = evenCarries & ~backslashes;
+    oddCarryEnds = oddCarries & ~backslashes;
+    return (evenCarryEnds & ODD_BITS) | (oddCarryEnds & EVEN_BITS);
+}
+
+
+/** scan_brackets
+  *
+  *     Checks the nesting of the braces and brackets in a block.
+  *
+  * PARAMETERS:
+  *     IN opens, closes : The positions of opening and closing braces and
+  *                        brackets outside of strings.
+  *     IN arrays        : The positions of brackets.  (Positions in `opens`
+  *                        and `closes` that are not in `arrays` are braces.)
+  *     IN/OUT state     : The scan state.
+  */
+static void
+scan_brackets(uint64_t opens, uint64_t closes, uint64_t arrays,
+              JsonScanState* state)
+{
+    uint64_t all = opens | closes;
+    for (; all != 0 && state->valid; all &= all - 1)
+    {
+        uint64_t bit = all & (0 - all);
+        uint64_t isArray = (arrays & bit) ? 1 : 0;
+
+        if (opens & bit)
+        {
+            size_t word;
+            if (state->depth == NDJSON_MAX_DEPTH)
+            {
+                state->valid = 0;
+                break;
+            }
+
+            word = state->depth / 64;
+            state->stack[word] &= ~((uint64_t) 1 << (state->depth % 64));
+            state->stack[word] |= isArray << (state->depth % 64);
+            state->depth++;
+        }
+        else
+        {
+            if (   state->depth == 0
+                || ((state->stack[(state->depth - 1) / 64]
+                     >> ((state->depth - 1) % 64)) & 1) != isArray)
+            {
+                state->valid = 0;
+                break;
+            }
+            state->depth--;
+        }
+    }
+}
+
+
+ssize_t
+linereader_next_ndjson(LineReader* reader, const char** record,
+                       int flags, int* valid)
+{
+    if (reader == NULL || record == NULL)
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+    while (true)
+    {
+        JsonScanState state;
+        size_t scanned = 0;
+        size_t length = 0;
+
+        state.stringCarry = 0;
+        state.backslashCarry = 0;
+        state.depth = 0;
+        state.sawValue = 0;
+        state.valid = 1;
+
+        while (length == 0)
+        {
+            uint64_t masks[maskCount];
+            uint64_t newline;
+            uint64_t inRecord;
+            const char* p = &reader->buffer[reader->start + scanned];
+            size_t available = reader->end - reader->start - scanned;
+            bool partial = (available < blockSize && !reader->eof);
+            JsonScanState saved;
+
+            /* In low-latency mode, a partial block is classified rather than
+             * waiting for the rest of it, since the record may already be
+             * complete.
+             */
+            if (partial && (!reader->lowLatency || available == 0))
+            {
+                if (linereader_fill(reader) < 0)
+                {
+                    return -1;
+                }
+                continue;
+            }
+            if (partial)
+            {
+                saved = state;
+            }
+
+            if (available == 0)
+            {
+                if (scanned == 0)
+                {
+                    return -1;
+                }
+
+                /* The final record is unterminated. */
+                length = scanned;
+                break;
+            }
+
+            if (available > blockSize)
+            {
+                available = blockSize;
+            }
+
+            linescan_match_masks(p, available, classes, maskCount, masks);
+
+            /* Only look at bytes before the end of the record. */
+            newline = masks[newlineMask] & (0 - masks[newlineMask]);
+            if (newline != 0)
+            {
+                inRecord = newline - 1;
+                length = scanned + LINESCAN_LOWEST_BIT64(newline) + 1;
+            }
+            else
+            {
+                inRecord = (available == blockSize)
+                           ? ~(uint64_t) 0
+                           : ((uint64_t) 1 << available) - 1;
+            }
+
+            if (state.valid)
+            {
+                uint64_t quotes = masks[quoteMask]
+                                  & ~escaped_mask(masks[backslashMask],
+                                                  &state.backslashCarry);
+                uint64_t inString = linescan_prefix_xor(quotes)
+                                    ^ state.stringCarry;
+                uint64_t outside = ~inString & inRecord;
+                uint64_t arrays = masks[openBracketMask]
+                                  | masks[closeBracketMask];
+
+                state.stringCarry = (uint64_t) 0 - (inString >> 63);
+
+                if ((inRecord & ~(masks[spaceMask] | masks[tabMask]
+                                  | masks[crMask])) != 0)
+                {
+                    state.sawValue = 1;
+                }
+
+                scan_brackets(
+                    (masks[openBraceMask] | masks[openBracketMask]) & outside,
+                    (masks[closeBraceMask] | masks[closeBracketMask])
+                        & outside,
+                    arrays, &state);
+
+                /* Backslashes may only appear in strings, and the record
+                 * must not end inside one.
+                 */
+                if (   (masks[backslashMask] & outside) != 0
+                    || (inString & newline) != 0)
+                {
+                    state.valid = 0;
+                }
+            }
+
+            if (partial && length == 0)
+            {
+                /* Scan the block again once more of it has arrived. */
+                state = saved;
+                if (linereader_fill(reader) < 0)
+                {
+                    return -1;
+                }
+                continue;
+            }
+
+            scanned += available;
+        }
+
+        if (   reader->buffer[reader->start + length - 1] != '\n'
+            && state.stringCarry != 0)
+        {
+            /* The unterminated final record ends inside a string. */
+            state.valid = 0;
+        }
+
+        if (state.depth != 0 || !state.sawValue)
+        {
+            state.valid = 0;
+        }
+
+        *record = &reader->buffer[reader->start];
+        reader->start += length;
+
+        if (state.valid || !(flags & NDJSON_SKIP_INVALID))
+        {
+            if (valid != NULL)
+            {
+                *valid = state.valid;
+            }
+
+            linereader_count_line(reader, length);
+            assert(length <= (size_t) SSIZE_MAX);
+            return (ssize_t) length;
+        }
+    }
+}
@@ -0,0 +1,85 @@
+/** linejson.h
+  *
+  * Reading newline-delimited JSON records with structural validation.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+#ifndef LINEJSON_COMPATIBLE_H
+#define LINEJSON_COMPATIBLE_H
+
+#include "linereader.h"
+
+
+/* Flags for `linereader_next_ndjson`. */
+
+/* Skip invalid records instead of returning them. */
+#define NDJSON_SKIP_INVALID 0x1
+
+/* The maximum nesting depth of records accepted by
+ * `linereader_next_ndjson`.
+ */
+#define NDJSON_MAX_DEPTH 1024
+
+
+/** linereader_next_ndjson
+  *
+  *     Retrieves a view of the next newline-delimited JSON record and checks
+  *     that it is structurally well-formed.  The check is made in the same
+  *     pass that finds the end of the record.
+  *
+  *     A record is considered well-formed if:
+  *       * it contains something other than whitespace,
+  *       * all strings are terminated (taking backslash escapes into
+  *         account) and backslashes appear only within strings, and
+  *       * braces and brackets outside of strings are balanced and properly
+  *         nested, up to a depth of `NDJSON_MAX_DEPTH`.
+  *
+  *     This is not full validation: malformed literals, numbers, and escape
+  *     sequences, missing commas and colons, and multiple values on a line
+  *     are not detected.  It is intended to keep truncated and garbled
+  *     records away from a full JSON parser cheaply.
+  *
+  *     Records end with an LF.  The LF is included in the returned length.
+  *
+  * PARAMETERS:
+  *     IN/OUT reader : The reader.
+  *     OUT record    : Set to the start of the record.
+  *     IN flags      : 0 or `NDJSON_SKIP_INVALID`.
+  *     OUT valid     : Optional.  Set to non-zero if the returned record is
+  *                     well-formed and to 0 otherwise.  Always set to non-zero
+  *                     if `NDJSON_SKIP_INVALID` is specified.
+  *
+  * RETURNS:
+  *     Returns the length of the record, including its LF.
+  *
+  *     Returns -1 at the end of the stream or on failure.  As with `getline`,
+  *     use `feof` or `ferror` on the underlying stream to distinguish the
+  *     two.
+  */
+ssize_t linereader_next_ndjson(LineReader* reader, const char** record,
+                               int flags, int* valid);
+
+
+#endif /* LINEJSON_COMPATIBLE_H */
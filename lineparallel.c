@@ -0,0 +1,600 @@
+/** lineparallel.c
+  *
+  * Applying a function to every line of a stream on a pool of threads,
+  * with results kept in order.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef _POSIX_C_SOURCE
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "lineparallel.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lineatomic_internal.h"
+#include "linereader.h"
+
+#if __STDC_VERSION__ >= 199901L
+    #include <stdbool.h>
+#else
+    typedef enum { false, true } bool;
+#endif
+
+enum
+{
+    defaultNumThreads = 4,
+    defaultBatchLines = 256,
+    defaultWindowPerThread = 4
+};
+
+
+/** Slot
+  *
+  *     A batch in the reorder window.  Batch `n` uses slot `n % window`.
+  */
+typedef struct
+{
+    LineBatch input;
+    LineBatch results;
+
+    /* Set by the worker that processed the batch. */
+    LINEATOMIC(int) done;
+    bool failed;
+} Slot;
+
+
+/** WorkQueue
+  *
+  *     A worker's queue of batch numbers.  The owner takes the oldest batch;
+  *     thieves take the newest, so that the two rarely want the same one.
+  */
+typedef struct
+{
+    pthread_mutex_t lock;
+    size_t* items;
+    size_t capacity;
+    size_t head;
+    size_t count;
+} WorkQueue;
+
+
+typedef struct Pool Pool;
+
+
+typedef struct
+{
+    Pool* pool;
+    size_t index;
+} Worker;
+
+
+struct Pool
+{
+    LineParallelFunction fn;
+    void* context;
+
+    Slot* slots;
+    size_t window;
+
+    WorkQueue* queues;
+    Worker* workers;
+    size_t numThreads;
+
+    /* The number of batches in all queues.  A batch is counted before it
+     * is pushed and uncounted after it is taken, so this never understates
+     * the contents of the queues.
+     */
+    LINEATOMIC(size_t) queued;
+
+    /* Set when a batch fails so that workers skip the remaining ones. */
+    LINEATOMIC(int) cancelled;
+
+    /* Guards the fields below and is used with the condition variables. */
+    pthread_mutex_t lock;
+    pthread_cond_t workAvailable;
+    pthread_cond_t batchDone;
+    bool finished;
+    int firstError;
+};
+
+
+static void
+set_errno_invalid(void)
+{
+#ifdef EINVAL
+    errno = EINVAL;
+#else
+    errno = EDOM;
+#endif
+}
+
+
+static void
+set_errno_cancelled(void)
+{
+#ifdef ECANCELED
+    errno = ECANCELED;
+#else
+    errno = EDOM;
+#endif
+}
+
+
+static void
+queue_push(WorkQueue* queue, size_t item)
+{
+    pthread_mutex_lock(&queue->lock);
+    assert(queue->count < queue->capacity);
+    queue->items[(queue->head + queue->count) % queue->capacity] = item;
+    queue->count++;
+    pthread_mutex_unlock(&queue->lock);
+}
+
+
+/** queue_take
+  *
+  *     Removes the oldest item from `queue` (or the newest if `steal` is
+  *     true).
+  *
+  * RETURNS:
+  *     Returns true on success.  Returns false if `queue` is empty.
+  */
+static bool
+queue_take(WorkQueue* queue, bool steal, size_t* item)
+{
+    bool found = false;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count > 0)
+    {
+        if (steal)
+        {
+            *item = queue->items[(queue->head + queue->count - 1)
+                                 % queue->capacity];
+        }
+        else
+        {
+            *item = queue->items[queue->head];
+            queue->head = (queue->head + 1) % queue->capacity;
+        }
+        queue->count--;
+        found = true;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+
+/** find_work
+  *
+  *     Takes a batch from worker `index`'s own queue or, failing that,
+  *     steals one from another worker.
+  */
+static bool
+find_work(Pool* pool, size_t index, size_t* item)
+{
+    size_t i;
+
+    if (queue_take(&pool->queues[index], false, item))
+    {
+        return true;
+    }
+
+    for (i = 1; i < pool->numThreads; i++)
+    {
+        size_t victim = (index + i) % pool->numThreads;
+        if (queue_take(&pool->queues[victim], true, item))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/** process_batch
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+static int
+process_batch(Pool* pool, Slot* slot)
+{
+    size_t i;
+
+    if (lineatomic_load(&pool->cancelled))
+    {
+        set_errno_cancelled();
+        return -1;
+    }
+
+    for (i = 0; i < slot->input.count; i++)
+    {
+        size_t length;
+        const char* line = linebatch_line(&slot->input, i, &length);
+
+        errno = 0;
+        if (pool->fn(line, length, &slot->results, pool->context) != 0)
+        {
+            if (errno == 0)
+            {
+                set_errno_cancelled();
+            }
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+static void*
+worker_main(void* arg)
+{
+    Worker* worker = arg;
+    Pool* pool = worker->pool;
+
+    while (true)
+    {
+        Slot* slot;
+        size_t item;
+
+        if (!find_work(pool, worker->index, &item))
+        {
+            bool exit = false;
+
+            pthread_mutex_lock(&pool->lock);
+            while (lineatomic_load(&pool->queued) == 0 && !pool->finished)
+            {
+                pthread_cond_wait(&pool->workAvailable, &pool->lock);
+            }
+            exit = (lineatomic_load(&pool->queued) == 0 && pool->finished);
+            pthread_mutex_unlock(&pool->lock);
+
+            if (exit)
+            {
+                return NULL;
+            }
+            continue;
+        }
+
+        lineatomic_fetch_add(&pool->queued, (size_t) -1);
+
+        slot = &pool->slots[item % pool->window];
+        slot->failed = (process_batch(pool, slot) != 0);
+
+        pthread_mutex_lock(&pool->lock);
+        if (slot->failed)
+        {
+            if (pool->firstError == 0)
+            {
+                pool->firstError = errno;
+            }
+            lineatomic_store(&pool->cancelled, 1);
+        }
+        lineatomic_store(&slot->done, 1);
+        pthread_cond_broadcast(&pool->batchDone);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+
+/** wait_for_batch
+  *
+  *     Waits until `slot` has been processed.
+  */
+static void
+wait_for_batch(Pool* pool, Slot* slot)
+{
+    if (lineatomic_load(&slot->done))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (!lineatomic_load(&slot->done))
+    {
+        pthread_cond_wait(&pool->batchDone, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+void
+lineparallel_init_options(LineParallelOptions* options)
+{
+    long numCPUs = -1;
+
+    assert(options != NULL);
+    memset(options, 0, sizeof *options);
+
+#ifdef _SC_NPROCESSORS_ONLN
+    numCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    options->delimiter = '\n';
+    options->numThreads = (numCPUs > 0) ? (size_t) numCPUs
+                                        : defaultNumThreads;
+    options->batchLines = defaultBatchLines;
+    options->window = defaultWindowPerThread * options->numThreads;
+}
+
+
+int
+parallel_for_each_line(FILE* stream, LineParallelFunction fn, void* context,
+                       const LineParallelOptions* options)
+{
+    LineParallelOptions defaultOptions;
+    Pool pool;
+    pthread_t* threads = NULL;
+    LineReader* reader = NULL;
+    size_t numQueues = 0;
+    size_t numStarted = 0;
+    size_t nextRead = 0;
+    size_t nextEmit = 0;
+    bool eof = false;
+    bool lockInitialized = false;
+    int error = 0;
+    size_t i;
+
+    if (options == NULL)
+    {
+        lineparallel_init_options(&defaultOptions);
+        options = &defaultOptions;
+    }
+
+    if (   stream == NULL || fn == NULL
+        || options->numThreads == 0 || options->batchLines == 0
+        || options->window == 0
+        || options->window > (size_t) -1 / sizeof *pool.slots
+        || options->numThreads > (size_t) -1 / sizeof *pool.queues)
+    {
+        assert(false);
+        set_errno_invalid();
+        return -1;
+    }
+
+    memset(&pool, 0, sizeof pool);
+    pool.fn = fn;
+    pool.context = context;
+    pool.window = options->window;
+    pool.numThreads = options->numThreads;
+    lineatomic_init(&pool.queued, 0);
+    lineatomic_init(&pool.cancelled, 0);
+
+    pool.slots = calloc(pool.window, sizeof *pool.slots);
+    pool.queues = calloc(pool.numThreads, sizeof *pool.queues);
+    pool.workers = calloc(pool.numThreads, sizeof *pool.workers);
+    threads = calloc(pool.numThreads, sizeof *threads);
+    if (   pool.slots == NULL || pool.queues == NULL || pool.workers == NULL
+        || threads == NULL)
+    {
+        error = ENOMEM;
+        goto exit;
+    }
+
+    if (   pthread_mutex_init(&pool.lock, NULL) != 0
+        || pthread_cond_init(&pool.workAvailable, NULL) != 0
+        || pthread_cond_init(&pool.batchDone, NULL) != 0)
+    {
+        error = ENOMEM;
+        goto exit;
+    }
+    lockInitialized = true;
+
+    for (numQueues = 0; numQueues < pool.numThreads; numQueues++)
+    {
+        WorkQueue* queue = &pool.queues[numQueues];
+        queue->capacity = pool.window;
+        queue->items = malloc(queue->capacity * sizeof *queue->items);
+        if (   queue->items == NULL
+            || pthread_mutex_init(&queue->lock, NULL) != 0)
+        {
+            free(queue->items);
+            error = ENOMEM;
+            goto exit;
+        }
+    }
+
+    reader = linereader_new(stream);
+    if (reader == NULL)
+    {
+        goto fail;
+    }
+
+    for (numStarted = 0; numStarted < pool.numThreads; numStarted++)
+    {
+        pool.workers[numStarted].pool = &pool;
+        pool.workers[numStarted].index = numStarted;
+        error = pthread_create(&threads[numStarted], NULL, worker_main,
+                               &pool.workers[numStarted]);
+        if (error != 0)
+        {
+            goto exit;
+        }
+    }
+
+    while (true)
+    {
+        Slot* slot;
+
+        /* Pass on finished batches in order.  Wait for the oldest if the
+         * window is full or if there is nothing left to read.
+         */
+        while (nextEmit < nextRead)
+        {
+            slot = &pool.slots[nextEmit % pool.window];
+            if (!lineatomic_load(&slot->done))
+            {
+                if (nextRead - nextEmit < pool.window && !eof)
+                {
+                    break;
+                }
+                wait_for_batch(&pool, slot);
+            }
+
+            if (slot->failed)
+            {
+                pthread_mutex_lock(&pool.lock);
+                error = pool.firstError;
+                pthread_mutex_unlock(&pool.lock);
+                goto exit;
+            }
+
+            if (   options->sink != NULL
+                && slot->results.count > 0)
+            {
+                errno = 0;
+                if (options->sink(&slot->results, options->sinkContext) != 0)
+                {
+                    goto fail;
+                }
+            }
+            nextEmit++;
+        }
+
+        if (eof)
+        {
+            break;
+        }
+
+        /* Read the next batch into the oldest free slot. */
+        slot = &pool.slots[nextRead % pool.window];
+        slot->input.count = 0;
+        slot->results.count = 0;
+        slot->failed = false;
+        lineatomic_store(&slot->done, 0);
+
+        while (slot->input.count < options->batchLines)
+        {
+            const char* line;
+            ssize_t length = linereader_next(reader, &line,
+                                             options->delimiter);
+            if (length < 0)
+            {
+                /* The reader also fails without setting the stream's error
+                 * indicator if it cannot grow its buffer for a long line.
+                 */
+                if (!feof(stream))
+                {
+                    goto fail;
+                }
+                eof = true;
+                break;
+            }
+
+            if (linebatch_append(&slot->input, line, (size_t) length) != 0)
+            {
+                goto fail;
+            }
+        }
+
+        if (slot->input.count > 0)
+        {
+            /* Count the batch before publishing it so that a thief's
+             * decrement cannot make `queued` wrap around.
+             */
+            lineatomic_fetch_add(&pool.queued, 1);
+            queue_push(&pool.queues[nextRead % pool.numThreads], nextRead);
+            nextRead++;
+
+            pthread_mutex_lock(&pool.lock);
+            pthread_cond_signal(&pool.workAvailable);
+            pthread_mutex_unlock(&pool.lock);
+        }
+    }
+    goto exit;
+
+fail:
+    error = errno;
+    if (error == 0)
+    {
+        set_errno_cancelled();
+        error = errno;
+    }
+
+exit:
+    if (error != 0)
+    {
+        /* Skip any batches that have not been started. */
+        lineatomic_store(&pool.cancelled, 1);
+    }
+
+    if (lockInitialized)
+    {
+        pthread_mutex_lock(&pool.lock);
+        pool.finished = true;
+        pthread_cond_broadcast(&pool.workAvailable);
+        pthread_mutex_unlock(&pool.lock);
+    }
+
+    for (i = 0; i < numStarted; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    linereader_free(reader);
+
+    for (i = 0; i < numQueues; i++)
+    {
+        pthread_mutex_destroy(&pool.queues[i].lock);
+        free(pool.queues[i].items);
+    }
+
+    if (lockInitialized)
+    {
+        pthread_cond_destroy(&pool.batchDone);
+        pthread_cond_destroy(&pool.workAvailable);
+        pthread_mutex_destroy(&pool.lock);
+    }
+
+    if (pool.slots != NULL)
+    {
+        for (i = 0; i < pool.window; i++)
+        {
+            linebatch_free(&pool.slots[i].input);
+            linebatch_free(&pool.slots[i].results);
+        }
+    }
+
+    free(pool.slots);
+    free(pool.queues);
+    free(pool.workers);
+    free(threads);
+
+    if (error != 0)
+    {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
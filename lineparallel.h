@@ -0,0 +1,131 @@
+/** lineparallel.h
+  *
+  * Applying a function to every line of a stream on a pool of threads,
+  * with results kept in order.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef LINEPARALLEL_COMPATIBLE_H
+#define LINEPARALLEL_COMPATIBLE_H
+
+#include <stdio.h>
+
+#include "getline.h"
+#include "linebatch.h"
+
+
+/** LineParallelFunction
+  *
+  *     Processes one line, appending any results to `results` with
+  *     `linebatch_append`.  Called concurrently from several threads, so
+  *     access to `context` must be thread-safe.
+  *
+  * RETURNS:
+  *     Returns 0 to continue.  Returns non-zero to stop; in that case,
+  *     `errno` should be set.
+  */
+typedef int (*LineParallelFunction)(const char* line, size_t length,
+                                    LineBatch* results, void* context);
+
+
+/** LineParallelSink
+  *
+  *     Consumes the results of a batch of lines.  Called on the thread that
+  *     called `parallel_for_each_line`, with batches in the order of the
+  *     lines that produced them.
+  *
+  * RETURNS:
+  *     Returns 0 to continue.  Returns non-zero to stop; in that case,
+  *     `errno` should be set.
+  */
+typedef int (*LineParallelSink)(const LineBatch* results, void* context);
+
+
+/** LineParallelOptions
+  *
+  *     Initialize with `lineparallel_init_options` and then override fields
+  *     as needed.
+  */
+typedef struct
+{
+    /* The line delimiter, or `LINEREADER_UNIV`.  Defaults to '\n'. */
+    int delimiter;
+
+    /* The number of worker threads.  Defaults to the number of online CPUs
+     * where that can be determined.
+     */
+    size_t numThreads;
+
+    /* The number of lines given to a worker at a time. */
+    size_t batchLines;
+
+    /* The maximum number of batches that may have been read but whose results
+     * have not yet been passed to `sink`.  This bounds memory use: if one
+     * batch is slow, reading pauses once this many batches are outstanding,
+     * even if later batches have finished.  Defaults to 4 times
+     * `numThreads`.
+     */
+    size_t window;
+
+    /* Receives results in order.  If `NULL`, results are discarded. */
+    LineParallelSink sink;
+    void* sinkContext;
+} LineParallelOptions;
+
+
+/** lineparallel_init_options
+  *
+  *     Sets `options` to defaults.
+  */
+void lineparallel_init_options(LineParallelOptions* options);
+
+
+/** parallel_for_each_line
+  *
+  *     Reads `stream` in batches of lines and runs `fn` on every line on a
+  *     pool of worker threads.  Each worker takes batches from its own queue
+  *     and steals from the other workers' queues when its own is empty, so
+  *     uneven per-line costs are balanced.  Results are reordered and passed
+  *     to `options->sink` in the original line order.
+  *
+  *     Requires POSIX threads.
+  *
+  * PARAMETERS:
+  *     IN stream  : The stream to read.
+  *     IN fn      : The function to apply to each line.
+  *     IN context : Passed to `fn`.
+  *     IN options : The options, or `NULL` for defaults.
+  *
+  * RETURNS:
+  *     Returns 0 if every line was processed.  Returns -1 on failure
+  *     (including a non-zero return from `fn` or from the sink) and sets
+  *     `errno`.  No results are passed to the sink after a failure.
+  */
+int parallel_for_each_line(FILE* stream, LineParallelFunction fn,
+                           void* context, const LineParallelOptions* options);
+
+
+#endif /* LINEPARALLEL_COMPATIBLE_H */
@@ -0,0 +1,684 @@
+/** linepipe.c
+  *
+  * A three-stage read → transform → write pipeline connected by lock-free
+  * queues.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#if defined __linux__ && !defined _GNU_SOURCE
+    /* For `pthread_setaffinity_np`. */
+    #define _GNU_SOURCE
+#endif
+#ifndef _POSIX_C_SOURCE
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "linepipe.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lineatomic_internal.h"
+#include "linereader.h"
+
+#if __STDC_VERSION__ >= 199901L
+    #include <stdbool.h>
+#else
+    typedef enum { false, true } bool;
+#endif
+
+#define ARRAY_LENGTH(a) (sizeof (a) / sizeof *(a))
+
+enum
+{
+    defaultBatchLines = 1024,
+    defaultBatchBytes = 64 * 1024,
+    defaultQueueDepth = 4,
+
+    /* Keeps each ring's producer and consumer indices on separate cache
+     * lines.
+     */
+    cacheLineSize = 64,
+
+    spinIterations = 64,
+    yieldIterations = 256
+};
+
+/* Pipeline stages. */
+enum
+{
+    stageRead,
+    stageTransform,
+    stageSink,
+    numStages
+};
+
+
+/** Ring
+  *
+  *     A bounded single-producer/single-consumer queue of batches.  A `NULL`
+  *     batch marks the end of the stream.
+  */
+typedef struct
+{
+    LineBatch** slots;
+    size_t mask;
+
+    /* The index of the next slot to read.  Written only by the consumer. */
+    LINEATOMIC(size_t) head;
+    char padding[cacheLineSize];
+
+    /* The index of the next slot to write.  Written only by the producer. */
+    LINEATOMIC(size_t) tail;
+} Ring;
+
+
+typedef struct
+{
+    FILE* stream;
+    LineReader* reader;
+    const LinePipeOptions* options;
+
+    /* Batches flow from the reader to the transformer through `filled` and
+     * back through `freeInput`, and from the transformer to the sink through
+     * `transformed` and back through `freeOutput`.
+     */
+    Ring filled;
+    Ring freeInput;
+    Ring transformed;
+    Ring freeOutput;
+
+    LineBatch* batches;
+    size_t numBatches;
+
+    /* Set when any stage fails so that the others stop waiting. */
+    LINEATOMIC(int) stop;
+
+    /* A stage that finds a ring empty for long enough sleeps on `wakeup`.
+     * `numSleeping` lets producers skip the lock when no stage is asleep.
+     */
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    LINEATOMIC(unsigned int) numSleeping;
+
+    /* The `errno` value with which each stage failed, or 0. */
+    int errors[numStages];
+} LinePipe;
+
+
+static void
+set_errno_invalid(void)
+{
+#ifdef EINVAL
+    errno = EINVAL;
+#else
+    errno = EDOM;
+#endif
+}
+
+
+static size_t
+batch_size(const LineBatch* batch)
+{
+    return (batch->count == 0) ? 0 : batch->bounds[batch->count];
+}
+
+
+/** copy_batch
+  *
+  *     The default transform.
+  */
+static int
+copy_batch(const LineBatch* input, LineBatch* output, void* context)
+{
+    size_t i;
+    (void) context;
+
+    for (i = 0; i < input->count; i++)
+    {
+        size_t length;
+        const char* line = linebatch_line(input, i, &length);
+        if (linebatch_append(output, line, length) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+/** backoff
+  *
+  *     Waits briefly for another stage to make progress, spinning at first
+  *     and then yielding the CPU.
+  *
+  * RETURNS:
+  *     Returns false once the caller has waited long enough that it should
+  *     sleep instead.
+  */
+static bool
+backoff(unsigned int* attempts)
+{
+    if (*attempts < spinIterations)
+    {
+        /* Spin. */
+    }
+    else if (*attempts < yieldIterations)
+    {
+        sched_yield();
+    }
+    else
+    {
+        return false;
+    }
+    (*attempts)++;
+    return true;
+}
+
+
+/** wake_stages
+  *
+  *     Wakes every sleeping stage.
+  */
+static void
+wake_stages(LinePipe* pipe)
+{
+    pthread_mutex_lock(&pipe->lock);
+    pthread_cond_broadcast(&pipe->wakeup);
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+
+/** stop_pipeline
+  *
+  *     Makes every stage stop waiting and return.
+  */
+static void
+stop_pipeline(LinePipe* pipe)
+{
+    lineatomic_store(&pipe->stop, 1);
+    wake_stages(pipe);
+}
+
+
+static int
+ring_init(Ring* ring, size_t minCapacity)
+{
+    size_t capacity = 1;
+    while (capacity < minCapacity)
+    {
+        capacity *= 2;
+    }
+
+    ring->slots = malloc(capacity * sizeof *ring->slots);
+    if (ring->slots == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    ring->mask = capacity - 1;
+    lineatomic_init(&ring->head, 0);
+    lineatomic_init(&ring->tail, 0);
+    return 0;
+}
+
+
+/** ring_push
+  *
+  *     Appends `batch` to `ring` and wakes any sleeping stage.  Rings are
+  *     sized to hold every batch in their pool plus the end marker, so this
+  *     never waits.
+  */
+static void
+ring_push(LinePipe* pipe, Ring* ring, LineBatch* batch)
+{
+    size_t tail = lineatomic_load(&ring->tail);
+    assert(tail - lineatomic_load(&ring->head) <= ring->mask);
+
+    ring->slots[tail & ring->mask] = batch;
+    lineatomic_store(&ring->tail, tail + 1);
+
+    /* This is a read-modify-write rather than a load so that it is ordered
+     * with the increment in `ring_pop`: either that stage sees the new tail
+     * before it sleeps, or this sees that it is asleep.
+     */
+    if (lineatomic_fetch_add(&pipe->numSleeping, 0) != 0)
+    {
+        wake_stages(pipe);
+    }
+}
+
+
+/** ring_pop
+  *
+  *     Removes the oldest batch from `ring`, waiting for one if necessary.
+  *
+  * RETURNS:
+  *     Returns true on success.  Returns false if the pipeline was stopped
+  *     while waiting.
+  */
+static bool
+ring_pop(LinePipe* pipe, Ring* ring, LineBatch** batch)
+{
+    size_t head = lineatomic_load(&ring->head);
+    unsigned int attempts = 0;
+
+    while (lineatomic_load(&ring->tail) == head)
+    {
+        if (lineatomic_load(&pipe->stop))
+        {
+            return false;
+        }
+        if (!backoff(&attempts))
+        {
+            /* Sleep until a batch is pushed, e.g. while the reader waits
+             * for a slow pipe.
+             */
+            pthread_mutex_lock(&pipe->lock);
+            lineatomic_fetch_add(&pipe->numSleeping, 1);
+            while (   lineatomic_load(&ring->tail) == head
+                   && !lineatomic_load(&pipe->stop))
+            {
+                pthread_cond_wait(&pipe->wakeup, &pipe->lock);
+            }
+            lineatomic_fetch_add(&pipe->numSleeping, (unsigned int) -1);
+            pthread_mutex_unlock(&pipe->lock);
+        }
+    }
+
+    *batch = ring->slots[head & ring->mask];
+    lineatomic_store(&ring->head, head + 1);
+    return true;
+}
+
+
+/** fail_stage
+  *
+  *     Records the current `errno` as the failure of `stage` and stops the
+  *     pipeline.
+  */
+static void
+fail_stage(LinePipe* pipe, int stage)
+{
+    if (errno == 0)
+    {
+    #ifdef ECANCELED
+        errno = ECANCELED;
+    #else
+        errno = EDOM;
+    #endif
+    }
+    pipe->errors[stage] = errno;
+    stop_pipeline(pipe);
+}
+
+
+/** pin_to_cpu
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+static int
+pin_to_cpu(int cpu)
+{
+    if (cpu < 0)
+    {
+        return 0;
+    }
+
+#if defined __linux__ && defined CPU_SET
+    {
+        cpu_set_t cpus;
+        int error;
+
+        if (cpu >= CPU_SETSIZE)
+        {
+            set_errno_invalid();
+            return -1;
+        }
+
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        error = pthread_setaffinity_np(pthread_self(), sizeof cpus, &cpus);
+        if (error != 0)
+        {
+            errno = error;
+            return -1;
+        }
+    }
+#endif
+    return 0;
+}
+
+
+static void*
+read_stage(void* arg)
+{
+    LinePipe* pipe = arg;
+    const LinePipeOptions* options = pipe->options;
+    LineBatch* batch = NULL;
+
+    errno = 0;
+    if (pin_to_cpu(options->cpus[stageRead]) != 0)
+    {
+        fail_stage(pipe, stageRead);
+        return NULL;
+    }
+
+    while (true)
+    {
+        const char* line;
+        ssize_t length;
+
+        if (batch == NULL)
+        {
+            if (!ring_pop(pipe, &pipe->freeInput, &batch))
+            {
+                return NULL;
+            }
+            batch->count = 0;
+        }
+
+        length = linereader_next(pipe->reader, &line, options->delimiter);
+        if (length < 0)
+        {
+            /* The reader also fails without setting the stream's error
+             * indicator if it cannot grow its buffer for a long line.
+             */
+            if (!feof(pipe->stream))
+            {
+                fail_stage(pipe, stageRead);
+                return NULL;
+            }
+            break;
+        }
+
+        if (linebatch_append(batch, line, (size_t) length) != 0)
+        {
+            fail_stage(pipe, stageRead);
+            return NULL;
+        }
+
+        if (   batch->count >= options->batchLines
+            || batch_size(batch) >= options->batchBytes)
+        {
+            ring_push(pipe, &pipe->filled, batch);
+            batch = NULL;
+        }
+    }
+
+    /* Drain: pass on the final partial batch, then the end marker. */
+    if (batch != NULL && batch->count > 0)
+    {
+        ring_push(pipe, &pipe->filled, batch);
+    }
+    ring_push(pipe, &pipe->filled, NULL);
+    return NULL;
+}
+
+
+static void*
+transform_stage(void* arg)
+{
+    LinePipe* pipe = arg;
+    const LinePipeOptions* options = pipe->options;
+    LinePipeTransform transform = (options->transform != NULL)
+                                  ? options->transform
+                                  : copy_batch;
+
+    errno = 0;
+    if (pin_to_cpu(options->cpus[stageTransform]) != 0)
+    {
+        fail_stage(pipe, stageTransform);
+        return NULL;
+    }
+
+    while (true)
+    {
+        LineBatch* input;
+        LineBatch* output;
+
+        if (!ring_pop(pipe, &pipe->filled, &input))
+        {
+            return NULL;
+        }
+        if (input == NULL)
+        {
+            ring_push(pipe, &pipe->transformed, NULL);
+            return NULL;
+        }
+
+        if (!ring_pop(pipe, &pipe->freeOutput, &output))
+        {
+            return NULL;
+        }
+        output->count = 0;
+
+        errno = 0;
+        if (transform(input, output, options->transformContext) != 0)
+        {
+            fail_stage(pipe, stageTransform);
+            return NULL;
+        }
+
+        ring_push(pipe, &pipe->freeInput, input);
+        ring_push(pipe, &pipe->transformed, output);
+    }
+}
+
+
+static void*
+sink_stage(void* arg)
+{
+    LinePipe* pipe = arg;
+    const LinePipeOptions* options = pipe->options;
+
+    errno = 0;
+    if (pin_to_cpu(options->cpus[stageSink]) != 0)
+    {
+        fail_stage(pipe, stageSink);
+        return NULL;
+    }
+
+    while (true)
+    {
+        LineBatch* batch;
+
+        if (!ring_pop(pipe, &pipe->transformed, &batch) || batch == NULL)
+        {
+            return NULL;
+        }
+
+        errno = 0;
+        if (options->sink(batch, options->sinkContext) != 0)
+        {
+            fail_stage(pipe, stageSink);
+            return NULL;
+        }
+
+        ring_push(pipe, &pipe->freeOutput, batch);
+    }
+}
+
+
+void
+linepipe_init_options(LinePipeOptions* options)
+{
+    size_t i;
+
+    assert(options != NULL);
+    memset(options, 0, sizeof *options);
+    options->delimiter = '\n';
+    options->batchLines = defaultBatchLines;
+    options->batchBytes = defaultBatchBytes;
+    options->queueDepth = defaultQueueDepth;
+    for (i = 0; i < ARRAY_LENGTH(options->cpus); i++)
+    {
+        options->cpus[i] = -1;
+    }
+}
+
+
+int
+linepipe_run(FILE* stream, const LinePipeOptions* options)
+{
+    LinePipe pipe;
+    pthread_t threads[numStages];
+    void* (*stages[numStages])(void*);
+    size_t numBatchesPerPool;
+    size_t numStarted = 0;
+    bool lockInitialized = false;
+    int result = -1;
+    size_t i;
+
+    stages[stageRead] = read_stage;
+    stages[stageTransform] = transform_stage;
+    stages[stageSink] = sink_stage;
+
+    memset(&pipe, 0, sizeof pipe);
+
+    if (   stream == NULL || options == NULL || options->sink == NULL
+        || options->batchLines == 0 || options->batchBytes == 0
+        || options->queueDepth == 0
+        || options->queueDepth > (size_t) -1 / 2 / sizeof *pipe.batches)
+    {
+        assert(false);
+        set_errno_invalid();
+        return -1;
+    }
+
+    pipe.stream = stream;
+    pipe.options = options;
+    lineatomic_init(&pipe.stop, 0);
+    lineatomic_init(&pipe.numSleeping, 0);
+
+    if (pthread_mutex_init(&pipe.lock, NULL) != 0)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (pthread_cond_init(&pipe.wakeup, NULL) != 0)
+    {
+        pthread_mutex_destroy(&pipe.lock);
+        errno = ENOMEM;
+        return -1;
+    }
+    lockInitialized = true;
+
+    pipe.reader = linereader_new(stream);
+    if (pipe.reader == NULL)
+    {
+        goto exit;
+    }
+
+    /* A producer can get at most a pool's worth of batches ahead of its
+     * consumer before it must wait for one to be returned.
+     */
+    numBatchesPerPool = options->queueDepth;
+    pipe.numBatches = 2 * numBatchesPerPool;
+    pipe.batches = calloc(pipe.numBatches, sizeof *pipe.batches);
+    if (pipe.batches == NULL)
+    {
+        errno = ENOMEM;
+        goto exit;
+    }
+
+    /* Room for every batch in a pool plus the end marker. */
+    if (   ring_init(&pipe.filled, numBatchesPerPool + 1) != 0
+        || ring_init(&pipe.freeInput, numBatchesPerPool + 1) != 0
+        || ring_init(&pipe.transformed, numBatchesPerPool + 1) != 0
+        || ring_init(&pipe.freeOutput, numBatchesPerPool + 1) != 0)
+    {
+        goto exit;
+    }
+
+    for (i = 0; i < numBatchesPerPool; i++)
+    {
+        ring_push(&pipe, &pipe.freeInput, &pipe.batches[i]);
+        ring_push(&pipe, &pipe.freeOutput,
+                  &pipe.batches[numBatchesPerPool + i]);
+    }
+
+    for (numStarted = 0; numStarted < numStages; numStarted++)
+    {
+        int error = pthread_create(&threads[numStarted], NULL,
+                                   stages[numStarted], &pipe);
+        if (error != 0)
+        {
+            pipe.errors[numStarted] = error;
+            stop_pipeline(&pipe);
+            break;
+        }
+    }
+
+    for (i = 0; i < numStarted; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    result = 0;
+    for (i = 0; i < numStages; i++)
+    {
+        if (pipe.errors[i] != 0)
+        {
+            errno = pipe.errors[i];
+            result = -1;
+            break;
+        }
+    }
+
+exit:
+    {
+        int savedErrno = errno;
+
+        linereader_free(pipe.reader);
+        if (pipe.batches != NULL)
+        {
+            for (i = 0; i < pipe.numBatches; i++)
+            {
+                linebatch_free(&pipe.batches[i]);
+            }
+            free(pipe.batches);
+        }
+        free(pipe.filled.slots);
+        free(pipe.freeInput.slots);
+        free(pipe.transformed.slots);
+        free(pipe.freeOutput.slots);
+
+        if (lockInitialized)
+        {
+            pthread_cond_destroy(&pipe.wakeup);
+            pthread_mutex_destroy(&pipe.lock);
+        }
+
+        errno = savedErrno;
+    }
+    return result;
+}
@@ -0,0 +1,130 @@
+/** linepipe.h
+  *
+  * A three-stage read → transform → write pipeline connected by lock-free
+  * queues.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef LINEPIPE_COMPATIBLE_H
+#define LINEPIPE_COMPATIBLE_H
+
+#include <stdio.h>
+
+#include "getline.h"
+#include "linebatch.h"
+
+
+/** LinePipeTransform
+  *
+  *     Transforms the lines of `input` into lines appended to `output` (with
+  *     `linebatch_append`).  `output` is empty on entry.
+  *
+  * RETURNS:
+  *     Returns 0 to continue.  Returns non-zero to stop the pipeline; in that
+  *     case, `errno` should be set.
+  */
+typedef int (*LinePipeTransform)(const LineBatch* input, LineBatch* output,
+                                 void* context);
+
+
+/** LinePipeSink
+  *
+  *     Consumes a transformed batch (e.g. by writing it out).
+  *
+  * RETURNS:
+  *     Returns 0 to continue.  Returns non-zero to stop the pipeline; in that
+  *     case, `errno` should be set.
+  */
+typedef int (*LinePipeSink)(const LineBatch* batch, void* context);
+
+
+/** LinePipeOptions
+  *
+  *     Initialize with `linepipe_init_options` and then override fields as
+  *     needed.
+  */
+typedef struct
+{
+    /* The line delimiter, or `LINEREADER_UNIV`.  Defaults to '\n'. */
+    int delimiter;
+
+    /* A batch is passed on once it holds this many lines or bytes. */
+    size_t batchLines;
+    size_t batchBytes;
+
+    /* The number of batches in flight between adjacent stages (including
+     * those being filled and drained).  A stage that gets this far ahead of
+     * the next one waits for it to return a batch (backpressure), which also
+     * bounds memory use.
+     */
+    size_t queueDepth;
+
+    /* The CPUs to pin the reading, transforming, and sink threads to, or -1
+     * not to pin them.  Pinning is supported only on Linux and is ignored
+     * elsewhere.  Defaults to -1.
+     */
+    int cpus[3];
+
+    /* Required.  If `transform` is `NULL`, input batches are passed to
+     * `sink` unchanged.
+     */
+    LinePipeTransform transform;
+    void* transformContext;
+    LinePipeSink sink;
+    void* sinkContext;
+} LinePipeOptions;
+
+
+/** linepipe_init_options
+  *
+  *     Sets `options` to defaults.  `sink` must still be set.
+  */
+void linepipe_init_options(LinePipeOptions* options);
+
+
+/** linepipe_run
+  *
+  *     Reads lines from `stream` on one thread, transforms them on a second,
+  *     and passes them to the sink on a third, so that the three stages
+  *     overlap.  Batches move between stages through bounded
+  *     single-producer/single-consumer rings and are recycled rather than
+  *     reallocated.
+  *
+  *     Returns once every line has been read, transformed, and passed to the
+  *     sink, or once any stage fails, in which case the other stages stop
+  *     early.
+  *
+  *     Requires POSIX threads.
+  *
+  * RETURNS:
+  *     Returns 0 if the whole stream was processed.  Returns -1 on failure
+  *     (including a non-zero return from `transform` or `sink`) and sets
+  *     `errno`.
+  */
+int linepipe_run(FILE* stream, const LinePipeOptions* options);
+
+
+#endif /* LINEPIPE_COMPATIBLE_H */
@@ -0,0 +1,981 @@
+/** linereader.c
+  *
+  * A block-buffered line reader that returns views into its buffer.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+#include "linereader.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "linereader_internal.h"
+#include "linescan.h"
+
+enum
+{
+#ifdef NDEBUG
+    initialBufferSize = 64 * 1024,
+    initialFieldCapacity = 16,
+    initialLineSize = 128
+#else
+    /* Use small sizes in debug builds to exercise refills and growth. */
+    initialBufferSize = 37,
+    initialFieldCapacity = 2,
+    initialLineSize = 1
+#endif /* NDEBUG */
+};
+
+
+void
+linereader_set_errno_invalid(void)
+{
+#ifdef EINVAL
+    errno = EINVAL;
+#else
+    errno = EDOM;
+#endif
+}
+
+
+void
+linereader_set_errno_overflow(void)
+{
+#ifdef EOVERFLOW
+    errno = EOVERFLOW;
+#else
+    errno = ERANGE;
+#endif
+}
+
+
+#ifdef LINEREADER_STATS
+void
+linereader_count_line(LineReader* reader, size_t length)
+{
+    size_t bucket = 0;
+    size_t remaining = length;
+
+    while (remaining > 0 && bucket < LINEREADER_HISTOGRAM_BUCKETS - 1)
+    {
+        remaining >>= 1;
+        bucket++;
+    }
+
+    reader->stats.lines++;
+    reader->stats.lineBytes += length;
+    if (length > reader->stats.maxLineLength)
+    {
+        reader->stats.maxLineLength = length;
+    }
+    reader->stats.lengthHistogram[bucket]++;
+}
+#endif /* LINEREADER_STATS */
+
+
+/** read_through_delimiter
+  *
+  *     Reads into `buffer` until after the next low-latency delimiter, until
+  *     `size` bytes have been read, or until the end of the stream.
+  *
+  * RETURNS:
+  *     Returns the number of bytes read.
+  */
+static size_t
+read_through_delimiter(LineReader* reader, char* buffer, size_t size)
+{
+    int delimiter = reader->lowLatencyDelimiter;
+    size_t count = 0;
+
+    while (count < size)
+    {
+        int c = getc(reader->stream);
+        if (c == EOF)
+        {
+            break;
+        }
+
+        buffer[count++] = (char) c;
+        if (   c == delimiter
+            || (delimiter == LINEREADER_UNIV && (c == '\n' || c == '\r')))
+        {
+            break;
+        }
+    }
+    return count;
+}
+
+
+ssize_t
+linereader_fill(LineReader* reader)
+{
+    size_t bytesRead;
+
+    if (reader->eof)
+    {
+        return 0;
+    }
+
+    if (reader->start > 0)
+    {
+        LINEREADER_COUNT(reader, bytesMoved, reader->end - reader->start);
+        memmove(reader->buffer, &reader->buffer[reader->start],
+                reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+    }
+
+    if (reader->end == reader->capacity)
+    {
+        char* newBuffer;
+        if (reader->capacity > (size_t) SSIZE_MAX / 2)
+        {
+            linereader_set_errno_overflow();
+            return -1;
+        }
+
+        newBuffer = realloc(reader->buffer, reader->capacity * 2);
+        if (newBuffer == NULL)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+        reader->buffer = newBuffer;
+        reader->capacity *= 2;
+        LINEREADER_COUNT(reader, reallocs, 1);
+    }
+
+    bytesRead = reader->lowLatency
+                ? read_through_delimiter(reader, &reader->buffer[reader->end],
+                                         reader->capacity - reader->end)
+                : fread(&reader->buffer[reader->end], 1,
+                        reader->capacity - reader->end, reader->stream);
+    LINEREADER_COUNT(reader, reads, 1);
+    if (bytesRead == 0)
+    {
+        if (ferror(reader->stream))
+        {
+            return -1;
+        }
+        reader->eof = true;
+        return 0;
+    }
+
+    reader->end += bytesRead;
+    LINEREADER_COUNT(reader, refills, 1);
+    LINEREADER_COUNT(reader, bytesRead, bytesRead);
+    return (ssize_t) bytesRead;
+}
+
+
+ssize_t
+linereader_find_line_end(LineReader* reader, int delimiter)
+{
+    size_t scanned = 0;
+
+    while (true)
+    {
+        const char* p = &reader->buffer[reader->start + scanned];
+        size_t available = reader->end - reader->start - scanned;
+        const char* found = NULL;
+        ssize_t bytesRead;
+
+        if (available > 0)
+        {
+            if (delimiter == LINEREADER_UNIV)
+            {
+                size_t remaining = 1;
+                int afterCR = 0;
+                found = linescan_find_nth_univ(p, available, &remaining,
+                                               &afterCR);
+            }
+            else
+            {
+                found = memchr(p, delimiter, available);
+            }
+        }
+
+        if (found != NULL)
+        {
+            size_t length = (size_t) (found - &reader->buffer[reader->start])
+                            + 1;
+            if (delimiter == LINEREADER_UNIV && *found == '\r')
+            {
+                /* Check whether this is a CR-LF sequence. */
+                while (   reader->start + length == reader->end
+                       && !reader->eof)
+                {
+                    if (linereader_fill(reader) < 0)
+                    {
+                        return -1;
+                    }
+                }
+
+                if (   reader->start + length < reader->end
+                    && reader->buffer[reader->start + length] == '\n')
+                {
+                    length++;
+                    LINEREADER_COUNT(reader, crlfLineEndings, 1);
+                }
+            }
+            return (ssize_t) length;
+        }
+
+        scanned += available;
+
+        bytesRead = linereader_fill(reader);
+        if (bytesRead < 0)
+        {
+            return -1;
+        }
+        if (bytesRead == 0)
+        {
+            /* Return any unterminated final line. */
+            return (ssize_t) (reader->end - reader->start);
+        }
+    }
+}
+
+
+int
+linefields_reserve(LineFields* fields, size_t capacity)
+{
+    size_t newCapacity = (fields->capacity == 0)
+                         ? initialFieldCapacity
+                         : fields->capacity;
+    size_t* newBounds;
+
+    while (newCapacity < capacity)
+    {
+        if (newCapacity > (size_t) -1 / sizeof *newBounds / 2)
+        {
+            linereader_set_errno_overflow();
+            return -1;
+        }
+        newCapacity *= 2;
+    }
+
+    if (newCapacity == fields->capacity)
+    {
+        return 0;
+    }
+
+    newBounds = realloc(fields->bounds, newCapacity * sizeof *newBounds);
+    if (newBounds == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    fields->bounds = newBounds;
+    fields->capacity = newCapacity;
+    return 0;
+}
+
+
+LineReader*
+linereader_new(FILE* stream)
+{
+    LineReader* reader;
+
+    if (stream == NULL)
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return NULL;
+    }
+
+    reader = calloc(1, sizeof *reader);
+    if (reader == NULL)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    reader->buffer = malloc(initialBufferSize);
+    if (reader->buffer == NULL)
+    {
+        free(reader);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    reader->stream = stream;
+    reader->capacity = initialBufferSize;
+    return reader;
+}
+
+
+void
+linereader_free(LineReader* reader)
+{
+    if (reader != NULL)
+    {
+        free(reader->buffer);
+        free(reader);
+    }
+}
+
+
+int
+linereader_reset(LineReader* reader, FILE* stream)
+{
+    if (reader == NULL || stream == NULL)
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+    reader->stream = stream;
+    reader->start = 0;
+    reader->end = 0;
+    reader->eof = false;
+    return 0;
+}
+
+
+int
+linereader_set_low_latency(LineReader* reader, int delimiter)
+{
+    if (   reader == NULL
+        || (   delimiter != EOF && delimiter != LINEREADER_UNIV
+            && (delimiter < 0 || delimiter > UCHAR_MAX)))
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+    reader->lowLatency = (delimiter != EOF);
+    reader->lowLatencyDelimiter = delimiter;
+    return 0;
+}
+
+
+ssize_t
+linereader_next(LineReader* reader, const char** line, int delimiter)
+{
+    ssize_t length;
+
+    if (reader == NULL || line == NULL)
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+    length = linereader_find_line_end(reader, delimiter);
+    if (length <= 0)
+    {
+        return -1;
+    }
+
+    *line = &reader->buffer[reader->start];
+    reader->start += (size_t) length;
+    linereader_count_line(reader, (size_t) length);
+    return length;
+}
+
+
+ssize_t
+linereader_next_fields(LineReader* reader, const char** line,
+                       int delimiter, int separator, LineFields* fields)
+{
+    size_t scanned = 0;
+    size_t numSeparators = 0;
+    size_t contentLength;
+    size_t length;
+
+    if (   reader == NULL || line == NULL || fields == NULL
+        || delimiter == LINEREADER_UNIV)
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+    if (linefields_reserve(fields, 2) != 0)
+    {
+        return -1;
+    }
+    fields->bounds[0] = 0;
+
+    while (true)
+    {
+        size_t available = reader->end - reader->start - scanned;
+        ssize_t bytesRead;
+
+        if (available > 0)
+        {
+            /* Reserve the last slot for the end of the final field. */
+            size_t* positions = &fields->bounds[1 + numSeparators];
+            size_t maxPositions = fields->capacity - 2 - numSeparators;
+            size_t numPositions;
+            size_t i;
+            int foundDelimiter;
+
+            size_t consumed = linescan_fields(
+                &reader->buffer[reader->start + scanned], available,
+                delimiter, separator,
+                positions, maxPositions, &numPositions, &foundDelimiter);
+
+            /* Convert separator offsets to field starts. */
+            for (i = 0; i < numPositions; i++)
+            {
+                positions[i] += scanned + 1;
+            }
+            numSeparators += numPositions;
+            scanned += consumed;
+
+            if (foundDelimiter)
+            {
+                length = scanned;
+                contentLength = length - 1;
+                break;
+            }
+
+            if (consumed < available)
+            {
+                if (linefields_reserve(fields, fields->capacity + 1) != 0)
+                {
+                    return -1;
+                }
+                continue;
+            }
+        }
+
+        bytesRead = linereader_fill(reader);
+        if (bytesRead < 0)
+        {
+            return -1;
+        }
+        if (bytesRead == 0)
+        {
+            if (scanned == 0)
+            {
+                return -1;
+            }
+            length = contentLength = scanned;
+            break;
+        }
+    }
+
+    fields->bounds[numSeparators + 1] = contentLength + 1;
+    fields->count = numSeparators + 1;
+
+    *line = &reader->buffer[reader->start];
+    reader->start += length;
+    linereader_count_line(reader, length);
+
+    assert(length <= (size_t) SSIZE_MAX);
+    return (ssize_t) length;
+}
+
+
+int
+linereader_get_stats(const LineReader* reader, LineReaderStats* stats)
+{
+    if (reader == NULL || stats == NULL)
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+#ifdef LINEREADER_STATS
+    *stats = reader->stats;
+    return 0;
+#else
+    #ifdef ENOSYS
+        errno = ENOSYS;
+    #else
+        errno = EDOM;
+    #endif
+    return -1;
+#endif
+}
+
+
+/** copy_prefix
+  *
+  *     Copies the part of `p` that falls within the first `prefixSize` bytes
+  *     of a line, given that `length` bytes of the line precede `p`.
+  */
+static void
+copy_prefix(char* prefix, size_t prefixSize, size_t length,
+            const char* p, size_t count)
+{
+    if (length < prefixSize)
+    {
+        if (count > prefixSize - length)
+        {
+            count = prefixSize - length;
+        }
+        memcpy(&prefix[length], p, count);
+    }
+}
+
+
+ssize_t
+linereader_next_prefix(LineReader* reader, char* prefix, size_t prefixSize,
+                       int delimiter)
+{
+    size_t length = 0;
+
+    if (reader == NULL || (prefix == NULL && prefixSize > 0))
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+    while (true)
+    {
+        const char* p = &reader->buffer[reader->start];
+        size_t available = reader->end - reader->start;
+        const char* found = NULL;
+        size_t count;
+        ssize_t bytesRead;
+
+        if (available > 0)
+        {
+            if (delimiter == LINEREADER_UNIV)
+            {
+                size_t remaining = 1;
+                int afterCR = 0;
+                found = linescan_find_nth_univ(p, available, &remaining,
+                                               &afterCR);
+            }
+            else
+            {
+                found = memchr(p, delimiter, available);
+            }
+        }
+
+        count = (found != NULL) ? (size_t) (found - p) + 1 : available;
+        if (count > (size_t) SSIZE_MAX - length)
+        {
+            linereader_set_errno_overflow();
+            return -1;
+        }
+
+        copy_prefix(prefix, prefixSize, length, p, count);
+        length += count;
+
+        /* Consume what was scanned so that the next fill reuses the space
+         * instead of growing the buffer.
+         */
+        reader->start += count;
+
+        if (found != NULL)
+        {
+            if (delimiter == LINEREADER_UNIV && *found == '\r')
+            {
+                /* Check whether this is a CR-LF sequence. */
+                while (reader->start == reader->end && !reader->eof)
+                {
+                    if (linereader_fill(reader) < 0)
+                    {
+                        return -1;
+                    }
+                }
+
+                if (   reader->start < reader->end
+                    && reader->buffer[reader->start] == '\n'
+                    && length < (size_t) SSIZE_MAX)
+                {
+                    copy_prefix(prefix, prefixSize, length,
+                                &reader->buffer[reader->start], 1);
+                    length++;
+                    reader->start++;
+                    LINEREADER_COUNT(reader, crlfLineEndings, 1);
+                }
+            }
+            break;
+        }
+
+        bytesRead = linereader_fill(reader);
+        if (bytesRead < 0)
+        {
+            return -1;
+        }
+        if (bytesRead == 0)
+        {
+            if (length == 0)
+            {
+                return -1;
+            }
+            /* The final line is unterminated. */
+            break;
+        }
+    }
+
+    linereader_count_line(reader, length);
+    return (ssize_t) length;
+}
+
+
+/** content_length
+  *
+  * RETURNS:
+  *     Returns the length of `line` without its line ending, if any.
+  */
+static size_t
+content_length(const char* line, size_t length, int delimiter)
+{
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    if (delimiter != LINEREADER_UNIV)
+    {
+        return (line[length - 1] == (char) delimiter) ? length - 1 : length;
+    }
+
+    if (line[length - 1] == '\n')
+    {
+        length--;
+        if (length > 0 && line[length - 1] == '\r')
+        {
+            length--;
+        }
+    }
+    else if (line[length - 1] == '\r')
+    {
+        length--;
+    }
+    return length;
+}
+
+
+/** reserve_line
+  *
+  *     Ensures that a `getline`-style buffer can hold at least `size`
+  *     characters, growing it geometrically.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+static int
+reserve_line(char** lineptr, size_t* n, size_t size)
+{
+    size_t newSize = *n;
+    char* newLine;
+
+    if (*lineptr != NULL && newSize >= size)
+    {
+        return 0;
+    }
+
+    if (newSize == 0)
+    {
+        newSize = initialLineSize;
+    }
+
+    while (newSize < size)
+    {
+        if (newSize > (size_t) SSIZE_MAX / 2)
+        {
+            linereader_set_errno_overflow();
+            return -1;
+        }
+        newSize *= 2;
+    }
+
+    newLine = realloc(*lineptr, newSize);
+    if (newLine == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    *lineptr = newLine;
+    *n = newSize;
+    return 0;
+}
+
+
+/** is_space
+  *
+  * RETURNS:
+  *     Returns true if `c` is ASCII whitespace.  Unlike `isspace`, does not
+  *     depend on the locale.
+  */
+static bool
+is_space(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+
+/** finish_line
+  *
+  *     Applies the transforms requested by `options` to the end of a line.
+  *
+  * RETURNS:
+  *     Returns the new length of the line.
+  */
+static size_t
+finish_line(char* line, size_t length, int delimiter, int options)
+{
+    size_t contentLength = content_length(line, length, delimiter);
+    size_t endingLength = length - contentLength;
+    char ending[2];
+
+    assert(endingLength <= sizeof ending);
+    memcpy(ending, &line[contentLength], endingLength);
+
+    if (options & LINEREADER_STRIP_CR)
+    {
+        if (delimiter == LINEREADER_UNIV)
+        {
+            if (endingLength > 0)
+            {
+                ending[0] = '\n';
+                endingLength = 1;
+            }
+        }
+        else if (contentLength > 0 && line[contentLength - 1] == '\r')
+        {
+            contentLength--;
+        }
+    }
+
+    if (options & LINEREADER_TRIM)
+    {
+        while (contentLength > 0 && is_space(line[contentLength - 1]))
+        {
+            contentLength--;
+        }
+    }
+
+    if (options & LINEREADER_STRIP_NEWLINE)
+    {
+        endingLength = 0;
+    }
+
+    memcpy(&line[contentLength], ending, endingLength);
+    return contentLength + endingLength;
+}
+
+
+ssize_t
+linereader_getdelim(LineReader* reader, char** lineptr, size_t* n,
+                    int delimiter, int options)
+{
+    size_t lineLength = 0;
+    bool foundLine = false;
+    bool atLineStart = true;
+
+    const int allOptions = LINEREADER_JOIN_CONTINUATIONS
+                           | LINEREADER_STRIP_NEWLINE
+                           | LINEREADER_STRIP_CR
+                           | LINEREADER_TRIM
+                           | LINEREADER_LOWERCASE;
+
+    if (   reader == NULL || lineptr == NULL || n == NULL
+        || (options & ~allOptions) != 0)
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+    while (true)
+    {
+        const char* physicalLine;
+        size_t contentLength;
+        size_t copyLength;
+        size_t skipLength = 0;
+        bool continued = false;
+        ssize_t length = linereader_find_line_end(reader, delimiter);
+        if (length < 0)
+        {
+            return -1;
+        }
+        if (length == 0)
+        {
+            break;
+        }
+
+        physicalLine = &reader->buffer[reader->start];
+        copyLength = (size_t) length;
+        contentLength = content_length(physicalLine, copyLength, delimiter);
+
+        if (   (options & LINEREADER_JOIN_CONTINUATIONS)
+            && contentLength < copyLength
+            && contentLength > 0
+            && physicalLine[contentLength - 1] == '\\')
+        {
+            /* Drop the backslash and the line ending. */
+            copyLength = contentLength = contentLength - 1;
+            continued = true;
+        }
+
+        if ((options & LINEREADER_TRIM) && atLineStart)
+        {
+            /* Leading whitespace is never copied.  Trailing whitespace is
+             * removed by `finish_line`.
+             */
+            while (   skipLength < contentLength
+                   && is_space(physicalLine[skipLength]))
+            {
+                skipLength++;
+            }
+        }
+        if (skipLength < contentLength)
+        {
+            atLineStart = false;
+        }
+        copyLength -= skipLength;
+
+        if (lineLength + copyLength >= (size_t) SSIZE_MAX)
+        {
+            linereader_set_errno_overflow();
+            return -1;
+        }
+
+        if (reserve_line(lineptr, n, lineLength + copyLength + 1) != 0)
+        {
+            return -1;
+        }
+
+        if (options & LINEREADER_LOWERCASE)
+        {
+            linescan_copy_lower(&(*lineptr)[lineLength],
+                                &physicalLine[skipLength], copyLength);
+        }
+        else
+        {
+            memcpy(&(*lineptr)[lineLength], &physicalLine[skipLength],
+                   copyLength);
+        }
+        lineLength += copyLength;
+        reader->start += (size_t) length;
+        foundLine = true;
+
+        if (!continued)
+        {
+            break;
+        }
+    }
+
+    if (!foundLine)
+    {
+        return -1;
+    }
+
+    if (options & (LINEREADER_STRIP_NEWLINE | LINEREADER_STRIP_CR
+                   | LINEREADER_TRIM))
+    {
+        lineLength = finish_line(*lineptr, lineLength, delimiter, options);
+    }
+
+    (*lineptr)[lineLength] = '\0';
+    linereader_count_line(reader, lineLength);
+    return (ssize_t) lineLength;
+}
+
+
+ssize_t
+linereader_next_str(LineReader* reader, const char** line,
+                    const char* delimiter, size_t delimiterLength)
+{
+    size_t searchFrom = 0;
+    size_t length;
+
+    if (   reader == NULL || line == NULL
+        || delimiter == NULL || delimiterLength == 0)
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+    while (true)
+    {
+        size_t available = reader->end - reader->start;
+        ssize_t bytesRead;
+
+        if (available > searchFrom)
+        {
+            const char* found = linescan_find_str(
+                &reader->buffer[reader->start + searchFrom],
+                available - searchFrom, delimiter, delimiterLength);
+            if (found != NULL)
+            {
+                length = (size_t) (found - &reader->buffer[reader->start])
+                         + delimiterLength;
+                break;
+            }
+
+            /* A delimiter might straddle the end of the buffered data, so
+             * rescan its last `delimiterLength - 1` bytes after refilling.
+             */
+            if (available - searchFrom >= delimiterLength)
+            {
+                searchFrom = available - (delimiterLength - 1);
+            }
+        }
+
+        bytesRead = linereader_fill(reader);
+        if (bytesRead < 0)
+        {
+            return -1;
+        }
+        if (bytesRead == 0)
+        {
+            if (available == 0)
+            {
+                return -1;
+            }
+            /* Return any unterminated final line. */
+            length = available;
+            break;
+        }
+    }
+
+    *line = &reader->buffer[reader->start];
+    reader->start += length;
+    linereader_count_line(reader, length);
+
+    assert(length <= (size_t) SSIZE_MAX);
+    return (ssize_t) length;
+}
+
+
+void
+linefields_free(LineFields* fields)
+{
+    LineFields emptyFields = LINEFIELDS_INIT;
+
+    assert(fields != NULL);
+    free(fields->bounds);
+    *fields = emptyFields;
+}
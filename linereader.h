@@ -0,0 +1,366 @@
+/** linereader.h
+  *
+  * A block-buffered line reader that returns views into its buffer.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef LINEREADER_COMPATIBLE_H
+#define LINEREADER_COMPATIBLE_H
+
+#include <stdio.h>
+
+#include "getline.h"
+
+
+/** LineReader
+  *
+  *     Reads a stream in large blocks and returns lines as views into its
+  *     internal buffer, avoiding the per-line copy made by `getline`.
+  *
+  *     Views returned by a `LineReader` are not `NUL`-terminated and remain
+  *     valid only until the next call that reads from the same reader.
+  *
+  *     A `LineReader` takes over reading `stream`; reading `stream` directly
+  *     while a reader is attached to it will skip data that the reader has
+  *     buffered.
+  */
+typedef struct LineReader LineReader;
+
+
+/* Pass as a delimiter to recognize CR, LF, or CR-LF as line endings, as with
+ * `getline_univ`.
+ */
+#define LINEREADER_UNIV (-2)
+
+
+/* Options for `linereader_getdelim`, which may be combined. */
+
+/* Join lines that end with a backslash immediately before the line ending to
+ * the following line, removing the backslash and the line ending.
+ */
+#define LINEREADER_JOIN_CONTINUATIONS 0x1
+
+/* Remove the line ending, as `fggets` does. */
+#define LINEREADER_STRIP_NEWLINE 0x2
+
+/* Remove a CR preceding the line delimiter, so that CR-LF line endings become
+ * LF.  With `LINEREADER_UNIV`, translate all line endings to LF, as
+ * `getline_univ` does.
+ */
+#define LINEREADER_STRIP_CR 0x4
+
+/* Remove leading and trailing ASCII whitespace (before the line ending). */
+#define LINEREADER_TRIM 0x8
+
+/* Convert ASCII uppercase letters to lowercase. */
+#define LINEREADER_LOWERCASE 0x10
+
+
+/** LineFields
+  *
+  *     The field boundaries of a delimited record.
+  *
+  *     Field `i` (0 <= `i` < `count`) of `line` begins at
+  *     `line + bounds[i]` and is `bounds[i + 1] - bounds[i] - 1` bytes long
+  *     (i.e., each boundary is one past the separator that precedes the
+  *     field).
+  *
+  *     Initialize with `LINEFIELDS_INIT`.  The `bounds` array is reused and
+  *     grown as needed across calls and must be released with
+  *     `linefields_free`.
+  */
+typedef struct
+{
+    size_t* bounds;
+    size_t count;
+    size_t capacity;
+} LineFields;
+
+#define LINEFIELDS_INIT { NULL, 0, 0 }
+
+
+/* The number of buckets in `LineReaderStats::lengthHistogram`. */
+#define LINEREADER_HISTOGRAM_BUCKETS 32
+
+
+/** LineReaderStats
+  *
+  *     Counters describing the work done by a reader, for diagnosing whether
+  *     time is spent on I/O, on buffer management, or on scanning.
+  *
+  *     Counters are maintained only if the library is compiled with
+  *     `LINEREADER_STATS` defined.  Otherwise they cost nothing, and
+  *     `linereader_get_stats` fails.
+  */
+typedef struct
+{
+    /* Lines (or records) returned, and their total length in bytes. */
+    size_t lines;
+    size_t lineBytes;
+    size_t maxLineLength;
+
+    /* Bytes read from the stream. */
+    size_t bytesRead;
+
+    /* Calls to `fread`.  Each may make zero or more system calls, depending
+     * on the stream's buffering.
+     */
+    size_t reads;
+
+    /* Times the buffer was refilled with new data. */
+    size_t refills;
+
+    /* Times the buffer was grown with `realloc` to hold a long line. */
+    size_t reallocs;
+
+    /* Bytes of unconsumed data moved to the front of the buffer before
+     * refills.
+     */
+    size_t bytesMoved;
+
+    /* CR-LF line endings recognized by `LINEREADER_UNIV`. */
+    size_t crlfLineEndings;
+
+    /* Bucket 0 counts lines of length 0.  Bucket `i` (for `i` > 0) counts
+     * lines whose length is at least 2^(i - 1) and less than 2^i, except
+     * that the final bucket also counts all longer lines.
+     */
+    size_t lengthHistogram[LINEREADER_HISTOGRAM_BUCKETS];
+} LineReaderStats;
+
+
+/** linereader_new
+  *
+  * RETURNS:
+  *     Returns a new `LineReader` for `stream` on success.  Returns `NULL` on
+  *     failure and sets `errno`.
+  *
+  *     The caller is responsible for releasing the returned reader with
+  *     `linereader_free`.
+  */
+LineReader* linereader_new(FILE* stream);
+
+
+/** linereader_free
+  *
+  *     Releases a reader returned by `linereader_new`.  Does not close the
+  *     underlying stream.  Does nothing if `reader` is `NULL`.
+  */
+void linereader_free(LineReader* reader);
+
+
+/** linereader_reset
+  *
+  *     Points a reader at a different stream, discarding any data buffered
+  *     from the previous one.  The reader's buffer is kept, so reading many
+  *     small streams this way does not allocate per stream.  Low-latency mode
+  *     and any counters are unchanged.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+int linereader_reset(LineReader* reader, FILE* stream);
+
+
+/** linereader_set_low_latency
+  *
+  *     Switches a reader between block reads and low-latency reads.
+  *
+  *     By default, a reader fills its buffer with `fread`, which may wait for
+  *     a whole block of data to arrive even when complete lines are already
+  *     available (e.g. when reading from a pipe or a terminal).  In
+  *     low-latency mode, each refill instead reads only up to and including
+  *     the next `delimiter` byte, so a line is returned as soon as its
+  *     delimiter arrives.  This costs a `getc` call per byte.  Readers that
+  *     scan in fixed-size blocks, such as `linereader_next_csv` and
+  *     `linereader_next_ndjson`, also stop waiting for a full block.
+  *
+  *     With `LINEREADER_UNIV`, refills stop after each CR or LF.  (A line
+  *     that ends with CR is still returned only once the next byte or the end
+  *     of the stream arrives, since that byte might be LF.)
+  *
+  * PARAMETERS:
+  *     IN/OUT reader : The reader.
+  *     IN delimiter  : The delimiter that the reader will be used with,
+  *                     `LINEREADER_UNIV`, or `EOF` to restore block reads.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+int linereader_set_low_latency(LineReader* reader, int delimiter);
+
+
+/** linereader_next
+  *
+  *     Retrieves a view of the next line.
+  *
+  * PARAMETERS:
+  *     IN/OUT reader : The reader.
+  *     OUT line      : Set to the start of the line.
+  *     IN delimiter  : The line delimiter, or `LINEREADER_UNIV`.
+  *
+  * RETURNS:
+  *     Returns the length of the line, including its delimiter.  (For
+  *     `LINEREADER_UNIV`, the line ending is not translated, so a CR-LF
+  *     sequence is included as two bytes.)
+  *
+  *     Returns -1 at the end of the stream or on failure.  Use `feof` on the
+  *     underlying stream to distinguish the two; on failure, `errno` is set.
+  *     Checking `ferror` is not sufficient: if the buffer cannot grow to hold
+  *     a long line, `errno` is set to `ENOMEM` or to `EOVERFLOW` (`ERANGE` if
+  *     `EOVERFLOW` is unavailable), and neither the end-of-file indicator nor
+  *     the error indicator of the stream is set.
+  */
+ssize_t linereader_next(LineReader* reader, const char** line, int delimiter);
+
+
+/** linereader_next_fields
+  *
+  *     Like `linereader_next`, but also splits the line into fields separated
+  *     by `separator`.  The separators are found in the same pass that finds
+  *     the end of the line.
+  *
+  *     The final field ends before the line delimiter, if any.  A line always
+  *     has at least one (possibly empty) field.
+  *
+  * PARAMETERS:
+  *     IN/OUT reader : The reader.
+  *     OUT line      : Set to the start of the line.
+  *     IN delimiter  : The line delimiter.  `LINEREADER_UNIV` is not
+  *                     supported.
+  *     IN separator  : The field separator (e.g. '\t').
+  *     IN/OUT fields : Receives the field boundaries.
+  *
+  * RETURNS:
+  *     Returns the same as `linereader_next`.
+  */
+ssize_t linereader_next_fields(LineReader* reader, const char** line,
+                               int delimiter, int separator,
+                               LineFields* fields);
+
+
+/** linereader_getdelim
+  *
+  *     Like `getdelim`, but reads from `reader`.  Each line is copied from the
+  *     reader's buffer to `*lineptr` exactly once, applying any transforms
+  *     requested by `options` during the copy.
+  *
+  * PARAMETERS:
+  *     IN/OUT reader  : The reader.
+  *     IN/OUT lineptr : As for `getdelim`.
+  *     IN/OUT n       : As for `getdelim`.
+  *     IN delimiter   : The line delimiter, or `LINEREADER_UNIV`.  (For
+  *                      `LINEREADER_UNIV`, the line ending is not translated.)
+  *     IN options     : A combination of the `LINEREADER_JOIN_CONTINUATIONS`,
+  *                      `LINEREADER_STRIP_NEWLINE`, `LINEREADER_STRIP_CR`,
+  *                      `LINEREADER_TRIM`, and `LINEREADER_LOWERCASE`
+  *                      flags, or 0.
+  *
+  * RETURNS:
+  *     Returns the length of the line, as with `getdelim`.  A logical line
+  *     made of several joined lines ends with the line ending of the last of
+  *     them.
+  *
+  *     Returns -1 at the end of the stream or on failure.  As with `getline`,
+  *     use `feof` or `ferror` on the underlying stream to distinguish the
+  *     two.
+  */
+ssize_t linereader_getdelim(LineReader* reader, char** lineptr, size_t* n,
+                            int delimiter, int options);
+
+
+/** linereader_next_prefix
+  *
+  *     Copies at most the first `prefixSize` bytes of the next line to
+  *     `prefix` and skips the rest of the line.  The remainder of the line is
+  *     scanned for the delimiter but is neither copied nor accumulated in the
+  *     reader's buffer, so lines of any length can be skipped in bounded
+  *     memory.
+  *
+  * PARAMETERS:
+  *     IN/OUT reader : The reader.
+  *     OUT prefix    : Receives the first `min(prefixSize, length)` bytes of
+  *                     the line, where `length` is the return value.  Is not
+  *                     `NUL`-terminated.
+  *     IN prefixSize : The size of `prefix`.
+  *     IN delimiter  : The line delimiter, or `LINEREADER_UNIV`.
+  *
+  * RETURNS:
+  *     Returns the full length of the line, including its delimiter.
+  *
+  *     Returns -1 at the end of the stream or on failure.  As with `getline`,
+  *     use `feof` or `ferror` on the underlying stream to distinguish the
+  *     two.
+  */
+ssize_t linereader_next_prefix(LineReader* reader, char* prefix,
+                               size_t prefixSize, int delimiter);
+
+
+/** linereader_next_str
+  *
+  *     Like `linereader_next`, but lines are delimited by a sequence of bytes
+  *     (e.g. "\r\n\r\n" to split HTTP-style headers from bodies), as with
+  *     `getdelimstr`.
+  *
+  * PARAMETERS:
+  *     IN/OUT reader      : The reader.
+  *     OUT line           : Set to the start of the line.
+  *     IN delimiter       : The delimiter sequence.  It may contain `NUL`
+  *                          bytes.
+  *     IN delimiterLength : The length of `delimiter`.  Must be non-zero.
+  *
+  * RETURNS:
+  *     Returns the same as `linereader_next`.
+  */
+ssize_t linereader_next_str(LineReader* reader, const char** line,
+                            const char* delimiter, size_t delimiterLength);
+
+
+/** linereader_get_stats
+  *
+  *     Retrieves a snapshot of a reader's counters.  The snapshot is a copy
+  *     and is not affected by later reads.
+  *
+  * PARAMETERS:
+  *     IN reader : The reader.
+  *     OUT stats : Receives the counters.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.  Fails
+  *     with `ENOSYS` (`EDOM` if `ENOSYS` is unavailable) if the library was
+  *     compiled without `LINEREADER_STATS`.
+  */
+int linereader_get_stats(const LineReader* reader, LineReaderStats* stats);
+
+
+/** linefields_free
+  *
+  *     Releases memory owned by `fields` and reinitializes it.
+  */
+void linefields_free(LineFields* fields);
+
+
+#endif /* LINEREADER_COMPATIBLE_H */
@@ -0,0 +1,132 @@
+/** linereader_internal.h
+  *
+  * Internal definitions shared by the `LineReader` implementation files.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef LINEREADER_INTERNAL_H
+#define LINEREADER_INTERNAL_H
+
+#include <stdio.h>
+
+#include "linereader.h"
+
+#if __STDC_VERSION__ >= 199901L
+    #include <stdbool.h>
+#else
+    typedef enum { false, true } bool;
+#endif
+
+
+struct LineReader
+{
+    FILE* stream;
+
+    /* Unconsumed data is in `buffer[start, end)`. */
+    char* buffer;
+    size_t capacity;
+    size_t start;
+    size_t end;
+
+    bool eof;
+
+    /* Set by `linereader_set_low_latency`. */
+    bool lowLatency;
+    int lowLatencyDelimiter;
+
+#ifdef LINEREADER_STATS
+    LineReaderStats stats;
+#endif
+};
+
+
+#ifdef LINEREADER_STATS
+    /* Adds `n` to the counter `name` of `reader->stats`. */
+    #define LINEREADER_COUNT(reader, name, n) \
+        ((void) ((reader)->stats.name += (n)))
+
+    /** linereader_count_line
+      *
+      *     Records a line (or record) of `length` bytes returned by `reader`.
+      */
+    void linereader_count_line(LineReader* reader, size_t length);
+#else
+    #define LINEREADER_COUNT(reader, name, n) ((void) 0)
+    #define linereader_count_line(reader, length) ((void) 0)
+#endif
+
+
+/** linereader_set_errno_invalid
+  *
+  *     Sets `errno` to `EINVAL`, or to `EDOM` if `EINVAL` is unavailable.
+  */
+void linereader_set_errno_invalid(void);
+
+
+/** linereader_set_errno_overflow
+  *
+  *     Sets `errno` to `EOVERFLOW`, or to `ERANGE` if `EOVERFLOW` is
+  *     unavailable.
+  */
+void linereader_set_errno_overflow(void);
+
+
+/** linereader_fill
+  *
+  *     Reads more data from the stream, moving unconsumed data to the front of
+  *     the buffer and growing the buffer if it is full.  Offsets relative to
+  *     `reader->start` are preserved.
+  *
+  * RETURNS:
+  *     Returns the number of bytes read, 0 at the end of the stream, or -1 on
+  *     failure.
+  */
+ssize_t linereader_fill(LineReader* reader);
+
+
+/** linereader_find_line_end
+  *
+  *     Finds the end of the line that begins at `reader->start`, reading more
+  *     data as necessary.
+  *
+  * RETURNS:
+  *     Returns the length of the line, including its delimiter.  Returns 0 if
+  *     there are no more lines.  Returns -1 on failure.
+  */
+ssize_t linereader_find_line_end(LineReader* reader, int delimiter);
+
+
+/** linefields_reserve
+  *
+  *     Ensures that `fields` can hold at least `capacity` boundaries.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+int linefields_reserve(LineFields* fields, size_t capacity);
+
+
+#endif /* LINEREADER_INTERNAL_H */
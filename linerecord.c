@@ -0,0 +1,300 @@
+/** linerecord.c
+  *
+  * Reading fixed-width and length-prefixed records.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+#include "linerecord.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include "linereader_internal.h"
+
+enum
+{
+    /* The longest encoding of a 64-bit varint. */
+    maxVarintLength = 10
+};
+
+/* Results of `parse_record`. */
+enum
+{
+    recordError = -1,
+    recordIncomplete = 0,
+    recordComplete = 1,
+    recordTooLong = 2
+};
+
+
+/** parse_record
+  *
+  *     Parses the framing of the record at `offset` bytes past
+  *     `reader->start`, using only data that is already buffered.
+  *
+  * PARAMETERS:
+  *     OUT headerLength  : Set to the length of the record's length prefix.
+  *     OUT payloadLength : Set to the length of the record.
+  *     OUT skipLength    : If the record is longer than `size`, set to the
+  *                         length of the whole record, including its prefix.
+  *
+  * RETURNS:
+  *     Returns `recordComplete` if the whole record is buffered,
+  *     `recordIncomplete` if more data is needed, `recordTooLong` if the
+  *     record is longer than `size`, or `recordError` (and sets `errno`) if
+  *     the length prefix is invalid.
+  */
+static int
+parse_record(const LineReader* reader, size_t offset, int framing,
+             size_t size, size_t* headerLength, size_t* payloadLength,
+             uint64_t* skipLength)
+{
+    const unsigned char* p =
+        (const unsigned char*) &reader->buffer[reader->start + offset];
+    size_t available = reader->end - reader->start - offset;
+    uint64_t length = 0;
+
+    if (framing == LINERECORD_FIXED)
+    {
+        *headerLength = 0;
+        length = size;
+    }
+    else if (framing == LINERECORD_BE32)
+    {
+        if (available < 4)
+        {
+            return recordIncomplete;
+        }
+        *headerLength = 4;
+        length = ((uint64_t) p[0] << 24) | ((uint64_t) p[1] << 16)
+                 | ((uint64_t) p[2] << 8) | (uint64_t) p[3];
+    }
+    else
+    {
+        size_t i;
+        assert(framing == LINERECORD_VARINT);
+        for (i = 0; ; i++)
+        {
+            if (i == available)
+            {
+                return recordIncomplete;
+            }
+            if (i == maxVarintLength || (i == maxVarintLength - 1 && p[i] > 1))
+            {
+                /* The length does not fit in 64 bits, so the record cannot
+                 * be skipped.
+                 */
+                linereader_set_errno_overflow();
+                return recordError;
+            }
+
+            length |= (uint64_t) (p[i] & 0x7F) << (7 * i);
+            if ((p[i] & 0x80) == 0)
+            {
+                break;
+            }
+        }
+        *headerLength = i + 1;
+    }
+
+    if (length > size)
+    {
+        *skipLength = *headerLength + length;
+        return recordTooLong;
+    }
+
+    *payloadLength = (size_t) length;
+    return (available - *headerLength >= *payloadLength)
+           ? recordComplete
+           : recordIncomplete;
+}
+
+
+/** skip_bytes
+  *
+  *     Discards the next `length` bytes of `reader`'s stream without
+  *     buffering more than a block of them.
+  *
+  * RETURNS:
+  *     Returns 0 on success, including if the stream ends first.  Returns -1
+  *     on failure.
+  */
+static int
+skip_bytes(LineReader* reader, uint64_t length)
+{
+    while (true)
+    {
+        size_t available = reader->end - reader->start;
+        ssize_t bytesRead;
+
+        if (length <= available)
+        {
+            reader->start += (size_t) length;
+            return 0;
+        }
+
+        length -= available;
+        reader->start = reader->end;
+
+        bytesRead = linereader_fill(reader);
+        if (bytesRead <= 0)
+        {
+            return (int) bytesRead;
+        }
+    }
+}
+
+
+ssize_t
+linereader_next_records(LineReader* reader, LineView* records,
+                        size_t maxRecords, int framing, size_t size)
+{
+    size_t count = 0;
+    size_t consumed = 0;
+
+    if (   reader == NULL || records == NULL || maxRecords == 0
+        || (framing != LINERECORD_FIXED && framing != LINERECORD_BE32
+            && framing != LINERECORD_VARINT)
+        || (framing == LINERECORD_FIXED && size == 0)
+        || size > (size_t) SSIZE_MAX - maxVarintLength)
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+    while (count < maxRecords)
+    {
+        size_t headerLength = 0;
+        size_t payloadLength = 0;
+        uint64_t skipLength = 0;
+        int result = parse_record(reader, consumed, framing, size,
+                                  &headerLength, &payloadLength,
+                                  &skipLength);
+        if (result == recordError)
+        {
+            return -1;
+        }
+
+        if (result == recordTooLong)
+        {
+            if (count > 0)
+            {
+                /* Report the record on the next call. */
+                break;
+            }
+
+            /* Skip the record so that reading can continue after it. */
+            if (skip_bytes(reader, skipLength) != 0)
+            {
+                return -1;
+            }
+            linereader_set_errno_overflow();
+            return -1;
+        }
+
+        if (result == recordIncomplete)
+        {
+            ssize_t bytesRead;
+            if (count > 0)
+            {
+                /* Return what is already buffered rather than wait. */
+                break;
+            }
+
+            bytesRead = linereader_fill(reader);
+            if (bytesRead < 0)
+            {
+                return -1;
+            }
+            if (bytesRead == 0)
+            {
+                if (reader->end > reader->start)
+                {
+                    /* Discard the partial record. */
+                    reader->start = reader->end;
+                #ifdef EILSEQ
+                    errno = EILSEQ;
+                #else
+                    errno = EDOM;
+                #endif
+                }
+                return -1;
+            }
+            continue;
+        }
+
+        /* The buffer is only refilled before the first record is found, so
+         * the views remain valid.
+         */
+        records[count].data = &reader->buffer[reader->start + consumed
+                                              + headerLength];
+        records[count].length = payloadLength;
+        count++;
+        consumed += headerLength + payloadLength;
+    }
+
+    reader->start += consumed;
+
+#ifdef LINEREADER_STATS
+    {
+        size_t i;
+        for (i = 0; i < count; i++)
+        {
+            linereader_count_line(reader, records[i].length);
+        }
+    }
+#endif
+
+    assert(count <= (size_t) SSIZE_MAX);
+    return (ssize_t) count;
+}
+
+
+ssize_t
+linereader_next_record(LineReader* reader, const char** record,
+                       int framing, size_t size)
+{
+    LineView view;
+    ssize_t count;
+
+    if (record == NULL)
+    {
+        assert(false);
+        linereader_set_errno_invalid();
+        return -1;
+    }
+
+    count = linereader_next_records(reader, &view, 1, framing, size);
+    if (count < 0)
+    {
+        return -1;
+    }
+
+    *record = view.data;
+    assert(view.length <= (size_t) SSIZE_MAX);
+    return (ssize_t) view.length;
+}
@@ -0,0 +1,125 @@
+/** linerecord.h
+  *
+  * Reading fixed-width and length-prefixed records.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+#ifndef LINERECORD_COMPATIBLE_H
+#define LINERECORD_COMPATIBLE_H
+
+#include <stddef.h>
+
+#include "linereader.h"
+
+
+/* Record framings for `linereader_next_record` and
+ * `linereader_next_records`.
+ */
+
+/* Records of exactly `size` bytes. */
+#define LINERECORD_FIXED 0
+
+/* Records preceded by their length as a 4-byte big-endian integer. */
+#define LINERECORD_BE32 1
+
+/* Records preceded by their length as an unsigned LEB128 varint (as used by
+ * Protocol Buffers).
+ */
+#define LINERECORD_VARINT 2
+
+
+/** LineView
+  *
+  *     A view of a record in a reader's buffer.  Like the views returned by
+  *     `linereader_next`, it is not `NUL`-terminated and remains valid only
+  *     until the next call that reads from the same reader.
+  */
+typedef struct
+{
+    const char* data;
+    size_t length;
+} LineView;
+
+
+/** linereader_next_record
+  *
+  *     Retrieves a view of the next record of a stream that is not delimited
+  *     by lines.
+  *
+  * PARAMETERS:
+  *     IN/OUT reader : The reader.
+  *     OUT record    : Set to the start of the record.  For length-prefixed
+  *                     framings, the length prefix is excluded.
+  *     IN framing    : One of the `LINERECORD_` framings.
+  *     IN size       : For `LINERECORD_FIXED`, the size of each record.  For
+  *                     length-prefixed framings, the maximum record length to
+  *                     accept; the reader's buffer may grow to hold a record
+  *                     of this length.
+  *
+  * RETURNS:
+  *     Returns the length of the record.
+  *
+  *     Returns -1 at the end of the stream or on failure.  As with `getline`,
+  *     use `feof` or `ferror` on the underlying stream to distinguish the
+  *     two.  Additionally, if the stream ends in the middle of a record, sets
+  *     `errno` to `EILSEQ` (`EDOM` if `EILSEQ` is unavailable).
+  *
+  *     If a record's length exceeds `size`, the record is skipped without
+  *     being buffered, `errno` is set to `EOVERFLOW` (`ERANGE` if `EOVERFLOW`
+  *     is unavailable), and -1 is returned; reading may continue with the
+  *     next record.  `errno` is also set to `EOVERFLOW` for a varint prefix
+  *     whose value does not fit in 64 bits, but such a prefix cannot be
+  *     skipped, so the caller must stop reading.
+  */
+ssize_t linereader_next_record(LineReader* reader, const char** record,
+                               int framing, size_t size);
+
+
+/** linereader_next_records
+  *
+  *     Retrieves views of as many of the next records as are already buffered
+  *     (reading more data only if no complete record is buffered), up to
+  *     `maxRecords`.  No memory is allocated per record.
+  *
+  * PARAMETERS:
+  *     IN/OUT reader  : The reader.
+  *     OUT records    : Receives views of the records.  All of them remain
+  *                      valid until the next call that reads from `reader`.
+  *     IN maxRecords  : The number of elements in `records`.  Must be
+  *                      non-zero.
+  *     IN framing     : As for `linereader_next_record`.
+  *     IN size        : As for `linereader_next_record`.
+  *
+  * RETURNS:
+  *     Returns the number of records retrieved, which is at least 1.
+  *
+  *     Returns -1 at the end of the stream or on failure, as with
+  *     `linereader_next_record`.
+  */
+ssize_t linereader_next_records(LineReader* reader, LineView* records,
+                                size_t maxRecords, int framing, size_t size);
+
+
+#endif /* LINERECORD_COMPATIBLE_H */
@@ -0,0 +1,715 @@
+/** linescan.c
+  *
+  * Internal vectorized scanning kernels for locating and counting delimiters.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#include "linescan.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef LINESCAN_USE_SSE2
+    #include <emmintrin.h>
+#endif
+
+#if    defined LINESCAN_USE_SSE2 && defined __PCLMUL__ \
+    && (defined __x86_64__ || defined _M_X64)
+    #define LINESCAN_USE_PCLMUL
+    #include <wmmintrin.h>
+#endif
+
+#ifdef LINESCAN_USE_SSE2
+/** bit_count
+  *
+  * RETURNS:
+  *     Returns the number of set bits in `x`.
+  */
+static unsigned
+bit_count(unsigned x)
+{
+#if defined __GNUC__ || defined __clang__
+    return (unsigned) __builtin_popcount(x);
+#else
+    unsigned count = 0;
+    for (; x != 0; x &= x - 1)
+    {
+        count++;
+    }
+    return count;
+#endif
+}
+
+
+/** lowest_bit_index
+  *
+  * RETURNS:
+  *     Returns the index of the lowest set bit in `x`, which must be non-zero.
+  */
+static unsigned
+lowest_bit_index(unsigned x)
+{
+#if defined __GNUC__ || defined __clang__
+    return (unsigned) __builtin_ctz(x);
+#else
+    unsigned index = 0;
+    assert(x != 0);
+    for (; (x & 1) == 0; x >>= 1)
+    {
+        index++;
+    }
+    return index;
+#endif
+}
+#endif /* LINESCAN_USE_SSE2 */
+
+
+/* Word-at-a-time helpers for the portable implementation.  See
+ * <https://graphics.stanford.edu/~seander/bithacks.html#ZeroInWord>.
+ */
+#define ONES_WORD ((unsigned long) -1 / UCHAR_MAX)
+#define HIGHS_WORD (ONES_WORD * (UCHAR_MAX / 2 + 1))
+#define LOWS_WORD (ONES_WORD * (UCHAR_MAX / 2))
+
+
+/** word_match_mask
+  *
+  * RETURNS:
+  *     Returns a word with the high bit of each byte set if and only if the
+  *     corresponding byte of `word` equals the byte repeated in `pattern`.
+  */
+static unsigned long
+word_match_mask(unsigned long word, unsigned long pattern)
+{
+    unsigned long x = word ^ pattern;
+    return ~(((x & LOWS_WORD) + LOWS_WORD) | x | LOWS_WORD);
+}
+
+
+static size_t
+word_popcount(unsigned long x)
+{
+#if defined __GNUC__ || defined __clang__
+    return (size_t) __builtin_popcountl(x);
+#else
+    size_t count = 0;
+    for (; x != 0; x &= x - 1)
+    {
+        count++;
+    }
+    return count;
+#endif
+}
+
+
+/** count_scalar
+  *
+  *     Portable implementation of `linescan_count`.
+  */
+static size_t
+count_scalar(const char* p, size_t len, int c)
+{
+    size_t count = 0;
+    const unsigned long pattern = ONES_WORD * (unsigned char) c;
+
+    while (len >= sizeof (unsigned long))
+    {
+        unsigned long word;
+        memcpy(&word, p, sizeof word);
+        count += word_popcount(word_match_mask(word, pattern));
+        p += sizeof word;
+        len -= sizeof word;
+    }
+
+    for (; len > 0; len--)
+    {
+        count += (*p++ == (char) c);
+    }
+    return count;
+}
+
+
+size_t
+linescan_count(const char* p, size_t len, int c)
+{
+#ifdef LINESCAN_USE_SSE2
+    size_t count = 0;
+    const __m128i needle = _mm_set1_epi8((char) c);
+
+    while (len >= 16)
+    {
+        /* Each matching byte decrements its lane, so a lane can accumulate
+         * up to 255 matches before it would wrap.
+         */
+        __m128i accumulator = _mm_setzero_si128();
+        size_t blocks = len / 16;
+        size_t i;
+        if (blocks > 255)
+        {
+            blocks = 255;
+        }
+
+        for (i = 0; i < blocks; i++)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*) p);
+            accumulator = _mm_sub_epi8(accumulator, _mm_cmpeq_epi8(v, needle));
+            p += 16;
+        }
+        len -= blocks * 16;
+
+        accumulator = _mm_sad_epu8(accumulator, _mm_setzero_si128());
+        count += (size_t) _mm_cvtsi128_si32(accumulator)
+                 + (size_t) _mm_cvtsi128_si32(_mm_srli_si128(accumulator, 8));
+    }
+    return count + count_scalar(p, len, c);
+#else
+    return count_scalar(p, len, c);
+#endif /* LINESCAN_USE_SSE2 */
+}
+
+
+size_t
+linescan_count_univ(const char* p, size_t len, int* afterCR)
+{
+    size_t count = 0;
+    const char* end = p + len;
+    int previousCR;
+
+    assert(afterCR != NULL);
+
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    previousCR = *afterCR;
+    *afterCR = (end[-1] == '\r');
+
+#ifdef LINESCAN_USE_SSE2
+    {
+        const __m128i crs = _mm_set1_epi8('\r');
+        const __m128i lfs = _mm_set1_epi8('\n');
+        for (; end - p >= 16; p += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*) p);
+            unsigned crMask = (unsigned) _mm_movemask_epi8(
+                _mm_cmpeq_epi8(v, crs));
+            unsigned lfMask = (unsigned) _mm_movemask_epi8(
+                _mm_cmpeq_epi8(v, lfs));
+
+            /* Line endings are CRs and LFs that don't follow a CR. */
+            count += bit_count(crMask
+                               | (lfMask
+                                  & ~((crMask << 1) | (previousCR != 0))));
+            previousCR = (crMask >> 15) & 1;
+        }
+    }
+#endif /* LINESCAN_USE_SSE2 */
+
+    /* An LF that completes a CR-LF sequence was counted with its CR. */
+    if (previousCR && p < end && *p == '\n')
+    {
+        p++;
+    }
+
+#ifndef LINESCAN_USE_SSE2
+    {
+        const unsigned long crs = ONES_WORD * '\r';
+        const unsigned long lfs = ONES_WORD * '\n';
+
+        /* Matching CRs in each word against LFs in the word that starts one
+         * byte later pairs every CR with the byte after it, regardless of
+         * byte order.  Each CR-LF sequence is subtracted once, for its CR;
+         * its LF is counted with the word (or the tail) that contains it.
+         */
+        while ((size_t) (end - p) > sizeof (unsigned long))
+        {
+            unsigned long word;
+            unsigned long next;
+            unsigned long crMatches;
+            memcpy(&word, p, sizeof word);
+            memcpy(&next, p + 1, sizeof next);
+
+            crMatches = word_match_mask(word, crs);
+            count += word_popcount(crMatches)
+                     + word_popcount(word_match_mask(word, lfs))
+                     - word_popcount(crMatches & word_match_mask(next, lfs));
+            p += sizeof word;
+        }
+    }
+#endif /* LINESCAN_USE_SSE2 */
+
+    for (; p < end; p++)
+    {
+        if (*p == '\r')
+        {
+            count++;
+            if (p + 1 < end && p[1] == '\n')
+            {
+                p++;
+            }
+        }
+        else if (*p == '\n')
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+
+const char*
+linescan_find_nth(const char* p, size_t len, int c, size_t* remaining)
+{
+    const char* end = p + len;
+
+    assert(remaining != NULL);
+    assert(*remaining > 0);
+
+#ifdef LINESCAN_USE_SSE2
+    {
+        const __m128i needle = _mm_set1_epi8((char) c);
+        for (; end - p >= 16; p += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*) p);
+            unsigned mask = (unsigned) _mm_movemask_epi8(
+                _mm_cmpeq_epi8(v, needle));
+            size_t matches = bit_count(mask);
+            if (matches < *remaining)
+            {
+                *remaining -= matches;
+                continue;
+            }
+
+            for (; *remaining > 1; (*remaining)--)
+            {
+                mask &= mask - 1;
+            }
+            *remaining = 0;
+            return p + lowest_bit_index(mask);
+        }
+    }
+#endif /* LINESCAN_USE_SSE2 */
+
+    while (p < end)
+    {
+        p = memchr(p, c, (size_t) (end - p));
+        if (p == NULL)
+        {
+            break;
+        }
+        if (--(*remaining) == 0)
+        {
+            return p;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+
+const char*
+linescan_find_nth_univ(const char* p, size_t len, size_t* remaining,
+                       int* afterCR)
+{
+    const char* end = p + len;
+    int previousCR;
+
+    assert(remaining != NULL);
+    assert(*remaining > 0);
+    assert(afterCR != NULL);
+
+    previousCR = *afterCR;
+
+#ifdef LINESCAN_USE_SSE2
+    {
+        const __m128i crs = _mm_set1_epi8('\r');
+        const __m128i lfs = _mm_set1_epi8('\n');
+        for (; end - p >= 16; p += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*) p);
+            unsigned crMask = (unsigned) _mm_movemask_epi8(
+                _mm_cmpeq_epi8(v, crs));
+            unsigned lfMask = (unsigned) _mm_movemask_epi8(
+                _mm_cmpeq_epi8(v, lfs));
+
+            /* Line endings are CRs and LFs that don't follow a CR. */
+            unsigned mask = crMask
+                            | (lfMask & ~((crMask << 1) | (previousCR != 0)));
+            size_t matches = bit_count(mask);
+
+            previousCR = (crMask >> 15) & 1;
+
+            if (matches < *remaining)
+            {
+                *remaining -= matches;
+                continue;
+            }
+
+            for (; *remaining > 1; (*remaining)--)
+            {
+                mask &= mask - 1;
+            }
+            *remaining = 0;
+            return p + lowest_bit_index(mask);
+        }
+    }
+#endif /* LINESCAN_USE_SSE2 */
+
+    for (; p < end; p++)
+    {
+        if (*p == '\r' || (*p == '\n' && !previousCR))
+        {
+            if (--(*remaining) == 0)
+            {
+                return p;
+            }
+        }
+        previousCR = (*p == '\r');
+    }
+
+    *afterCR = previousCR;
+    return NULL;
+}
+
+
+size_t
+linescan_fields(const char* p, size_t len, int delimiter, int separator,
+                size_t* positions, size_t maxPositions,
+                size_t* numPositions, int* foundDelimiter)
+{
+    size_t i = 0;
+    size_t count = 0;
+
+    assert(positions != NULL || maxPositions == 0);
+    assert(numPositions != NULL);
+    assert(foundDelimiter != NULL);
+
+    *foundDelimiter = 0;
+
+#ifdef LINESCAN_USE_SSE2
+    {
+        const __m128i delimiters = _mm_set1_epi8((char) delimiter);
+        const __m128i separators = _mm_set1_epi8((char) separator);
+        for (; i + 16 <= len; i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*) &p[i]);
+            unsigned mask = (unsigned) _mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(v, delimiters),
+                             _mm_cmpeq_epi8(v, separators)));
+
+            for (; mask != 0; mask &= mask - 1)
+            {
+                size_t j = i + lowest_bit_index(mask);
+                if (p[j] == (char) delimiter)
+                {
+                    *numPositions = count;
+                    *foundDelimiter = 1;
+                    return j + 1;
+                }
+                if (count == maxPositions)
+                {
+                    *numPositions = count;
+                    return j;
+                }
+                positions[count++] = j;
+            }
+        }
+    }
+#endif /* LINESCAN_USE_SSE2 */
+
+    for (; i < len; i++)
+    {
+        if (p[i] == (char) delimiter)
+        {
+            *numPositions = count;
+            *foundDelimiter = 1;
+            return i + 1;
+        }
+        if (p[i] == (char) separator)
+        {
+            if (count == maxPositions)
+            {
+                *numPositions = count;
+                return i;
+            }
+            positions[count++] = i;
+        }
+    }
+
+    *numPositions = count;
+    return len;
+}
+
+
+const char*
+linescan_find_str(const char* p, size_t len,
+                  const char* needle, size_t needleLength)
+{
+    const char* last;
+
+    assert(needleLength > 0);
+
+    if (len < needleLength)
+    {
+        return NULL;
+    }
+
+    /* The last position at which a match can start. */
+    last = p + (len - needleLength);
+
+#ifdef LINESCAN_USE_SSE2
+    if (needleLength > 1)
+    {
+        /* Compare the first and last bytes of the needle against 16
+         * candidate positions at a time, and only compare the whole needle
+         * at positions where both match.
+         */
+        const __m128i first = _mm_set1_epi8(needle[0]);
+        const __m128i final = _mm_set1_epi8(needle[needleLength - 1]);
+        for (; last - p >= 16; p += 16)
+        {
+            __m128i head = _mm_loadu_si128((const __m128i*) p);
+            __m128i tail = _mm_loadu_si128(
+                (const __m128i*) &p[needleLength - 1]);
+            unsigned mask = (unsigned) _mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(head, first),
+                              _mm_cmpeq_epi8(tail, final)));
+            while (mask != 0)
+            {
+                const char* candidate = p + lowest_bit_index(mask);
+                if (memcmp(candidate + 1, needle + 1, needleLength - 2) == 0)
+                {
+                    return candidate;
+                }
+                mask &= mask - 1;
+            }
+        }
+    }
+#endif /* LINESCAN_USE_SSE2 */
+
+    while (p <= last)
+    {
+        p = memchr(p, (unsigned char) needle[0], (size_t) (last - p) + 1);
+        if (p == NULL)
+        {
+            break;
+        }
+        if (memcmp(p + 1, needle + 1, needleLength - 1) == 0)
+        {
+            return p;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+
+const char*
+linescan_find_any(const char* p, size_t len,
+                  const char* bytes, size_t numBytes)
+{
+    const char* end = p + len;
+    unsigned char table[UCHAR_MAX + 1];
+    size_t i;
+
+    if (numBytes == 1)
+    {
+        return memchr(p, (unsigned char) bytes[0], len);
+    }
+
+#ifdef LINESCAN_USE_SSE2
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*) p);
+        __m128i matches = _mm_setzero_si128();
+        unsigned mask;
+        for (i = 0; i < numBytes; i++)
+        {
+            matches = _mm_or_si128(matches,
+                                   _mm_cmpeq_epi8(v, _mm_set1_epi8(bytes[i])));
+        }
+
+        mask = (unsigned) _mm_movemask_epi8(matches);
+        if (mask != 0)
+        {
+            return p + lowest_bit_index(mask);
+        }
+    }
+#endif /* LINESCAN_USE_SSE2 */
+
+    memset(table, 0, sizeof table);
+    for (i = 0; i < numBytes; i++)
+    {
+        table[(unsigned char) bytes[i]] = 1;
+    }
+
+    for (; p < end; p++)
+    {
+        if (table[(unsigned char) *p])
+        {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+
+void
+linescan_copy_lower(char* dest, const char* src, size_t len)
+{
+#ifdef LINESCAN_USE_SSE2
+    /* Shift 'A' to the smallest signed byte so that a single signed
+     * comparison identifies 'A' through 'Z'.
+     */
+    const __m128i shift = _mm_set1_epi8((char) (0x80 - 'A'));
+    const __m128i limit = _mm_set1_epi8((char) (-0x80 + 26));
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    for (; len >= 16; src += 16, dest += 16, len -= 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*) src);
+        __m128i isUpper = _mm_cmplt_epi8(_mm_add_epi8(v, shift), limit);
+        _mm_storeu_si128((__m128i*) dest,
+                         _mm_or_si128(v, _mm_and_si128(isUpper, caseBit)));
+    }
+#else
+    /* Each byte's high bit in `atLeastA` and `afterZ` is set if its low 7
+     * bits are at least 'A' or greater than 'Z', respectively.
+     */
+    while (len >= sizeof (unsigned long))
+    {
+        unsigned long word;
+        unsigned long low;
+        unsigned long atLeastA;
+        unsigned long afterZ;
+        unsigned long isUpper;
+
+        memcpy(&word, src, sizeof word);
+        low = word & LOWS_WORD;
+        atLeastA = low + ONES_WORD * (0x80 - 'A');
+        afterZ = low + ONES_WORD * (0x7F - 'Z');
+        isUpper = atLeastA & ~afterZ & ~word & HIGHS_WORD;
+        word |= isUpper >> 2;
+        memcpy(dest, &word, sizeof word);
+
+        src += sizeof word;
+        dest += sizeof word;
+        len -= sizeof word;
+    }
+#endif /* LINESCAN_USE_SSE2 */
+
+    for (; len > 0; len--)
+    {
+        char c = *src++;
+        *dest++ = (c >= 'A' && c <= 'Z') ? (char) (c - 'A' + 'a') : c;
+    }
+}
+
+
+#ifdef LINESCAN_USE_SSE2
+static uint64_t
+match_mask16(__m128i v, __m128i needle)
+{
+    return (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+}
+#endif
+
+
+void
+linescan_match_masks(const char* p, size_t len,
+                     const char* bytes, size_t numBytes,
+                     uint64_t* masks)
+{
+    size_t j;
+
+    assert(len <= 64);
+
+#ifdef LINESCAN_USE_SSE2
+    if (len == 64)
+    {
+        __m128i v0 = _mm_loadu_si128((const __m128i*) &p[0]);
+        __m128i v1 = _mm_loadu_si128((const __m128i*) &p[16]);
+        __m128i v2 = _mm_loadu_si128((const __m128i*) &p[32]);
+        __m128i v3 = _mm_loadu_si128((const __m128i*) &p[48]);
+
+        for (j = 0; j < numBytes; j++)
+        {
+            __m128i needle = _mm_set1_epi8(bytes[j]);
+            masks[j] = match_mask16(v0, needle)
+                       | (match_mask16(v1, needle) << 16)
+                       | (match_mask16(v2, needle) << 32)
+                       | (match_mask16(v3, needle) << 48);
+        }
+        return;
+    }
+#endif /* LINESCAN_USE_SSE2 */
+
+    for (j = 0; j < numBytes; j++)
+    {
+        size_t i;
+        masks[j] = 0;
+        for (i = 0; i < len; i++)
+        {
+            masks[j] |= (uint64_t) (p[i] == bytes[j]) << i;
+        }
+    }
+}
+
+
+unsigned
+linescan_lowest_bit64(uint64_t mask)
+{
+    unsigned index = 0;
+    assert(mask != 0);
+    for (; (mask & 1) == 0; mask >>= 1)
+    {
+        index++;
+    }
+    return index;
+}
+
+
+uint64_t
+linescan_prefix_xor(uint64_t mask)
+{
+#ifdef LINESCAN_USE_PCLMUL
+    /* Carry-less multiplication by all ones computes the prefix XOR. */
+    __m128i product = _mm_clmulepi64_si128(
+        _mm_set_epi64x(0, (long long) mask), _mm_set1_epi8((char) 0xFF), 0);
+    return (uint64_t) _mm_cvtsi128_si64(product);
+#else
+    mask ^= mask << 1;
+    mask ^= mask << 2;
+    mask ^= mask << 4;
+    mask ^= mask << 8;
+    mask ^= mask << 16;
+    mask ^= mask << 32;
+    return mask;
+#endif
+}
@@ -0,0 +1,225 @@
+/** linescan.h
+  *
+  * Internal vectorized scanning kernels for locating and counting delimiters.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#ifndef LINESCAN_COMPATIBLE_H
+#define LINESCAN_COMPATIBLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* SSE2 is used when the compiler advertises it unless `GETLINE_NO_SIMD` is
+ * defined.  Otherwise, portable word-at-a-time code is used.
+ */
+#if    !defined GETLINE_NO_SIMD \
+    && (   defined __SSE2__ \
+        || defined _M_X64 \
+        || (defined _M_IX86_FP && _M_IX86_FP >= 2))
+    #define LINESCAN_USE_SSE2
+#endif
+
+
+/** linescan_count
+  *
+  * RETURNS:
+  *     Returns the number of occurrences of the byte `c` in `[p, p + len)`.
+  */
+size_t linescan_count(const char* p, size_t len, int c);
+
+
+/** linescan_count_univ
+  *
+  *     Counts universal line endings (CR, LF, or CR-LF) in `[p, p + len)`.
+  *
+  * PARAMETERS:
+  *     IN p, len        : The bytes to scan.
+  *     IN/OUT afterCR   : On input, whether the byte preceding `p` was a CR
+  *                        (so that a leading LF completes a CR-LF sequence
+  *                        that was already counted).  On output, whether the
+  *                        last byte scanned was a CR.
+  *
+  * RETURNS:
+  *     Returns the number of line endings.  A CR-LF sequence is counted once,
+  *     when its CR is seen.
+  */
+size_t linescan_count_univ(const char* p, size_t len, int* afterCR);
+
+
+/** linescan_find_nth
+  *
+  *     Finds the `*remaining`th occurrence of the byte `c` in `[p, p + len)`.
+  *
+  * PARAMETERS:
+  *     IN p, len          : The bytes to scan.
+  *     IN c               : The byte to find.
+  *     IN/OUT remaining   : On input, the number of occurrences to find; must
+  *                          be positive.  On output, 0 if the occurrence was
+  *                          found; otherwise reduced by the number of
+  *                          occurrences seen.
+  *
+  * RETURNS:
+  *     Returns a pointer to the occurrence, or `NULL` if there are fewer than
+  *     `*remaining` occurrences.
+  */
+const char* linescan_find_nth(const char* p, size_t len, int c,
+                              size_t* remaining);
+
+
+/** linescan_find_nth_univ
+  *
+  *     Like `linescan_find_nth`, but finds universal line endings.  An LF
+  *     that completes a CR-LF sequence is not a line ending of its own; the
+  *     sequence is found at its CR.
+  *
+  * PARAMETERS:
+  *     IN/OUT afterCR : As for `linescan_count_univ`.  Only updated if `NULL`
+  *                      is returned.
+  */
+const char* linescan_find_nth_univ(const char* p, size_t len,
+                                   size_t* remaining, int* afterCR);
+
+
+
+/** linescan_fields
+  *
+  *     Finds the separators of the fields in a line, stopping at the end of
+  *     the line.  The line delimiter and separators are found in a single
+  *     pass.
+  *
+  * PARAMETERS:
+  *     IN p, len            : The bytes to scan.
+  *     IN delimiter         : The line delimiter.
+  *     IN separator         : The field separator.
+  *     OUT positions        : Receives the offsets from `p` of the separators
+  *                            found.
+  *     IN maxPositions      : The number of elements available in
+  *                            `positions`.
+  *     OUT numPositions     : Set to the number of separators stored.
+  *     OUT foundDelimiter   : Set to non-zero if the scan stopped because the
+  *                            line delimiter was found.
+  *
+  * RETURNS:
+  *     Returns the number of bytes consumed.  If the delimiter was found, the
+  *     delimiter is included.  If `positions` filled up, the scan stops at the
+  *     separator that did not fit, which is not consumed.
+  */
+size_t linescan_fields(const char* p, size_t len, int delimiter, int separator,
+                       size_t* positions, size_t maxPositions,
+                       size_t* numPositions, int* foundDelimiter);
+
+
+
+/** linescan_find_str
+  *
+  *     Finds the first occurrence of a byte sequence.
+  *
+  * PARAMETERS:
+  *     IN p, len                : The bytes to search.
+  *     IN needle, needleLength  : The sequence to search for.  `needleLength`
+  *                                must be non-zero.
+  *
+  * RETURNS:
+  *     Returns a pointer to the start of the first occurrence of `needle`
+  *     that lies entirely within `p`.  Returns `NULL` if there is none.
+  */
+const char* linescan_find_str(const char* p, size_t len,
+                              const char* needle, size_t needleLength);
+
+
+
+/** linescan_find_any
+  *
+  *     Finds the first occurrence of any of a set of bytes.
+  *
+  * PARAMETERS:
+  *     IN p, len         : The bytes to search.
+  *     IN bytes          : The bytes to search for.
+  *     IN numBytes       : The number of elements in `bytes`.
+  *
+  * RETURNS:
+  *     Returns a pointer to the first byte in `p` that is in `bytes`.
+  *     Returns `NULL` if there is none.
+  */
+const char* linescan_find_any(const char* p, size_t len,
+                              const char* bytes, size_t numBytes);
+
+
+
+/** linescan_copy_lower
+  *
+  *     Copies `len` bytes from `src` to `dest`, converting ASCII uppercase
+  *     letters to lowercase.  Other bytes are copied unchanged.  `dest` and
+  *     `src` must not overlap.
+  */
+void linescan_copy_lower(char* dest, const char* src, size_t len);
+
+
+
+/** linescan_match_masks
+  *
+  *     Classifies a block of up to 64 bytes.
+  *
+  * PARAMETERS:
+  *     IN p, len   : The bytes to classify.  `len` must not exceed 64.
+  *     IN bytes    : The bytes to look for.
+  *     IN numBytes : The number of elements in `bytes`.
+  *     OUT masks   : Receives `numBytes` masks.  Bit `i` of `masks[j]` is set
+  *                   if and only if `p[i] == bytes[j]`.
+  */
+void linescan_match_masks(const char* p, size_t len,
+                          const char* bytes, size_t numBytes,
+                          uint64_t* masks);
+
+
+/** linescan_lowest_bit64
+  *
+  * RETURNS:
+  *     Returns the index of the lowest set bit in `mask`, which must be
+  *     non-zero.
+  */
+unsigned linescan_lowest_bit64(uint64_t mask);
+
+#if defined __GNUC__ || defined __clang__
+    #define LINESCAN_LOWEST_BIT64(mask) ((unsigned) __builtin_ctzll(mask))
+#else
+    #define LINESCAN_LOWEST_BIT64(mask) linescan_lowest_bit64(mask)
+#endif
+
+
+/** linescan_prefix_xor
+  *
+  * RETURNS:
+  *     Returns a mask where bit `i` is the XOR of bits `0` through `i` of
+  *     `mask`.  For a mask of quote characters, this is the set of positions
+  *     inside a quoted region (including each opening quote but not the
+  *     closing one).
+  */
+uint64_t linescan_prefix_xor(uint64_t mask);
+
+
+#endif /* LINESCAN_COMPATIBLE_H */
@@ -0,0 +1,399 @@
+/** revline.c
+  *
+  * Reading lines in reverse, starting from the end of a file.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+
+#if    defined __unix__ \
+    || defined __linux__ \
+    || (defined __APPLE__ && defined __MACH__)
+    #define REVLINE_USE_PREAD
+
+    /* For `pread`, and for 64-bit `off_t` on 32-bit systems. */
+    #ifndef _POSIX_C_SOURCE
+        #define _POSIX_C_SOURCE 200809L
+    #endif
+    #ifndef _FILE_OFFSET_BITS
+        #define _FILE_OFFSET_BITS 64
+    #endif
+#endif
+
+#include "revline.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef REVLINE_USE_PREAD
+    #include <sys/stat.h>
+    #include <sys/types.h>
+    #include <unistd.h>
+
+    typedef off_t file_offset;
+#elif defined _MSC_VER
+    typedef __int64 file_offset;
+    #define FSEEK _fseeki64
+    #define FTELL _ftelli64
+#else
+    typedef long file_offset;
+    #define FSEEK fseek
+    #define FTELL ftell
+#endif
+
+#if __STDC_VERSION__ >= 199901L
+    #include <stdbool.h>
+#else
+    typedef enum { false, true } bool;
+#endif
+
+enum
+{
+#ifdef NDEBUG
+    defaultBufferSize = 128,
+    blockSize = 64 * 1024
+#else
+    /* Use tiny sizes in debug builds to exercise block boundaries. */
+    defaultBufferSize = 1,
+    blockSize = 4
+#endif /* NDEBUG */
+};
+
+
+struct ReverseLineReader
+{
+    FILE* stream;
+
+    /* The end of the next line to retrieve. */
+    file_offset pos;
+
+    /* `buffer` holds the file's contents for `[bufferStart, pos)`. */
+    char* buffer;
+    size_t capacity;
+    file_offset bufferStart;
+};
+
+
+/** read_at
+  *
+  *     Reads exactly `size` bytes at `offset` into `buffer`.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure.
+  */
+static int
+read_at(ReverseLineReader* reader, char* buffer, size_t size,
+        file_offset offset)
+{
+#ifdef REVLINE_USE_PREAD
+    int fd = fileno(reader->stream);
+    while (size > 0)
+    {
+        ssize_t bytesRead = pread(fd, buffer, size, offset);
+        if (bytesRead < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if (bytesRead == 0)
+        {
+            /* The file was truncated after we started. */
+            errno = EIO;
+            return -1;
+        }
+        buffer += bytesRead;
+        size -= (size_t) bytesRead;
+        offset += bytesRead;
+    }
+    return 0;
+#else
+    if (   FSEEK(reader->stream, offset, SEEK_SET) != 0
+        || fread(buffer, 1, size, reader->stream) != size)
+    {
+        return -1;
+    }
+    return 0;
+#endif /* REVLINE_USE_PREAD */
+}
+
+
+/** load_previous_block
+  *
+  *     Extends the buffered data backward toward the beginning of the file.
+  *     The amount read grows with the amount already buffered so that very
+  *     long lines are read in a logarithmic number of steps.
+  *
+  * RETURNS:
+  *     Returns 0 on success.  Returns -1 on failure and sets `errno`.
+  */
+static int
+load_previous_block(ReverseLineReader* reader)
+{
+    size_t used = (size_t) (reader->pos - reader->bufferStart);
+    size_t amount = (used > blockSize) ? used : blockSize;
+
+    assert(reader->bufferStart > 0);
+
+    if ((file_offset) amount > reader->bufferStart)
+    {
+        amount = (size_t) reader->bufferStart;
+    }
+
+    if (used + amount > reader->capacity)
+    {
+        char* newBuffer;
+        if (amount > (size_t) SSIZE_MAX - used)
+        {
+        #ifdef EOVERFLOW
+            errno = EOVERFLOW;
+        #else
+            errno = ERANGE;
+        #endif
+            return -1;
+        }
+
+        newBuffer = realloc(reader->buffer, used + amount);
+        if (newBuffer == NULL)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+        reader->buffer = newBuffer;
+        reader->capacity = used + amount;
+    }
+
+    memmove(&reader->buffer[amount], reader->buffer, used);
+    if (read_at(reader, reader->buffer, amount,
+                reader->bufferStart - (file_offset) amount) != 0)
+    {
+        return -1;
+    }
+    reader->bufferStart -= (file_offset) amount;
+    return 0;
+}
+
+
+/** byte_at
+  *
+  * RETURNS:
+  *     Returns the buffered byte at file offset `offset`.
+  */
+static char
+byte_at(const ReverseLineReader* reader, file_offset offset)
+{
+    assert(offset >= reader->bufferStart && offset < reader->pos);
+    return reader->buffer[offset - reader->bufferStart];
+}
+
+
+ReverseLineReader*
+revline_open(FILE* stream)
+{
+    ReverseLineReader* reader = NULL;
+    file_offset size;
+
+    if (stream == NULL)
+    {
+        assert(false);
+    #ifdef EINVAL
+        errno = EINVAL;
+    #else
+        errno = EDOM;
+    #endif
+        return NULL;
+    }
+
+    if (fflush(stream) != 0)
+    {
+        return NULL;
+    }
+
+#ifdef REVLINE_USE_PREAD
+    {
+        struct stat st;
+        if (fstat(fileno(stream), &st) != 0)
+        {
+            return NULL;
+        }
+        size = st.st_size;
+    }
+#else
+    if (FSEEK(stream, 0, SEEK_END) != 0 || (size = FTELL(stream)) < 0)
+    {
+        return NULL;
+    }
+#endif
+
+    reader = calloc(1, sizeof *reader);
+    if (reader == NULL)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    reader->stream = stream;
+    reader->pos = size;
+    reader->bufferStart = size;
+    return reader;
+}
+
+
+void
+revline_close(ReverseLineReader* reader)
+{
+    if (reader != NULL)
+    {
+        free(reader->buffer);
+        free(reader);
+    }
+}
+
+
+ssize_t
+getline_rev(char** lineptr, size_t* n, ReverseLineReader* reader)
+{
+    file_offset lineEnd;
+    file_offset lineStart;
+    size_t terminatorLength = 0;
+    size_t contentLength;
+    size_t outputLength;
+
+    if (lineptr == NULL || n == NULL || reader == NULL)
+    {
+        assert(false);
+    #ifdef EINVAL
+        errno = EINVAL;
+    #else
+        errno = EDOM;
+    #endif
+        return -1;
+    }
+
+    if (reader->pos == 0)
+    {
+        return -1;
+    }
+
+    /* Make sure that we can see a full CR-LF sequence, if any. */
+    while (   reader->pos - reader->bufferStart < 2
+           && reader->bufferStart > 0)
+    {
+        if (load_previous_block(reader) != 0)
+        {
+            return -1;
+        }
+    }
+
+    lineEnd = reader->pos;
+    if (byte_at(reader, lineEnd - 1) == '\n')
+    {
+        terminatorLength = 1;
+        if (   lineEnd - 1 > reader->bufferStart
+            && byte_at(reader, lineEnd - 2) == '\r')
+        {
+            terminatorLength = 2;
+        }
+    }
+    else if (byte_at(reader, lineEnd - 1) == '\r')
+    {
+        terminatorLength = 1;
+    }
+    lineEnd -= (file_offset) terminatorLength;
+
+    /* Search backward for the end of the preceding line. */
+    lineStart = lineEnd;
+    while (true)
+    {
+        char c;
+        if (lineStart == reader->bufferStart)
+        {
+            if (lineStart == 0)
+            {
+                break;
+            }
+            if (load_previous_block(reader) != 0)
+            {
+                return -1;
+            }
+        }
+
+        c = byte_at(reader, lineStart - 1);
+        if (c == '\n' || c == '\r')
+        {
+            break;
+        }
+        lineStart--;
+    }
+
+    contentLength = (size_t) (lineEnd - lineStart);
+    outputLength = contentLength + (terminatorLength > 0 ? 1 : 0);
+
+    if (*lineptr == NULL || *n < outputLength + 1 /* NUL */)
+    {
+        size_t newSize = (*n != 0) ? *n : defaultBufferSize;
+        char* newBuffer;
+
+        while (newSize < outputLength + 1)
+        {
+            if (newSize > (size_t) SSIZE_MAX / 2)
+            {
+            #ifdef EOVERFLOW
+                errno = EOVERFLOW;
+            #else
+                errno = ERANGE;
+            #endif
+                return -1;
+            }
+            newSize *= 2;
+        }
+
+        newBuffer = realloc(*lineptr, newSize);
+        if (newBuffer == NULL)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+        *lineptr = newBuffer;
+        *n = newSize;
+    }
+
+    memcpy(*lineptr, &reader->buffer[lineStart - reader->bufferStart],
+           contentLength);
+    if (terminatorLength > 0)
+    {
+        (*lineptr)[contentLength] = '\n';
+    }
+    (*lineptr)[outputLength] = '\0';
+
+    reader->pos = lineStart;
+
+    assert(outputLength <= (size_t) SSIZE_MAX);
+    return (ssize_t) outputLength;
+}
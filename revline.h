@@ -0,0 +1,95 @@
+/** revline.h
+  *
+  * Reading lines in reverse, starting from the end of a file.
+  *
+  * Copyright (C) 2020 James D. Lin <jamesdlin@berkeley.edu>
+  *
+  * The latest version of this file can be downloaded from:
+  * <https://github.com/jamesderlin/getline-compatible>
+  *
+  * This software is provided 'as-is', without any express or implied
+  * warranty.  In no event will the authors be held liable for any damages
+  * arising from the use of this software.
+  *
+  * Permission is granted to anyone to use this software for any purpose,
+  * including commercial applications, and to alter it and redistribute it
+  * freely, subject to the following restrictions:
+  *
+  * 1. The origin of this software must not be misrepresented; you must not
+  *    claim that you wrote the original software. If you use this software
+  *    in a product, an acknowledgment in the product documentation would be
+  *    appreciated but is not required.
+  *
+  * 2. Altered source versions must be plainly marked as such, and must not be
+  *    misrepresented as being the original software.
+  *
+  * 3. This notice may not be removed or altered from any source distribution.
+  */
+
+#ifndef REVLINE_COMPATIBLE_H
+#define REVLINE_COMPATIBLE_H
+
+#include <stdio.h>
+
+#include "getline.h"
+
+
+/** ReverseLineReader
+  *
+  *     Reads the lines of a seekable binary stream from last to first.
+  *
+  *     Data is read backward from the end of the file in blocks, so the cost
+  *     of reading the last N lines is proportional to the size of those lines
+  *     and not to the size of the file.
+  */
+typedef struct ReverseLineReader ReverseLineReader;
+
+
+/** revline_open
+  *
+  *     Creates a `ReverseLineReader` positioned at the current end of
+  *     `stream`.
+  *
+  *     On POSIX systems, the file is read with `pread` and the position of
+  *     `stream` is left unchanged.  Elsewhere, `stream` is repositioned
+  *     freely.  Either way, `stream` must remain open until the reader is
+  *     closed.
+  *
+  * RETURNS:
+  *     Returns the new reader on success.  Returns `NULL` on failure and sets
+  *     `errno`.
+  *
+  *     The caller is responsible for releasing the returned reader with
+  *     `revline_close`.
+  */
+ReverseLineReader* revline_open(FILE* stream);
+
+
+/** revline_close
+  *
+  *     Releases a reader returned by `revline_open`.  Does not close the
+  *     underlying stream.  Does nothing if `reader` is `NULL`.
+  */
+void revline_close(ReverseLineReader* reader);
+
+
+/** getline_rev
+  *
+  *     Retrieves the line preceding the previously retrieved one, starting
+  *     with the last line of the file.
+  *
+  *     CR, LF, and CR-LF are all recognized as line endings and are returned
+  *     as a single LF, as with `getline_univ`.  A final line that lacks a line
+  *     ending is returned without one.
+  *
+  *     `lineptr` and `n` follow the same conventions as for `getline`.
+  *
+  * RETURNS:
+  *     Returns the number of characters stored in `*lineptr`, excluding the
+  *     `NUL`-terminator.  Returns -1 after the first line of the file has
+  *     been retrieved or on failure, setting `errno` on failure.
+  */
+ssize_t getline_rev(char** lineptr, size_t* n, ReverseLineReader* reader);
+
+
+#endif /* REVLINE_COMPATIBLE_H */
@@ -28,6 +28,7 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -35,6 +36,47 @@
 
 #include "getline.h"
 #include "ggets.h"
+#include "linecolumn.h"
+#include "linecount.h"
+#include "linecsv.h"
+#include "linefilter.h"
+#include "lineintern.h"
+#include "linejson.h"
+#include "lineindex.h"
+#include "linereader.h"
+#include "linerecord.h"
+#include "revline.h"
+
+#if    defined __unix__ \
+    || defined __linux__ \
+    || (defined __APPLE__ && defined __MACH__)
+    #define TEST_POSIX
+    #include <fcntl.h>
+    #include <pthread.h>
+    #include <sys/wait.h>
+    #include <time.h>
+    #include <unistd.h>
+
+    #include "linechunk.h"
+    #include "linefollow.h"
+    #include "lineingest.h"
+    #include "lineparallel.h"
+    #include "linepipe.h"
+
+    #if defined __SANITIZE_ADDRESS__ || defined __SANITIZE_THREAD__
+        #define TEST_SANITIZED
+    #elif defined __has_feature
+        #if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+            #define TEST_SANITIZED
+        #endif
+    #endif
+
+    /* Sanitizers abort instead of letting allocations fail. */
+    #if defined __linux__ && !defined TEST_SANITIZED
+        #define TEST_MEMORY_LIMIT
+        #include <sys/resource.h>
+    #endif
+#endif
 
 #ifndef SIZE_MAX
     #define SIZE_MAX ((size_t) -1)
@@ -752,6 +794,201 @@ test_getdelim_binary_data(TestContext* context)
     return success;
 }
 
+static bool
+test_getdelimstr(TestContext* context)
+{
+    bool success = true;
+    ssize_t bytesRead;
+
+    static const char data[] =
+        "GET / HTTP/1.1\r\nHost: x\r\n\r\nbody\r\n"
+        "a\0\0b\0c\0\0"
+        "--EN--END--tail";
+
+    if (fwrite(data, sizeof data - 1, 1, context->fp) != 1)
+    {
+        fprintf(stderr, "Failed to write to temporary file.\n");
+        return false;
+    }
+
+    fflush(context->fp);
+    rewind(context->fp);
+
+    bytesRead = getdelimstr(&(context->line), &(context->len),
+                            "\r\n\r\n", 4, context->fp);
+    success &= EXPECT_VAL((long) bytesRead, 27L, "%ld");
+    success &= EXPECT_STR(context->line,
+                          "GET / HTTP/1.1\r\nHost: x\r\n\r\n");
+
+    /* A lone CR-LF is not a delimiter; the body runs into the next one. */
+    bytesRead = getdelimstr(&(context->line), &(context->len),
+                            "\0\0", 2, context->fp);
+    success &= EXPECT_VAL((long) bytesRead, 9L, "%ld");
+    success &= EXPECT(memcmp(context->line, "body\r\na\0\0", 10) == 0);
+
+    bytesRead = getdelimstr(&(context->line), &(context->len),
+                            "\0\0", 2, context->fp);
+    success &= EXPECT_VAL((long) bytesRead, 5L, "%ld");
+    success &= EXPECT(memcmp(context->line, "b\0c\0\0", 6) == 0);
+
+    /* The delimiter must be found even if a partial match precedes it. */
+    bytesRead = getdelimstr(&(context->line), &(context->len),
+                            "--END--", 7, context->fp);
+    success &= EXPECT_VAL((long) bytesRead, 11L, "%ld");
+    success &= EXPECT_STR(context->line, "--EN--END--");
+
+    bytesRead = getdelimstr(&(context->line), &(context->len),
+                            "--END--", 7, context->fp);
+    success &= EXPECT_VAL((long) bytesRead, 4L, "%ld");
+    success &= EXPECT_STR(context->line, "tail");
+
+    bytesRead = getdelimstr(&(context->line), &(context->len),
+                            "--END--", 7, context->fp);
+    success &= EXPECT_VAL((long) bytesRead, -1L, "%ld");
+
+    return success;
+}
+
+static bool
+test_getdelim_bounded(TestContext* context)
+{
+    bool success = true;
+    ssize_t bytesRead;
+    int truncated;
+    size_t i;
+
+    fputs("short\n1234567\n12345678\n", context->fp);
+    for (i = 0; i < 1000; i++)
+    {
+        fputc('x', context->fp);
+    }
+    fputs("\nlast line", context->fp);
+    fflush(context->fp);
+    rewind(context->fp);
+
+    bytesRead = getdelim_bounded(&(context->line), &(context->len), '\n', 8,
+                                 GETLINE_TRUNCATE_LONG, &truncated,
+                                 context->fp);
+    success &= EXPECT_VAL((long) bytesRead, 6L, "%ld");
+    success &= EXPECT_STR(context->line, "short\n");
+    success &= EXPECT_VAL(truncated, 0, "%d");
+
+    bytesRead = getdelim_bounded(&(context->line), &(context->len), '\n', 8,
+                                 GETLINE_TRUNCATE_LONG, &truncated,
+                                 context->fp);
+    success &= EXPECT_VAL((long) bytesRead, 8L, "%ld");
+    success &= EXPECT_STR(context->line, "1234567\n");
+    success &= EXPECT_VAL(truncated, 0, "%d");
+
+    /* Only the delimiter is over the limit. */
+    bytesRead = getdelim_bounded(&(context->line), &(context->len), '\n', 8,
+                                 GETLINE_TRUNCATE_LONG, &truncated,
+                                 context->fp);
+    success &= EXPECT_VAL((long) bytesRead, 8L, "%ld");
+    success &= EXPECT_STR(context->line, "12345678");
+    success &= EXPECT_VAL(truncated, 1, "%d");
+
+    bytesRead = getdelim_bounded(&(context->line), &(context->len), '\n', 8,
+                                 GETLINE_TRUNCATE_LONG, &truncated,
+                                 context->fp);
+    success &= EXPECT_VAL((long) bytesRead, 8L, "%ld");
+    success &= EXPECT_STR(context->line, "xxxxxxxx");
+    success &= EXPECT_VAL(truncated, 1, "%d");
+    success &= EXPECT(context->len <= 9);
+
+    bytesRead = getdelim_bounded(&(context->line), &(context->len), '\n', 8,
+                                 GETLINE_TRUNCATE_LONG, &truncated,
+                                 context->fp);
+    success &= EXPECT_VAL((long) bytesRead, 8L, "%ld");
+    success &= EXPECT_STR(context->line, "last lin");
+    success &= EXPECT_VAL(truncated, 1, "%d");
+    success &= EXPECT(feof(context->fp));
+
+    /* Skip long lines instead. */
+    rewind(context->fp);
+    free(context->line);
+    context->line = NULL;
+    context->len = 0;
+
+    bytesRead = getdelim_bounded(&(context->line), &(context->len), '\n', 8,
+                                 GETLINE_SKIP_LONG, &truncated, context->fp);
+    success &= EXPECT_STR(context->line, "short\n");
+    bytesRead = getdelim_bounded(&(context->line), &(context->len), '\n', 8,
+                                 GETLINE_SKIP_LONG, &truncated, context->fp);
+    success &= EXPECT_STR(context->line, "1234567\n");
+    bytesRead = getdelim_bounded(&(context->line), &(context->len), '\n', 9,
+                                 GETLINE_SKIP_LONG, &truncated, context->fp);
+    success &= EXPECT_STR(context->line, "12345678\n");
+    bytesRead = getdelim_bounded(&(context->line), &(context->len), '\n', 9,
+                                 GETLINE_SKIP_LONG, &truncated, context->fp);
+    success &= EXPECT_VAL((long) bytesRead, 9L, "%ld");
+    success &= EXPECT_STR(context->line, "last line");
+    success &= EXPECT_VAL(truncated, 0, "%d");
+    success &= EXPECT(context->len <= 10);
+
+    /* A long final line is skipped to the end of the stream. */
+    rewind(context->fp);
+    for (i = 0; i < 3; i++)
+    {
+        bytesRead = getdelim_bounded(&(context->line), &(context->len), '\n',
+                                     4, GETLINE_SKIP_LONG, &truncated,
+                                     context->fp);
+        success &= EXPECT_VAL((long) bytesRead, -1L, "%ld");
+    }
+    success &= EXPECT(feof(context->fp));
+
+    return success;
+}
+
+static bool
+test_getdelim_sb(TestContext* context)
+{
+    bool success = true;
+    ssize_t bytesRead;
+    char stackBuffer[8];
+    char* line = NULL;
+    size_t len = 0;
+
+    fputs("short\n123456\nthis line is too long\nshort\n", context->fp);
+    fflush(context->fp);
+    rewind(context->fp);
+
+    bytesRead = getdelim_sb(&line, &len, '\n',
+                            stackBuffer, sizeof stackBuffer, context->fp);
+    success &= EXPECT_VAL((long) bytesRead, 6L, "%ld");
+    success &= EXPECT(line == stackBuffer);
+    success &= EXPECT_VAL((unsigned long) len,
+                          (unsigned long) sizeof stackBuffer, "%lu");
+    success &= EXPECT_STR(line, "short\n");
+
+    /* Exactly fills the buffer, including the `NUL`-terminator. */
+    bytesRead = getdelim_sb(&line, &len, '\n',
+                            stackBuffer, sizeof stackBuffer, context->fp);
+    success &= EXPECT_VAL((long) bytesRead, 7L, "%ld");
+    success &= EXPECT(line == stackBuffer);
+    success &= EXPECT_STR(line, "123456\n");
+
+    bytesRead = getdelim_sb(&line, &len, '\n',
+                            stackBuffer, sizeof stackBuffer, context->fp);
+    success &= EXPECT_VAL((long) bytesRead, 22L, "%ld");
+    success &= EXPECT(line != stackBuffer);
+    success &= EXPECT(len > (size_t) bytesRead);
+    success &= EXPECT_STR(line, "this line is too long\n");
+
+    /* The allocated buffer is reused once it exists. */
+    bytesRead = getdelim_sb(&line, &len, '\n',
+                            stackBuffer, sizeof stackBuffer, context->fp);
+    success &= EXPECT_VAL((long) bytesRead, 6L, "%ld");
+    success &= EXPECT(line != stackBuffer);
+    success &= EXPECT_STR(line, "short\n");
+
+    if (line != stackBuffer)
+    {
+        free(line);
+    }
+    return success;
+}
+
 static bool
 test_fggets_single_line(TestContext* context, bool newlineTerminated)
 {
@@ -987,45 +1224,3179 @@ static bool test_fggets_univ_without_newline(TestContext* context)
 }
 
 
-int
-main(void)
+static bool
+test_lineindex_read_line_n(TestContext* context)
+{
+    bool success = true;
+    FILE* indexFile = NULL;
+    LineIndex* index = NULL;
+    char expectedString[32];
+    int result;
+    unsigned long i;
+
+    const unsigned long numLines = 10;
+
+    for (i = 0; i < numLines; i++)
+    {
+        fprintf(context->fp, "Line %lu\n", i);
+    }
+    fflush(context->fp);
+
+    indexFile = tmpfile();
+    if (indexFile == NULL)
+    {
+        fprintf(stderr, "Failed to create temporary file.\n");
+        return false;
+    }
+
+    result = lineindex_build(context->fp, indexFile, 3, '\n');
+    success &= EXPECT_VAL(result, 0, "%d");
+    index = lineindex_open(indexFile);
+    success &= EXPECT(index != NULL);
+    if (index == NULL)
+    {
+        goto exit;
+    }
+
+    success &= EXPECT_VAL((unsigned long) lineindex_line_count(index),
+                          numLines, "%lu");
+
+    /* Read the lines out of order to exercise seeking. */
+    for (i = numLines; i-- > 0;)
+    {
+        ssize_t bytesRead = read_line_n(&(context->line), &(context->len),
+                                        context->fp, index, i);
+        sprintf(expectedString, "Line %lu\n", i);
+        success &= EXPECT_VAL((long) bytesRead,
+                              (long) strlen(expectedString), "%ld");
+        success &= EXPECT_STR(context->line, expectedString);
+    }
+
+    errno = 0;
+    result = seek_to_line(context->fp, index, numLines);
+    success &= EXPECT_VAL(result, -1, "%d");
+    success &= EXPECT_VAL(errno, ERANGE, "%d");
+
+exit:
+    lineindex_close(index);
+    fclose(indexFile);
+    return success;
+}
+
+
+static bool
+test_lineindex_univ_extend(TestContext* context)
+{
+    bool success = true;
+    FILE* indexFile = NULL;
+    LineIndex* index = NULL;
+    int result;
+
+    /* The trailing CR must not be counted as the start of a new line when
+     * the appended data begins with the LF that completes it.
+     */
+    fprintf(context->fp, "%s", "a\rb\r");
+    fflush(context->fp);
+
+    indexFile = tmpfile();
+    if (indexFile == NULL)
+    {
+        fprintf(stderr, "Failed to create temporary file.\n");
+        return false;
+    }
+
+    result = lineindex_build_univ(context->fp, indexFile, 2);
+    success &= EXPECT_VAL(result, 0, "%d");
+    index = lineindex_open(indexFile);
+    success &= EXPECT(index != NULL);
+    if (index == NULL)
+    {
+        goto exit;
+    }
+    success &= EXPECT_VAL((unsigned long) lineindex_line_count(index), 2UL,
+                          "%lu");
+    lineindex_close(index);
+
+    fseek(context->fp, 0, SEEK_END);
+    fprintf(context->fp, "%s", "\nc\r\nd");
+    fflush(context->fp);
+
+    result = lineindex_extend(context->fp, indexFile);
+    success &= EXPECT_VAL(result, 0, "%d");
+    index = lineindex_open(indexFile);
+    success &= EXPECT(index != NULL);
+    if (index == NULL)
+    {
+        goto exit;
+    }
+    success &= EXPECT_VAL((unsigned long) lineindex_line_count(index), 4UL,
+                          "%lu");
+
+    success &= EXPECT(read_line_n(&(context->line), &(context->len),
+                                  context->fp, index, 1) >= 0);
+    success &= EXPECT_STR(context->line, "b\n");
+    success &= EXPECT(read_line_n(&(context->line), &(context->len),
+                                  context->fp, index, 2) >= 0);
+    success &= EXPECT_STR(context->line, "c\n");
+    success &= EXPECT(read_line_n(&(context->line), &(context->len),
+                                  context->fp, index, 3) >= 0);
+    success &= EXPECT_STR(context->line, "d");
+
+exit:
+    lineindex_close(index);
+    fclose(indexFile);
+    return success;
+}
+
+
+/** overwrite_index_field
+  *
+  *     Replaces the `field`th 64-bit field of an index's header.
+  */
+static bool
+overwrite_index_field(FILE* indexFile, size_t field, uint64_t value)
+{
+    return    fseek(indexFile, (long) (field * sizeof value), SEEK_SET) == 0
+           && fwrite(&value, sizeof value, 1, indexFile) == 1
+           && fflush(indexFile) == 0;
+}
+
+
+static bool
+test_lineindex_corrupt_header(TestContext* context)
 {
     bool success = true;
+    FILE* indexFile = NULL;
+    LineIndex* index = NULL;
+    uint64_t lineCount;
+    int result;
+
+    /* Offsets of header fields in the on-disk format. */
+    enum
+    {
+        strideField = 2,
+        delimiterField = 3,
+        lineCountField = 5
+    };
+
+    fprintf(context->fp, "%s", "a\nb\nc\n");
+    fflush(context->fp);
+
+    indexFile = tmpfile();
+    if (indexFile == NULL)
+    {
+        fprintf(stderr, "Failed to create temporary file.\n");
+        return false;
+    }
+
+    result = lineindex_build(context->fp, indexFile, 1, '\n');
+    success &= EXPECT_VAL(result, 0, "%d");
+    index = lineindex_open(indexFile);
+    success &= EXPECT(index != NULL);
+    if (index == NULL)
+    {
+        fclose(indexFile);
+        return false;
+    }
+    lineCount = lineindex_line_count(index);
+    lineindex_close(index);
+
+    /* A line count whose index size would wrap around. */
+    success &= EXPECT(overwrite_index_field(indexFile, lineCountField,
+                                            UINT64_MAX / 4));
+    errno = 0;
+    index = lineindex_open(indexFile);
+    success &= EXPECT(index == NULL);
+    success &= EXPECT(errno != 0);
+    lineindex_close(index);
+
+    success &= EXPECT(overwrite_index_field(indexFile, strideField, 1));
+    success &= EXPECT(overwrite_index_field(indexFile, lineCountField,
+                                            (UINT64_MAX >> 3) - 1));
+    errno = 0;
+    index = lineindex_open(indexFile);
+    success &= EXPECT(index == NULL);
+    success &= EXPECT(errno != 0);
+    lineindex_close(index);
+
+    /* A delimiter that is not a byte. */
+    success &= EXPECT(overwrite_index_field(indexFile, lineCountField,
+                                            lineCount));
+    success &= EXPECT(overwrite_index_field(indexFile, delimiterField, 300));
+    errno = 0;
+    index = lineindex_open(indexFile);
+    success &= EXPECT(index == NULL);
+    success &= EXPECT(errno != 0);
+    lineindex_close(index);
+
+    /* Restoring the header makes the index usable again. */
+    success &= EXPECT(overwrite_index_field(indexFile, delimiterField, '\n'));
+    index = lineindex_open(indexFile);
+    success &= EXPECT(index != NULL);
+    if (index != NULL)
+    {
+        success &= EXPECT(lineindex_line_count(index) == lineCount);
+    }
+
+    lineindex_close(index);
+    fclose(indexFile);
+    return success;
+}
+
 
+static bool
+test_getline_rev(TestContext* context)
+{
+    bool success = true;
+    ReverseLineReader* reader;
     size_t i;
 
-    #define ADD_TEST(testCallback) { #testCallback, testCallback }
-    struct
+    const char* expectedStrings[] =
     {
-        const char* description;
-        TestCallback callback;
-    } tests[] =
+        "The last line has no newline.",
+        "\n",
+        "The quick brown fox jumps over the dog.\n",
+        "Pack my box with five dozen liquor jugs.\n",
+        "The five boxing wizards jump quickly.\n",
+    };
+
+    fprintf(context->fp, "%s",
+            "The five boxing wizards jump quickly.\r\n"
+            "Pack my box with five dozen liquor jugs.\r"
+            "The quick brown fox jumps over the dog.\n"
+            "\r\n"
+            "The last line has no newline.");
+
+    reader = revline_open(context->fp);
+    if (reader == NULL)
     {
-        ADD_TEST(test_escape_string),
-        ADD_TEST(test_alloc_strcat),
+        fprintf(stderr, "Failed to create reader.\n");
+        return false;
+    }
 
-        ADD_TEST(test_getline_empty_file),
-        ADD_TEST(test_getline_single_terminated_line),
-        ADD_TEST(test_getline_multiple_terminated_lines),
-        ADD_TEST(test_getline_file_with_long_lines),
-        ADD_TEST(test_getline_file_without_newline),
-        ADD_TEST(test_getline_writes_into_existing_buffer),
-        ADD_TEST(test_getline_grows_existing_buffer),
+    for (i = 0; i < ARRAY_LENGTH(expectedStrings); i++)
+    {
+        ssize_t bytesRead = getline_rev(&(context->line), &(context->len),
+                                        reader);
+        success &= EXPECT_VAL((long) bytesRead,
+                              (long) strlen(expectedStrings[i]), "%ld");
+        success &= EXPECT_STR(context->line, expectedStrings[i]);
+    }
 
-        ADD_TEST(test_getdelim_binary_data),
+    {
+        ssize_t bytesRead = getline_rev(&(context->line), &(context->len),
+                                        reader);
+        success &= EXPECT_VAL((long) bytesRead, -1L, "%ld");
+    }
 
-        ADD_TEST(test_fggets_single_terminated_line),
-        ADD_TEST(test_fggets_multiple_terminated_lines),
-        ADD_TEST(test_fggets_file_without_newline),
+    revline_close(reader);
+    return success;
+}
 
-        ADD_TEST(test_getline_univ_lf),
-        ADD_TEST(test_getline_univ_cr),
-        ADD_TEST(test_getline_univ_crlf),
-        ADD_TEST(test_getline_univ_without_newline),
-        ADD_TEST(test_fggets_univ_lf),
-        ADD_TEST(test_fggets_univ_cr),
-        ADD_TEST(test_fggets_univ_crlf),
-        ADD_TEST(test_fggets_univ_without_newline),
+
+#ifdef TEST_POSIX
+/** append_to_file
+  *
+  *     Appends `s` to the file at `path`, truncating it first if `truncate` is
+  *     true.
+  */
+static bool
+append_to_file(const char* path, const char* s, bool truncate)
+{
+    FILE* fp = fopen(path, truncate ? "wb" : "ab");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Failed to open %s.\n", path);
+        return false;
+    }
+    fputs(s, fp);
+    fclose(fp);
+    return true;
+}
+
+
+static bool
+expect_getline_follow(LineFollower* follower, char** line, size_t* len,
+                      const char* expectedString, int sourceLineNumber)
+{
+    bool success = true;
+    ssize_t bytesRead = getline_follow(line, len, follower, 5000);
+    success &= EXPECT_VAL_LINE((long) bytesRead,
+                               (long) strlen(expectedString), "%ld",
+                               sourceLineNumber);
+    if (bytesRead >= 0)
+    {
+        success &= expect_str(*line, expectedString, sourceLineNumber);
+    }
+    return success;
+}
+
+#define EXPECT_GETLINE_FOLLOW(follower, line, len, expectedString) \
+    expect_getline_follow(follower, line, len, expectedString, __LINE__)
+
+
+static bool
+test_getline_follow(TestContext* context)
+{
+    bool success = true;
+    LineFollower* follower = NULL;
+    ssize_t bytesRead;
+    char path[] = "/tmp/getline-test-XXXXXX";
+    char rotatedPath[sizeof path + 2];
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to create temporary file.\n");
+        return false;
+    }
+    close(fd);
+    sprintf(rotatedPath, "%s.1", path);
+
+    success &= append_to_file(path, "first\nsec", false);
+
+    follower = linefollow_open(path, LINEFOLLOW_FROM_START);
+    success &= EXPECT(follower != NULL);
+    if (follower == NULL)
+    {
+        goto exit;
+    }
+
+    success &= EXPECT_GETLINE_FOLLOW(follower, &(context->line),
+                                     &(context->len), "first\n");
+
+    /* The partial line must be held back until its newline arrives. */
+    errno = 0;
+    bytesRead = getline_follow(&(context->line), &(context->len), follower,
+                               0);
+    success &= EXPECT_VAL((long) bytesRead, -1L, "%ld");
+    success &= EXPECT_VAL(errno, ETIMEDOUT, "%d");
+
+    success &= append_to_file(path, "ond\n", false);
+    success &= EXPECT_GETLINE_FOLLOW(follower, &(context->line),
+                                     &(context->len), "second\n");
+
+    /* Truncation restarts from the beginning. */
+    success &= append_to_file(path, "", true);
+    bytesRead = getline_follow(&(context->line), &(context->len), follower,
+                               0);
+    success &= EXPECT_VAL((long) bytesRead, -1L, "%ld");
+    success &= append_to_file(path, "third\n", false);
+    success &= EXPECT_GETLINE_FOLLOW(follower, &(context->line),
+                                     &(context->len), "third\n");
+
+    /* Data written right after a truncation is available immediately. */
+    success &= append_to_file(path, "new\n", true);
+    bytesRead = getline_follow(&(context->line), &(context->len), follower,
+                               0);
+    success &= EXPECT_VAL((long) bytesRead, 4L, "%ld");
+    success &= EXPECT_STR(context->line, "new\n");
+
+    /* Rotation flushes the old file's partial line, then switches files. */
+    success &= append_to_file(path, "unterminated", false);
+    success &= EXPECT(rename(path, rotatedPath) == 0);
+    success &= append_to_file(path, "fourth\n", false);
+    success &= EXPECT_GETLINE_FOLLOW(follower, &(context->line),
+                                     &(context->len), "unterminated");
+    success &= EXPECT_GETLINE_FOLLOW(follower, &(context->line),
+                                     &(context->len), "fourth\n");
+
+exit:
+    linefollow_close(follower);
+    remove(path);
+    remove(rotatedPath);
+    return success;
+}
+#endif /* TEST_POSIX */
+
+
+/** write_random_lines
+  *
+  *     Writes `numLines` lines of random printable characters to `fp`, each
+  *     terminated by a randomly chosen CR, LF, or CR-LF (or by a newline if
+  *     `universalNewlines` is false).  The final line is left unterminated.
+  */
+static void
+write_random_lines(FILE* fp, size_t numLines, bool universalNewlines)
+{
+    static const char* lineEndings[] = { "\n", "\r", "\r\n" };
+    const char* lineEnding = "";
+    size_t i;
+    for (i = 0; i < numLines; i++)
+    {
+        size_t length = (size_t) (rand() % 80);
+
+        /* An empty line after a CR would turn it into a CR-LF sequence. */
+        if (length == 0 && strcmp(lineEnding, "\r") == 0)
+        {
+            length = 1;
+        }
+
+        while (length-- > 0)
+        {
+            fputc(random_printable_char(), fp);
+        }
+
+        if (i + 1 < numLines)
+        {
+            lineEnding = universalNewlines
+                         ? lineEndings[rand() % ARRAY_LENGTH(lineEndings)]
+                         : "\n";
+            fputs(lineEnding, fp);
+        }
+    }
+    fflush(fp);
+    rewind(fp);
+}
+
+
+static bool
+test_count_lines(TestContext* context)
+{
+    bool success = true;
+    ssize_t count;
+
+    fprintf(context->fp, "%s", "a\nb\n\nc");
+    fflush(context->fp);
+    rewind(context->fp);
+    count = count_lines(context->fp, '\n');
+    success &= EXPECT_VAL((long) count, 4L, "%ld");
+
+    rewind(context->fp);
+    count = count_lines(context->fp, 'b');
+    success &= EXPECT_VAL((long) count, 2L, "%ld");
+
+    {
+        FILE* emptyFile = tmpfile();
+        if (emptyFile == NULL)
+        {
+            fprintf(stderr, "Failed to create temporary file.\n");
+            return false;
+        }
+        count = count_lines(emptyFile, '\n');
+        success &= EXPECT_VAL((long) count, 0L, "%ld");
+        fclose(emptyFile);
+    }
+
+    return success;
+}
+
+
+static bool
+test_count_lines_univ(TestContext* context)
+{
+    bool success = true;
+    const size_t numLines = 500;
+
+    ssize_t count;
+    FILE* crlfFile;
+    size_t i;
+
+    write_random_lines(context->fp, numLines, true);
+    count = count_lines_univ(context->fp);
+    success &= EXPECT_VAL((long) count, (long) numLines, "%ld");
+
+    /* Only CR-LF line endings, of every length, so that the sequences
+     * straddle block and word boundaries.
+     */
+    crlfFile = tmpfile();
+    if (crlfFile == NULL)
+    {
+        fprintf(stderr, "Failed to create temporary file.\n");
+        return false;
+    }
+    for (i = 0; i < numLines; i++)
+    {
+        size_t j;
+        for (j = 0; j < i % 37; j++)
+        {
+            fputc('x', crlfFile);
+        }
+        fputs("\r\n", crlfFile);
+    }
+    fputc('\r', crlfFile);
+    fflush(crlfFile);
+    rewind(crlfFile);
+    count = count_lines_univ(crlfFile);
+    success &= EXPECT_VAL((long) count, (long) numLines + 1, "%ld");
+    fclose(crlfFile);
+    return success;
+}
+
+
+static bool
+test_skip_lines(TestContext* context, bool universalNewlines)
+{
+    bool success = true;
+    size_t i;
+    const size_t numLines = 200;
+
+    write_random_lines(context->fp, numLines, universalNewlines);
+
+    for (i = 0; success && i <= numLines; i += 7)
+    {
+        char* expectedLine = NULL;
+        size_t expectedLength = 0;
+        size_t j;
+        ssize_t skipped;
+
+        for (j = 0; j <= i; j++)
+        {
+            (universalNewlines ? getline_univ : getline)(&expectedLine,
+                                                         &expectedLength,
+                                                         context->fp);
+        }
+
+        rewind(context->fp);
+        skipped = (universalNewlines ? skip_lines_univ : skip_lines)(
+            context->fp, i);
+        success &= EXPECT_VAL((long) skipped, (long) i, "%ld");
+
+        if (i < numLines)
+        {
+            success &= expect_getline(&(context->line), &(context->len),
+                                      context->fp, expectedLine,
+                                      universalNewlines, __LINE__);
+        }
+
+        free(expectedLine);
+        rewind(context->fp);
+    }
+
+    /* Skipping past the end reports how many lines there were. */
+    {
+        ssize_t skipped = (universalNewlines
+                           ? skip_lines_univ
+                           : skip_lines)(context->fp, numLines + 10);
+        success &= EXPECT_VAL((long) skipped, (long) numLines, "%ld");
+    }
+    return success;
+}
+
+
+static bool
+test_skip_lines_lf(TestContext* context)
+{
+    return test_skip_lines(context, false);
+}
+
+
+static bool
+test_skip_lines_univ(TestContext* context)
+{
+    return test_skip_lines(context, true);
+}
+
+
+static bool
+test_linereader_next_univ(TestContext* context)
+{
+    bool success = true;
+    LineReader* reader;
+    FILE* referenceFile;
+    const size_t numLines = 300;
+
+    write_random_lines(context->fp, numLines, true);
+
+    reader = linereader_new(context->fp);
+    referenceFile = tmpfile();
+    if (reader == NULL || referenceFile == NULL)
+    {
+        fprintf(stderr, "Failed to create reader.\n");
+        linereader_free(reader);
+        if (referenceFile != NULL)
+        {
+            fclose(referenceFile);
+        }
+        return false;
+    }
+
+    /* Compare against `getline_univ`, which sees the same data. */
+    {
+        int c;
+        while ((c = fgetc(context->fp)) != EOF)
+        {
+            fputc(c, referenceFile);
+        }
+        fflush(referenceFile);
+        rewind(referenceFile);
+        rewind(context->fp);
+    }
+
+    while (success)
+    {
+        const char* line;
+        ssize_t length = linereader_next(reader, &line, LINEREADER_UNIV);
+        ssize_t expectedLength = getline_univ(&(context->line),
+                                              &(context->len),
+                                              referenceFile);
+        size_t contentLength;
+
+        success &= EXPECT_VAL((int) (length >= 0),
+                              (int) (expectedLength >= 0), "%d");
+        if (length < 0 || expectedLength < 0)
+        {
+            break;
+        }
+
+        /* Lines from the reader keep their original line endings. */
+        contentLength = (size_t) length;
+        while (   contentLength > 0
+               && (line[contentLength - 1] == '\r'
+                   || line[contentLength - 1] == '\n'))
+        {
+            contentLength--;
+        }
+
+        success &= EXPECT_VAL((unsigned long) contentLength,
+                              (unsigned long) strcspn(context->line, "\n"),
+                              "%lu");
+        success &= EXPECT(memcmp(line, context->line, contentLength) == 0);
+    }
+
+    linereader_free(reader);
+    fclose(referenceFile);
+    return success;
+}
+
+
+static bool
+expect_fields(const char* line, const LineFields* fields,
+              const char** expectedFields, size_t numExpectedFields,
+              int sourceLineNumber)
+{
+    bool success = true;
+    size_t i;
+
+    success &= EXPECT_VAL_LINE((unsigned long) fields->count,
+                               (unsigned long) numExpectedFields, "%lu",
+                               sourceLineNumber);
+    for (i = 0; success && i < numExpectedFields; i++)
+    {
+        size_t length = fields->bounds[i + 1] - fields->bounds[i] - 1;
+        success &= EXPECT_VAL_LINE((unsigned long) length,
+                                   (unsigned long) strlen(expectedFields[i]),
+                                   "%lu", sourceLineNumber);
+        success &= EXPECT_LINE(memcmp(&line[fields->bounds[i]],
+                                      expectedFields[i], length) == 0,
+                               sourceLineNumber);
+    }
+    return success;
+}
+
+#define EXPECT_FIELDS(line, fields, expectedFields) \
+    expect_fields(line, fields, expectedFields, ARRAY_LENGTH(expectedFields), \
+                  __LINE__)
+
+
+static bool
+test_linereader_next_fields(TestContext* context)
+{
+    bool success = true;
+    LineReader* reader;
+    LineFields fields = LINEFIELDS_INIT;
+    const char* line;
+    ssize_t length;
+    size_t i;
+
+    const char* expectedFields1[] = { "alpha", "beta", "", "gamma" };
+    const char* expectedFields2[] = { "", "" };
+    const char* expectedFields3[] =
+    {
+        "The five boxing wizards jump quickly."
+    };
+    const char* expectedFields5[] = { "unterminated", "line" };
+
+    fprintf(context->fp, "%s",
+            "alpha\tbeta\t\tgamma\n"
+            "\t\n"
+            "The five boxing wizards jump quickly.\n");
+    for (i = 0; i < 100; i++)
+    {
+        fprintf(context->fp, "%s%lu", (i == 0) ? "" : "\t", (unsigned long) i);
+    }
+    fprintf(context->fp, "%s", "\nunterminated\tline");
+    fflush(context->fp);
+    rewind(context->fp);
+
+    reader = linereader_new(context->fp);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "Failed to create reader.\n");
+        return false;
+    }
+
+    length = linereader_next_fields(reader, &line, '\n', '\t', &fields);
+    success &= EXPECT_VAL((long) length, 18L, "%ld");
+    success &= EXPECT_FIELDS(line, &fields, expectedFields1);
+
+    length = linereader_next_fields(reader, &line, '\n', '\t', &fields);
+    success &= EXPECT_VAL((long) length, 2L, "%ld");
+    success &= EXPECT_FIELDS(line, &fields, expectedFields2);
+
+    length = linereader_next_fields(reader, &line, '\n', '\t', &fields);
+    success &= EXPECT(length > 0);
+    success &= EXPECT_FIELDS(line, &fields, expectedFields3);
+
+    length = linereader_next_fields(reader, &line, '\n', '\t', &fields);
+    success &= EXPECT(length > 0);
+    success &= EXPECT_VAL((unsigned long) fields.count, 100UL, "%lu");
+    for (i = 0; success && i < fields.count; i++)
+    {
+        success &= EXPECT_VAL(strtoul(&line[fields.bounds[i]], NULL, 10),
+                              (unsigned long) i, "%lu");
+    }
+
+    length = linereader_next_fields(reader, &line, '\n', '\t', &fields);
+    success &= EXPECT_VAL((long) length, 17L, "%ld");
+    success &= EXPECT_FIELDS(line, &fields, expectedFields5);
+
+    length = linereader_next_fields(reader, &line, '\n', '\t', &fields);
+    success &= EXPECT_VAL((long) length, -1L, "%ld");
+
+    linefields_free(&fields);
+    linereader_free(reader);
+    return success;
+}
+
+
+static bool
+test_linereader_next_csv(TestContext* context)
+{
+    bool success = true;
+    LineReader* reader;
+    LineFields fields = LINEFIELDS_INIT;
+    const char* record;
+    ssize_t length;
+    char decoded[128];
+    size_t decodedLength;
+
+    const char* expectedFields1[] = { "name", "quote", "" };
+    const char* expectedFields2[] =
+    {
+        "\"Wizard\"",
+        "\"The five boxing wizards,\r\njump \"\"quickly\"\".\"",
+        "",
+    };
+    const char* expectedFields3[] = { "", "\"\"", "x" };
+
+    fprintf(context->fp, "%s",
+            "name,quote,\r\n"
+            "\"Wizard\",\"The five boxing wizards,\r\njump \"\"quickly\"\".\","
+            "\n"
+            ",\"\",x");
+    fflush(context->fp);
+    rewind(context->fp);
+
+    reader = linereader_new(context->fp);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "Failed to create reader.\n");
+        return false;
+    }
+
+    length = linereader_next_csv(reader, &record, ',', &fields);
+    success &= EXPECT_VAL((long) length, 13L, "%ld");
+    success &= EXPECT_FIELDS(record, &fields, expectedFields1);
+
+    length = linereader_next_csv(reader, &record, ',', &fields);
+    success &= EXPECT_VAL((long) length, 56L, "%ld");
+    success &= EXPECT_FIELDS(record, &fields, expectedFields2);
+    if (fields.count == 3)
+    {
+        decodedLength = csv_unquote(&record[fields.bounds[1]],
+                                    fields.bounds[2] - fields.bounds[1] - 1,
+                                    decoded);
+        decoded[decodedLength] = '\0';
+        success &= EXPECT_STR(decoded,
+                              "The five boxing wizards,\r\njump \"quickly\".");
+    }
+
+    length = linereader_next_csv(reader, &record, ',', &fields);
+    success &= EXPECT_VAL((long) length, 5L, "%ld");
+    success &= EXPECT_FIELDS(record, &fields, expectedFields3);
+
+    length = linereader_next_csv(reader, &record, ',', &fields);
+    success &= EXPECT_VAL((long) length, -1L, "%ld");
+
+    linefields_free(&fields);
+    linereader_free(reader);
+    return success;
+}
+
+
+static bool
+test_linereader_next_str(TestContext* context)
+{
+    bool success = true;
+    LineReader* reader;
+    static const char delimiter[] = "<=>";
+    const size_t delimiterLength = sizeof delimiter - 1;
+    size_t i;
+
+    /* Records of random lengths made of the delimiter's characters, so that
+     * partial matches are common and delimiters straddle refills.
+     */
+    for (i = 0; i < 2000; i++)
+    {
+        fputc("<=>x"[rand() % 4], context->fp);
+    }
+    fflush(context->fp);
+    rewind(context->fp);
+
+    reader = linereader_new(context->fp);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "Failed to create reader.\n");
+        return false;
+    }
+
+    /* `linereader_next_str` reads the same stream, so compare against the
+     * lines that `getdelimstr` returns from a second pass.
+     */
+    {
+        FILE* referenceFile = tmpfile();
+        int c;
+        if (referenceFile == NULL)
+        {
+            fprintf(stderr, "Failed to create temporary file.\n");
+            linereader_free(reader);
+            return false;
+        }
+        while ((c = fgetc(context->fp)) != EOF)
+        {
+            fputc(c, referenceFile);
+        }
+        fflush(referenceFile);
+        rewind(referenceFile);
+        rewind(context->fp);
+
+        while (success)
+        {
+            const char* line;
+            ssize_t length = linereader_next_str(reader, &line, delimiter,
+                                                 delimiterLength);
+            ssize_t expectedLength = getdelimstr(&(context->line),
+                                                 &(context->len),
+                                                 delimiter, delimiterLength,
+                                                 referenceFile);
+
+            success &= EXPECT_VAL((long) length, (long) expectedLength,
+                                  "%ld");
+            if (length < 0 || expectedLength < 0)
+            {
+                break;
+            }
+            success &= EXPECT(memcmp(line, context->line,
+                                     (size_t) length) == 0);
+        }
+
+        fclose(referenceFile);
+    }
+
+    linereader_free(reader);
+    return success;
+}
+
+
+static bool
+test_linereader_next_ndjson(TestContext* context)
+{
+    bool success = true;
+    LineReader* reader;
+    const char* record;
+    ssize_t length;
+    int valid;
+    size_t i;
+
+    /* Strings with runs of backslashes that straddle a block boundary,
+     * followed by a quote that is escaped only if the run has an odd length.
+     */
+    static char evenBackslashes[128];
+    static char oddBackslashes[128];
+    char dots[41];
+    char backslashes[39];
+
+    static const struct
+    {
+        const char* record;
+        int valid;
+    } records[] =
+    {
+        { "{\"a\": [1, 2, {\"b\": null}]}\n", 1 },
+        { "{\"a\": \"}]\"}\r\n", 1 },
+        { "{\"a\": \"\\\"}\"}\n", 1 },
+        { "{\"a\": \"\\\\\"}\n", 1 },
+        { "{\"a\": \"\\\\\\\"}\n", 0 },
+        { "\"scalar\"\n", 1 },
+        { "[{]}\n", 0 },
+        { "{\"a\": 1\n", 0 },
+        { "{\"a\": 1}}\n", 0 },
+        { " \t\r\n", 0 },
+        { "\n", 0 },
+        /* Escapes and strings that span 64-byte blocks. */
+        { evenBackslashes, 1 },
+        { oddBackslashes, 0 },
+        { "[\"unterminated", 0 },
+    };
+
+    memset(dots, '.', sizeof dots - 1);
+    dots[sizeof dots - 1] = '\0';
+    memset(backslashes, '\\', sizeof backslashes - 1);
+    backslashes[sizeof backslashes - 1] = '\0';
+
+    sprintf(evenBackslashes, "{\"key\": \"%.40s%.38s\", \"b\": \"]]]\"}\n",
+            dots, backslashes);
+    sprintf(oddBackslashes, "{\"key\": \"%.40s%.37s\", \"b\": \"]]]\"}\n",
+            dots, backslashes);
+
+    for (i = 0; i < ARRAY_LENGTH(records); i++)
+    {
+        fputs(records[i].record, context->fp);
+    }
+    fflush(context->fp);
+    rewind(context->fp);
+
+    reader = linereader_new(context->fp);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "Failed to create reader.\n");
+        return false;
+    }
+
+    for (i = 0; i < ARRAY_LENGTH(records); i++)
+    {
+        size_t expectedLength = strlen(records[i].record);
+        length = linereader_next_ndjson(reader, &record, 0, &valid);
+        success &= EXPECT_VAL((long) length, (long) expectedLength, "%ld");
+        success &= EXPECT_VAL(valid, records[i].valid, "%d");
+        if (length < 0)
+        {
+            break;
+        }
+        success &= EXPECT(memcmp(record, records[i].record,
+                                 expectedLength) == 0);
+    }
+
+    length = linereader_next_ndjson(reader, &record, 0, &valid);
+    success &= EXPECT_VAL((long) length, -1L, "%ld");
+    linereader_free(reader);
+
+    /* Only the valid records should be returned when skipping. */
+    rewind(context->fp);
+    reader = linereader_new(context->fp);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "Failed to create reader.\n");
+        return false;
+    }
+
+    for (i = 0; i < ARRAY_LENGTH(records); i++)
+    {
+        if (!records[i].valid)
+        {
+            continue;
+        }
+
+        length = linereader_next_ndjson(reader, &record, NDJSON_SKIP_INVALID,
+                                        &valid);
+        success &= EXPECT_VAL((long) length,
+                              (long) strlen(records[i].record), "%ld");
+        success &= EXPECT_VAL(valid, 1, "%d");
+        if (length < 0)
+        {
+            break;
+        }
+        success &= EXPECT(memcmp(record, records[i].record,
+                                 (size_t) length) == 0);
+    }
+
+    length = linereader_next_ndjson(reader, &record, NDJSON_SKIP_INVALID,
+                                    NULL);
+    success &= EXPECT_VAL((long) length, -1L, "%ld");
+
+    linereader_free(reader);
+    return success;
+}
+
+
+/** expect_filtered_lines
+  *
+  *     Verifies that `linereader_next_containing` (or
+  *     `linereader_next_containing_any` if `anyOf` is true) returns the same
+  *     lines as filtering the output of `getline`.
+  */
+static bool
+expect_filtered_lines(TestContext* context, const char* pattern, bool anyOf,
+                      int sourceLineNumber)
+{
+    bool success = true;
+    size_t patternLength = strlen(pattern);
+    LineReader* reader = linereader_new(context->fp);
+    FILE* referenceFile = tmpfile();
+    int c;
+
+    if (reader == NULL || referenceFile == NULL)
+    {
+        fprintf(stderr, "Failed to create reader.\n");
+        linereader_free(reader);
+        if (referenceFile != NULL)
+        {
+            fclose(referenceFile);
+        }
+        return false;
+    }
+
+    while ((c = fgetc(context->fp)) != EOF)
+    {
+        fputc(c, referenceFile);
+    }
+    fflush(referenceFile);
+    rewind(referenceFile);
+    rewind(context->fp);
+
+    while (success)
+    {
+        const char* line;
+        ssize_t length = anyOf
+                         ? linereader_next_containing_any(reader, &line, '\n',
+                                                          pattern,
+                                                          patternLength)
+                         : linereader_next_containing(reader, &line, '\n',
+                                                      pattern,
+                                                      patternLength);
+        ssize_t expectedLength;
+        while ((expectedLength = getline(&(context->line), &(context->len),
+                                         referenceFile)) >= 0)
+        {
+            if (anyOf ? strpbrk(context->line, pattern) != NULL
+                      : strstr(context->line, pattern) != NULL)
+            {
+                break;
+            }
+        }
+
+        success &= EXPECT_VAL_LINE((long) length, (long) expectedLength,
+                                   "%ld", sourceLineNumber);
+        if (length < 0 || expectedLength < 0)
+        {
+            break;
+        }
+        success &= EXPECT_LINE(memcmp(line, context->line,
+                                      (size_t) length) == 0,
+                               sourceLineNumber);
+    }
+
+    success &= EXPECT_LINE(feof(context->fp), sourceLineNumber);
+
+    linereader_free(reader);
+    fclose(referenceFile);
+    rewind(context->fp);
+    return success;
+}
+
+#define EXPECT_FILTERED_LINES(context, pattern, anyOf) \
+    expect_filtered_lines(context, pattern, anyOf, __LINE__)
+
+
+static bool
+test_linereader_next_containing(TestContext* context)
+{
+    bool success = true;
+    size_t i;
+
+    /* Put the needle in about one line in ten, sometimes at the start or end
+     * of a line or of the file.
+     */
+    fputs("needle", context->fp);
+    for (i = 0; i < 1000; i++)
+    {
+        size_t length = (size_t) (rand() % 80);
+        size_t needlePosition = (rand() % 10 == 0)
+                                ? (size_t) (rand() % (length + 1))
+                                : (size_t) -1;
+        size_t j;
+        for (j = 0; j <= length; j++)
+        {
+            if (j == needlePosition)
+            {
+                fputs("needle", context->fp);
+            }
+            if (j < length)
+            {
+                fputc(random_printable_char(), context->fp);
+            }
+        }
+        fputc('\n', context->fp);
+    }
+    fputs("last needle", context->fp);
+    fflush(context->fp);
+    rewind(context->fp);
+
+    success &= EXPECT_FILTERED_LINES(context, "needle", false);
+    success &= EXPECT_FILTERED_LINES(context, "n", false);
+    success &= EXPECT_FILTERED_LINES(context, "no such text", false);
+    success &= EXPECT_FILTERED_LINES(context, "#@", true);
+    success &= EXPECT_FILTERED_LINES(context, "~", true);
+    return success;
+}
+
+
+static bool
+test_linereader_next_prefix(TestContext* context)
+{
+    bool success = true;
+    LineReader* reader;
+    LineReader* referenceReader;
+    FILE* referenceFile;
+    int pass;
+
+    write_random_lines(context->fp, 300, true);
+
+    referenceFile = tmpfile();
+    if (referenceFile == NULL)
+    {
+        fprintf(stderr, "Failed to create temporary file.\n");
+        return false;
+    }
+
+    {
+        int c;
+        while ((c = fgetc(context->fp)) != EOF)
+        {
+            fputc(c, referenceFile);
+        }
+        fflush(referenceFile);
+    }
+
+    /* Compare against the whole lines returned by `linereader_next`. */
+    for (pass = 0; pass < 2 && success; pass++)
+    {
+        int delimiter = (pass == 0) ? '\n' : LINEREADER_UNIV;
+
+        rewind(context->fp);
+        rewind(referenceFile);
+        reader = linereader_new(context->fp);
+        referenceReader = linereader_new(referenceFile);
+        if (reader == NULL || referenceReader == NULL)
+        {
+            fprintf(stderr, "Failed to create reader.\n");
+            linereader_free(reader);
+            linereader_free(referenceReader);
+            success = false;
+            break;
+        }
+
+        while (success)
+        {
+            char prefix[16];
+            const char* line;
+            ssize_t length = linereader_next_prefix(reader, prefix,
+                                                    sizeof prefix, delimiter);
+            ssize_t expectedLength = linereader_next(referenceReader, &line,
+                                                     delimiter);
+
+            success &= EXPECT_VAL((long) length, (long) expectedLength,
+                                  "%ld");
+            if (length < 0 || expectedLength < 0)
+            {
+                break;
+            }
+
+            success &= EXPECT(memcmp(prefix, line,
+                                     ((size_t) length < sizeof prefix)
+                                     ? (size_t) length
+                                     : sizeof prefix) == 0);
+        }
+
+        linereader_free(reader);
+        linereader_free(referenceReader);
+    }
+
+    fclose(referenceFile);
+    return success;
+}
+
+
+static bool
+test_linereader_getdelim_continuations(TestContext* context)
+{
+    bool success = true;
+    LineReader* reader;
+    ssize_t length;
+
+    fputs("plain\n"
+          "CFLAGS = -Wall \\\n"
+          "         -Wextra \\\r\n"
+          "         -O2\r\n"
+          "not\\ continued\n"
+          "trailing \\",
+          context->fp);
+    fflush(context->fp);
+    rewind(context->fp);
+
+    reader = linereader_new(context->fp);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "Failed to create reader.\n");
+        return false;
+    }
+
+    length = linereader_getdelim(reader, &(context->line), &(context->len),
+                                 LINEREADER_UNIV,
+                                 LINEREADER_JOIN_CONTINUATIONS);
+    success &= EXPECT_VAL((long) length, 6L, "%ld");
+    success &= EXPECT_STR(context->line, "plain\n");
+
+    length = linereader_getdelim(reader, &(context->line), &(context->len),
+                                 LINEREADER_UNIV,
+                                 LINEREADER_JOIN_CONTINUATIONS);
+    success &= EXPECT_VAL((long) length, 46L, "%ld");
+    success &= EXPECT_STR(context->line,
+                          "CFLAGS = -Wall          -Wextra          -O2\r\n");
+
+    length = linereader_getdelim(reader, &(context->line), &(context->len),
+                                 LINEREADER_UNIV,
+                                 LINEREADER_JOIN_CONTINUATIONS);
+    success &= EXPECT_STR(context->line, "not\\ continued\n");
+
+    /* A backslash at the end of the stream is not a continuation. */
+    length = linereader_getdelim(reader, &(context->line), &(context->len),
+                                 LINEREADER_UNIV,
+                                 LINEREADER_JOIN_CONTINUATIONS);
+    success &= EXPECT_STR(context->line, "trailing \\");
+
+    length = linereader_getdelim(reader, &(context->line), &(context->len),
+                                 LINEREADER_UNIV,
+                                 LINEREADER_JOIN_CONTINUATIONS);
+    success &= EXPECT_VAL((long) length, -1L, "%ld");
+    linereader_free(reader);
+
+    /* With an LF delimiter, "\\\r\n" is not a continuation. */
+    rewind(context->fp);
+    reader = linereader_new(context->fp);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "Failed to create reader.\n");
+        return false;
+    }
+
+    length = linereader_getdelim(reader, &(context->line), &(context->len),
+                                 '\n', LINEREADER_JOIN_CONTINUATIONS);
+    success &= EXPECT_STR(context->line, "plain\n");
+    length = linereader_getdelim(reader, &(context->line), &(context->len),
+                                 '\n', LINEREADER_JOIN_CONTINUATIONS);
+    success &= EXPECT_STR(context->line,
+                          "CFLAGS = -Wall          -Wextra \\\r\n");
+
+    /* Without the option, lines are returned as they are. */
+    length = linereader_getdelim(reader, &(context->line), &(context->len),
+                                 '\n', 0);
+    success &= EXPECT_STR(context->line, "         -O2\r\n");
+
+    linereader_free(reader);
+    return success;
+}
+
+
+static bool
+test_linereader_getdelim_transforms(TestContext* context)
+{
+    bool success = true;
+    LineReader* reader;
+    ssize_t length;
+    char allBytes[UCHAR_MAX];
+    char expectedBytes[UCHAR_MAX];
+    size_t i;
+
+    /* Every byte value except for NUL and the delimiter. */
+    for (i = 0; i < sizeof allBytes; i++)
+    {
+        char c = (char) (i + 1);
+        if (c == '\n')
+        {
+            c = 'Q';
+        }
+        allBytes[i] = c;
+        expectedBytes[i] = (c >= 'A' && c <= 'Z') ? (char) (c - 'A' + 'a') : c;
+    }
+
+    fputs("  Key = VALUE \t\r\n"
+          "\t \r\n"
+          "  Leading \\\n"
+          "  Continued  \n",
+          context->fp);
+    fwrite(allBytes, 1, sizeof allBytes, context->fp);
+    fputs("\nNo Ending ", context->fp);
+    fflush(context->fp);
+    rewind(context->fp);
+
+    reader = linereader_new(context->fp);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "Failed to create reader.\n");
+        return false;
+    }
+
+    length = linereader_getdelim(reader, &(context->line), &(context->len),
+                                 '\n',
+                                 LINEREADER_TRIM | LINEREADER_LOWERCASE);
+    success &= EXPECT_VAL((long) length, 12L, "%ld");
+    success &= EXPECT_STR(context->line, "key = value\n");
+
+    length = linereader_getdelim(reader, &(context->line), &(context->len),
+                                 '\n',
+                                 LINEREADER_TRIM | LINEREADER_STRIP_NEWLINE);
+    success &= EXPECT_VAL((long) length, 0L, "%ld");
+    success &= EXPECT_STR(context->line, "");
+
+    length = linereader_getdelim(reader, &(context->line), &(context->len),
+                                 '\n',
+                                 LINEREADER_TRIM
+                                 | LINEREADER_JOIN_CONTINUATIONS);
+    success &= EXPECT_STR(context->line, "Leading   Continued\n");
+
+    length = linereader_getdelim(reader, &(context->line), &(context->len),
+                                 '\n',
+                                 LINEREADER_LOWERCASE
+                                 | LINEREADER_STRIP_NEWLINE);
+    success &= EXPECT_VAL((long) length, (long) sizeof expectedBytes, "%ld");
+    success &= EXPECT(memcmp(context->line, expectedBytes,
+                             sizeof expectedBytes) == 0);
+
+    length = linereader_getdelim(reader, &(context->line), &(context->len),
+                                 '\n',
+                                 LINEREADER_TRIM | LINEREADER_STRIP_NEWLINE);
+    success &= EXPECT_STR(context->line, "No Ending");
+    linereader_free(reader);
+
+    /* CR removal. */
+    rewind(context->fp);
+    reader = linereader_new(context->fp);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "Failed to create reader.\n");
+        return false;
+    }
+
+    length = linereader_getdelim(reader, &(context->line), &(context->len),
+                                 '\n', LINEREADER_STRIP_CR);
+    success &= EXPECT_STR(context->line, "  Key = VALUE \t\n");
+
+    length = linereader_getdelim(reader, &(context->line), &(context->len),
+                                 LINEREADER_UNIV, LINEREADER_STRIP_CR);
+    success &= EXPECT_STR(context->line, "\t \n");
+
+    length = linereader_getdelim(reader, &(context->line), &(context->len),
+                                 LINEREADER_UNIV, 0);
+    success &= EXPECT_STR(context->line, "  Leading \\\n");
+
+    linereader_free(reader);
+    return success;
+}
+
+
+/** write_prefixed_record
+  *
+  *     Writes a record of `length` copies of `c` preceded by its length in the
+  *     specified `LINERECORD_` framing.
+  */
+static void
+write_prefixed_record(FILE* fp, int framing, size_t length, char c)
+{
+    size_t i;
+    if (framing == LINERECORD_BE32)
+    {
+        fputc((int) ((length >> 24) & 0xFF), fp);
+        fputc((int) ((length >> 16) & 0xFF), fp);
+        fputc((int) ((length >> 8) & 0xFF), fp);
+        fputc((int) (length & 0xFF), fp);
+    }
+    else
+    {
+        size_t value = length;
+        while (value >= 0x80)
+        {
+            fputc((int) ((value & 0x7F) | 0x80), fp);
+            value >>= 7;
+        }
+        fputc((int) value, fp);
+    }
+
+    for (i = 0; i < length; i++)
+    {
+        fputc(c, fp);
+    }
+}
+
+
+static bool
+test_linereader_next_record(TestContext* context)
+{
+    bool success = true;
+    LineReader* reader;
+    const char* record;
+    ssize_t length;
+    LineView views[4];
+    int framing;
+    size_t i;
+
+    static const size_t lengths[] = { 0, 1, 127, 128, 300, 3, 16384 };
+
+    fputs("AAAABBBBCCCCDD", context->fp);
+    fflush(context->fp);
+    rewind(context->fp);
+
+    reader = linereader_new(context->fp);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "Failed to create reader.\n");
+        return false;
+    }
+
+    for (i = 0; i < 3; i++)
+    {
+        length = linereader_next_record(reader, &record, LINERECORD_FIXED, 4);
+        success &= EXPECT_VAL((long) length, 4L, "%ld");
+        success &= EXPECT(length == 4 && record[0] == (char) ('A' + i));
+    }
+
+    /* The last record is incomplete. */
+    errno = 0;
+    length = linereader_next_record(reader, &record, LINERECORD_FIXED, 4);
+    success &= EXPECT_VAL((long) length, -1L, "%ld");
+    success &= EXPECT(errno == EILSEQ);
+    linereader_free(reader);
+
+    for (framing = LINERECORD_BE32; framing <= LINERECORD_VARINT; framing++)
+    {
+        size_t numRecords = 0;
+
+        /* Use a separate file per framing since files can't be truncated. */
+        FILE* fp = tmpfile();
+        if (fp == NULL)
+        {
+            fprintf(stderr, "Failed to create temporary file.\n");
+            return false;
+        }
+
+        for (i = 0; i < ARRAY_LENGTH(lengths); i++)
+        {
+            write_prefixed_record(fp, framing, lengths[i],
+                                  (char) ('a' + i));
+        }
+        fflush(fp);
+        rewind(fp);
+
+        reader = linereader_new(fp);
+        if (reader == NULL)
+        {
+            fprintf(stderr, "Failed to create reader.\n");
+            fclose(fp);
+            return false;
+        }
+
+        while (success)
+        {
+            ssize_t count = linereader_next_records(reader, views,
+                                                    ARRAY_LENGTH(views),
+                                                    framing, 1 << 20);
+            ssize_t j;
+            if (count < 0)
+            {
+                break;
+            }
+
+            for (j = 0; j < count; j++, numRecords++)
+            {
+                size_t k;
+                bool matches = true;
+                if (!EXPECT(numRecords < ARRAY_LENGTH(lengths)))
+                {
+                    success = false;
+                    break;
+                }
+
+                success &= EXPECT_VAL((unsigned long) views[j].length,
+                                      (unsigned long) lengths[numRecords],
+                                      "%lu");
+                for (k = 0; k < views[j].length; k++)
+                {
+                    matches &= (views[j].data[k] == (char) ('a' + numRecords));
+                }
+                success &= EXPECT(matches);
+            }
+        }
+
+        success &= EXPECT_VAL((unsigned long) numRecords,
+                              (unsigned long) ARRAY_LENGTH(lengths), "%lu");
+        success &= EXPECT(feof(fp));
+        linereader_free(reader);
+
+        /* Records longer than the limit are rejected. */
+        rewind(fp);
+        reader = linereader_new(fp);
+        if (reader == NULL)
+        {
+            fprintf(stderr, "Failed to create reader.\n");
+            fclose(fp);
+            return false;
+        }
+
+        for (i = 0; i < 4; i++)
+        {
+            length = linereader_next_record(reader, &record, framing, 200);
+            success &= EXPECT_VAL((long) length, (long) lengths[i], "%ld");
+        }
+        errno = 0;
+        length = linereader_next_record(reader, &record, framing, 200);
+        success &= EXPECT_VAL((long) length, -1L, "%ld");
+        success &= EXPECT(errno == EOVERFLOW);
+
+        /* The long record is skipped, so the next call returns the record
+         * after it.
+         */
+        length = linereader_next_record(reader, &record, framing, 200);
+        success &= EXPECT_VAL((long) length, 3L, "%ld");
+        success &= EXPECT(length == 3 && record[0] == 'f');
+
+        errno = 0;
+        length = linereader_next_record(reader, &record, framing, 200);
+        success &= EXPECT_VAL((long) length, -1L, "%ld");
+        success &= EXPECT(errno == EOVERFLOW);
+
+        length = linereader_next_record(reader, &record, framing, 200);
+        success &= EXPECT_VAL((long) length, -1L, "%ld");
+        success &= EXPECT(feof(fp));
+        linereader_free(reader);
+
+        /* A batch stops before a long record, which is reported by the next
+         * call.
+         */
+        rewind(fp);
+        reader = linereader_new(fp);
+        if (reader == NULL)
+        {
+            fprintf(stderr, "Failed to create reader.\n");
+            fclose(fp);
+            return false;
+        }
+
+        numRecords = 0;
+        while (numRecords < 4)
+        {
+            ssize_t count = linereader_next_records(reader, views,
+                                                    ARRAY_LENGTH(views),
+                                                    framing, 200);
+            if (!EXPECT(count > 0))
+            {
+                success = false;
+                break;
+            }
+            numRecords += (size_t) count;
+        }
+        success &= EXPECT_VAL((unsigned long) numRecords, 4UL, "%lu");
+
+        errno = 0;
+        success &= EXPECT(linereader_next_records(reader, views,
+                                                  ARRAY_LENGTH(views),
+                                                  framing, 200) == -1);
+        success &= EXPECT(errno == EOVERFLOW);
+        success &= EXPECT(linereader_next_records(reader, views,
+                                                  ARRAY_LENGTH(views),
+                                                  framing, 200) == 1);
+        success &= EXPECT(views[0].length == 3 && views[0].data[0] == 'f');
+        linereader_free(reader);
+        fclose(fp);
+    }
+
+    return success;
+}
+
+
+static bool
+test_linereader_stats(TestContext* context)
+{
+    bool success = true;
+    LineReader* reader;
+    LineReaderStats stats;
+    const char* line;
+    size_t i;
+
+    fputs("a\r\nbb\n\nccc\r\n", context->fp);
+    for (i = 0; i < 300; i++)
+    {
+        fputc('x', context->fp);
+    }
+    fputc('\n', context->fp);
+    fflush(context->fp);
+    rewind(context->fp);
+
+    reader = linereader_new(context->fp);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "Failed to create reader.\n");
+        return false;
+    }
+
+    while (linereader_next(reader, &line, LINEREADER_UNIV) >= 0)
+    {
+    }
+
+#ifdef LINEREADER_STATS
+    success &= EXPECT(linereader_get_stats(reader, &stats) == 0);
+    success &= EXPECT_VAL((unsigned long) stats.lines, 5UL, "%lu");
+    success &= EXPECT_VAL((unsigned long) stats.lineBytes, 313UL, "%lu");
+    success &= EXPECT_VAL((unsigned long) stats.maxLineLength, 301UL, "%lu");
+    success &= EXPECT_VAL((unsigned long) stats.bytesRead, 313UL, "%lu");
+    success &= EXPECT_VAL((unsigned long) stats.crlfLineEndings, 2UL, "%lu");
+    success &= EXPECT(stats.refills > 0 && stats.reads > stats.refills);
+
+    /* Lengths 1, 3, 3, 5, and 301. */
+    success &= EXPECT_VAL((unsigned long) stats.lengthHistogram[1], 1UL,
+                          "%lu");
+    success &= EXPECT_VAL((unsigned long) stats.lengthHistogram[2], 2UL,
+                          "%lu");
+    success &= EXPECT_VAL((unsigned long) stats.lengthHistogram[3], 1UL,
+                          "%lu");
+    success &= EXPECT_VAL((unsigned long) stats.lengthHistogram[9], 1UL,
+                          "%lu");
+
+#ifndef NDEBUG
+    /* Debug builds start with a small buffer. */
+    success &= EXPECT(stats.reallocs > 0 && stats.bytesMoved > 0);
+#endif
+#else
+    errno = 0;
+    success &= EXPECT(linereader_get_stats(reader, &stats) == -1);
+    #ifdef ENOSYS
+        success &= EXPECT(errno == ENOSYS);
+    #endif
+#endif /* LINEREADER_STATS */
+
+    linereader_free(reader);
+    return success;
+}
+
+
+static bool
+test_linereader_low_latency(TestContext* context)
+{
+    bool success = true;
+    LineReader* reader;
+    const char* line;
+    ssize_t length;
+    size_t offset = 0;
+    size_t numLines = 0;
+    int pass;
+
+    size_t lineCounts[2] = { 0, 0 };
+    size_t byteCounts[2] = { 0, 0 };
+
+    write_random_lines(context->fp, 200, false);
+
+    reader = linereader_new(context->fp);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "Failed to create reader.\n");
+        return false;
+    }
+    success &= EXPECT(linereader_set_low_latency(reader, '\n') == 0);
+
+    /* Nothing past the end of each line should have been read. */
+    while (success && (length = linereader_next(reader, &line, '\n')) >= 0)
+    {
+        offset += (size_t) length;
+        numLines++;
+        success &= EXPECT_VAL(ftell(context->fp), (long) offset, "%ld");
+    }
+    success &= EXPECT_VAL((unsigned long) numLines, 200UL, "%lu");
+    linereader_free(reader);
+
+    /* Append lines with mixed line endings.  Universal newlines must produce
+     * the same lines as block reads.
+     */
+    write_random_lines(context->fp, 200, true);
+    for (pass = 0; pass < 2 && success; pass++)
+    {
+        rewind(context->fp);
+        reader = linereader_new(context->fp);
+        if (reader == NULL)
+        {
+            fprintf(stderr, "Failed to create reader.\n");
+            return false;
+        }
+        if (pass == 0)
+        {
+            success &= EXPECT(
+                linereader_set_low_latency(reader, LINEREADER_UNIV) == 0);
+        }
+
+        while ((length = linereader_next(reader, &line, LINEREADER_UNIV)) >= 0)
+        {
+            lineCounts[pass]++;
+            byteCounts[pass] += (size_t) length;
+        }
+        linereader_free(reader);
+    }
+    success &= EXPECT_VAL((unsigned long) lineCounts[0],
+                          (unsigned long) lineCounts[1], "%lu");
+    success &= EXPECT_VAL((unsigned long) byteCounts[0],
+                          (unsigned long) byteCounts[1], "%lu");
+
+    return success;
+}
+
+
+#ifdef TEST_POSIX
+/** test_low_latency_records
+  *
+  *     Reads CSV and NDJSON records from a non-blocking pipe in low-latency
+  *     mode.  Records are shorter than the readers' 64-byte blocks, so a
+  *     reader that waited for a whole block would fail with `EAGAIN`.
+  */
+static bool
+test_low_latency_records(TestContext* context)
+{
+    bool success = true;
+    int pass;
+
+    (void) context;
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        static const char* inputs[] = {
+            "a,b\n\"x\ny\",z\n",
+            "{\"a\":1}\n[2]\n"
+        };
+        LineFields fields = LINEFIELDS_INIT;
+        LineReader* reader = NULL;
+        const char* record;
+        ssize_t length;
+        FILE* fp = NULL;
+        int fds[2];
+        int valid = 0;
+
+        if (pipe(fds) != 0)
+        {
+            fprintf(stderr, "Failed to create pipe.\n");
+            return false;
+        }
+        success &= EXPECT(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+        success &= EXPECT(write(fds[1], inputs[pass], strlen(inputs[pass]))
+                          == (ssize_t) strlen(inputs[pass]));
+
+        fp = fdopen(fds[0], "rb");
+        reader = (fp == NULL) ? NULL : linereader_new(fp);
+        if (reader == NULL)
+        {
+            fprintf(stderr, "Failed to create reader.\n");
+            success = false;
+            goto next;
+        }
+        success &= EXPECT(linereader_set_low_latency(reader, '\n') == 0);
+
+        if (pass == 0)
+        {
+            length = linereader_next_csv(reader, &record, ',', &fields);
+            success &= EXPECT_VAL((long) length, 4L, "%ld");
+            success &= EXPECT(fields.count == 2);
+
+            /* A quoted newline does not end the record. */
+            length = linereader_next_csv(reader, &record, ',', &fields);
+            success &= EXPECT_VAL((long) length, 8L, "%ld");
+            success &= EXPECT(fields.count == 2);
+        }
+        else
+        {
+            length = linereader_next_ndjson(reader, &record, 0, &valid);
+            success &= EXPECT_VAL((long) length, 8L, "%ld");
+            success &= EXPECT(valid);
+
+            length = linereader_next_ndjson(reader, &record, 0, &valid);
+            success &= EXPECT_VAL((long) length, 4L, "%ld");
+            success &= EXPECT(valid);
+        }
+
+    next:
+        linereader_free(reader);
+        linefields_free(&fields);
+        if (fp != NULL)
+        {
+            fclose(fp);
+        }
+        else
+        {
+            close(fds[0]);
+        }
+        close(fds[1]);
+    }
+
+    return success;
+}
+#endif /* TEST_POSIX */
+
+
+/** column_is_aligned
+  *
+  * RETURNS:
+  *     Returns true if the buffers of `column` are suitably aligned.
+  */
+static bool
+column_is_aligned(const LineColumn* column)
+{
+    const void* offsets = (column->offsets32 != NULL)
+                          ? (const void*) column->offsets32
+                          : (const void*) column->offsets64;
+    return    (uintptr_t) column->data % LINECOLUMN_ALIGNMENT == 0
+           && (uintptr_t) offsets % LINECOLUMN_ALIGNMENT == 0
+           && column->dataCapacity % LINECOLUMN_ALIGNMENT == 0
+           && column->offsetsCapacity % LINECOLUMN_ALIGNMENT == 0;
+}
+
+
+static bool
+test_linereader_next_column(TestContext* context)
+{
+    bool success = true;
+    static const int offsetWidths[] = { LINECOLUMN_INT32, LINECOLUMN_INT64 };
+    static const char* lineEndings[] = { "\n", "\r", "\r\n" };
+    size_t i;
+
+    /* Line `k` is `k % 13` copies of a letter, and the final line is
+     * unterminated.
+     */
+    for (i = 0; i < 500; i++)
+    {
+        size_t j;
+        for (j = 0; j < i % 13; j++)
+        {
+            fputc('a' + (int) (i % 26), context->fp);
+        }
+        if (i + 1 < 500)
+        {
+            fputs(lineEndings[i % ARRAY_LENGTH(lineEndings)], context->fp);
+        }
+    }
+    fflush(context->fp);
+
+    for (i = 0; i < ARRAY_LENGTH(offsetWidths); i++)
+    {
+        LineColumn column;
+        LineReader* reader;
+        size_t numLines = 0;
+        ssize_t count;
+        const char* data = NULL;
+
+        rewind(context->fp);
+        if (linecolumn_init(&column, offsetWidths[i]) != 0)
+        {
+            fprintf(stderr, "Out of memory.\n");
+            return false;
+        }
+        reader = linereader_new(context->fp);
+        if (reader == NULL)
+        {
+            fprintf(stderr, "Out of memory.\n");
+            linecolumn_free(&column);
+            return false;
+        }
+
+        success &= EXPECT(column_is_aligned(&column));
+        success &= EXPECT(column.count == 0);
+        success &= EXPECT(  (offsetWidths[i] == LINECOLUMN_INT32)
+                          ? column.offsets32[0] == 0
+                          : column.offsets64[0] == 0);
+
+        while (   success
+               && (count = linereader_next_column(reader, &column, 7,
+                                                  LINEREADER_UNIV)) > 0)
+        {
+            size_t j;
+
+            success &= EXPECT(count <= 7);
+            success &= EXPECT(column.count == (size_t) count);
+            success &= EXPECT(column_is_aligned(&column));
+
+            for (j = 0; j < column.count; j++, numLines++)
+            {
+                size_t valueLength;
+                const char* value = linecolumn_value(&column, j,
+                                                     &valueLength);
+                size_t k;
+
+                success &= EXPECT_VAL((unsigned long) valueLength,
+                                      (unsigned long) (numLines % 13), "%lu");
+                for (k = 0; k < valueLength; k++)
+                {
+                    success &= EXPECT(value[k]
+                                      == 'a' + (int) (numLines % 26));
+                }
+            }
+
+            success &= EXPECT(  (offsetWidths[i] == LINECOLUMN_INT32)
+                              ? (size_t) column.offsets32[column.count]
+                                == column.length
+                              : (size_t) column.offsets64[column.count]
+                                == column.length);
+            linecolumn_reset(&column);
+        }
+        success &= EXPECT(feof(context->fp));
+        success &= EXPECT_VAL((unsigned long) numLines, 500UL, "%lu");
+
+        /* Once a column has grown, resetting it reuses its memory. */
+        rewind(context->fp);
+        linereader_reset(reader, context->fp);
+        linecolumn_reset(&column);
+        success &= EXPECT(linereader_next_column(reader, &column, 500,
+                                                 LINEREADER_UNIV) == 500);
+        data = column.data;
+        linecolumn_reset(&column);
+        rewind(context->fp);
+        linereader_reset(reader, context->fp);
+        success &= EXPECT(linereader_next_column(reader, &column, 250,
+                                                 LINEREADER_UNIV) == 250);
+        success &= EXPECT(column.data == data);
+
+        linereader_free(reader);
+        linecolumn_free(&column);
+    }
+
+    return success;
+}
+
+
+static bool
+test_linereader_next_interned(TestContext* context)
+{
+    bool success = true;
+    LineInterner* interner = NULL;
+    LineInterner* reference = NULL;
+    LineReader* reader = NULL;
+    const char* first;
+    const char* line;
+    size_t length;
+    size_t handle;
+    size_t i;
+
+    static const char* lines[] = {
+        "a\n", "bb\n", "a\n", "\n", "0123456789abcdefghij\n", "bb\n",
+        "a\n", "0123456789abcdefghij"
+    };
+    static const size_t expectedHandles[] = { 0, 1, 0, 2, 3, 1, 0, 3 };
+
+    for (i = 0; i < ARRAY_LENGTH(lines); i++)
+    {
+        fputs(lines[i], context->fp);
+    }
+    fflush(context->fp);
+    rewind(context->fp);
+
+    interner = lineinterner_new();
+    reference = lineinterner_new();
+    reader = linereader_new(context->fp);
+    if (interner == NULL || reference == NULL || reader == NULL)
+    {
+        fprintf(stderr, "Out of memory.\n");
+        success = false;
+        goto exit;
+    }
+
+    for (i = 0; i < ARRAY_LENGTH(lines); i++)
+    {
+        size_t expectedLength = strlen(lines[i]);
+        if (lines[i][expectedLength - 1] == '\n')
+        {
+            expectedLength--;
+        }
+
+        success &= EXPECT_VAL((long) linereader_next_interned(reader,
+                                                              interner, '\n',
+                                                              &handle),
+                              (long) expectedLength, "%ld");
+        success &= EXPECT_VAL((unsigned long) handle,
+                              (unsigned long) expectedHandles[i], "%lu");
+    }
+    success &= EXPECT(linereader_next_interned(reader, interner, '\n',
+                                               &handle) == -1);
+    success &= EXPECT(feof(context->fp));
+
+    success &= EXPECT_VAL((unsigned long) lineinterner_size(interner), 4UL,
+                          "%lu");
+    success &= EXPECT_VAL((unsigned long) lineinterner_count(interner, 0), 3UL,
+                          "%lu");
+    success &= EXPECT_VAL((unsigned long) lineinterner_count(interner, 1), 2UL,
+                          "%lu");
+    success &= EXPECT_VAL((unsigned long) lineinterner_count(interner, 2), 1UL,
+                          "%lu");
+    success &= EXPECT_VAL((unsigned long) lineinterner_count(interner, 3), 2UL,
+                          "%lu");
+
+    line = lineinterner_line(interner, 2, &length);
+    success &= EXPECT(length == 0);
+    line = lineinterner_line(interner, 3, &length);
+    success &= EXPECT(   length == 20
+                      && memcmp(line, "0123456789abcdefghij", 20) == 0);
+
+    /* Lines added directly are hashed the same way. */
+    success &= EXPECT(lineinterner_add(interner, "bb", 2, &handle) == 0);
+    success &= EXPECT(handle == 1);
+    success &= EXPECT(lineinterner_count(interner, 1) == 3);
+    success &= EXPECT(lineinterner_add(interner, "0123456789abcdefghij", 20,
+                                       NULL) == 0);
+    success &= EXPECT(lineinterner_count(interner, 3) == 3);
+
+    /* Handles and line data stay put as the interner grows. */
+    first = lineinterner_line(interner, 0, &length);
+    for (i = 0; i < 1000 && success; i++)
+    {
+        char buffer[32];
+        sprintf(buffer, "line %lu", (unsigned long) i);
+        success &= EXPECT(lineinterner_add(interner, buffer, strlen(buffer),
+                                           &handle) == 0);
+        success &= EXPECT(handle == 4 + i);
+    }
+    success &= EXPECT(lineinterner_line(interner, 0, &length) == first);
+    success &= EXPECT(length == 1 && first[0] == 'a');
+    success &= EXPECT(lineinterner_size(interner) == 1004);
+
+    /* Compare against interning lines from `linereader_next` on random
+     * lines, which exercises scanning across refills.
+     */
+    lineinterner_free(interner);
+    interner = lineinterner_new();
+    if (interner == NULL)
+    {
+        fprintf(stderr, "Out of memory.\n");
+        success = false;
+        goto exit;
+    }
+
+    rewind(context->fp);
+    write_random_lines(context->fp, 300, false);
+    fputs("\n\n\n", context->fp);
+    write_random_lines(context->fp, 300, false);
+    fflush(context->fp);
+
+    for (i = 0; i < 2; i++)
+    {
+        ssize_t result;
+
+        rewind(context->fp);
+        linereader_reset(reader, context->fp);
+        while ((result = linereader_next(reader, &line, '\n')) >= 0)
+        {
+            size_t expected;
+            size_t contentLength = (size_t) result;
+            if (contentLength > 0 && line[contentLength - 1] == '\n')
+            {
+                contentLength--;
+            }
+            success &= EXPECT(lineinterner_add(reference, line, contentLength,
+                                               &expected) == 0);
+        }
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+        rewind(context->fp);
+        linereader_reset(reader, context->fp);
+        while (linereader_next_interned(reader, interner, '\n', &handle) >= 0)
+        {
+        }
+    }
+    success &= EXPECT(feof(context->fp));
+    success &= EXPECT_VAL((unsigned long) lineinterner_size(interner),
+                          (unsigned long) lineinterner_size(reference), "%lu");
+    for (i = 0; i < lineinterner_size(interner) && success; i++)
+    {
+        size_t referenceLength;
+        const char* referenceLine = lineinterner_line(reference, i,
+                                                      &referenceLength);
+        line = lineinterner_line(interner, i, &length);
+        success &= EXPECT(   length == referenceLength
+                          && memcmp(line, referenceLine, length) == 0);
+        success &= EXPECT(lineinterner_count(interner, i)
+                          == lineinterner_count(reference, i));
+    }
+
+exit:
+    linereader_free(reader);
+    lineinterner_free(reference);
+    lineinterner_free(interner);
+    return success;
+}
+
+
+#ifdef TEST_POSIX
+static bool
+test_linechunk(TestContext* context)
+{
+    bool success = true;
+    char path[] = "/tmp/getline-test-XXXXXX";
+    char* contents = NULL;
+    char* joined = NULL;
+    size_t contentsLength = 0;
+    size_t i;
+    FILE* fp = NULL;
+    int fd;
+
+    static const size_t chunkSizes[] = { 1, 2, 7, 64, 1000, 100000 };
+
+    write_random_lines(context->fp, 300, false);
+    fseek(context->fp, 0, SEEK_END);
+    fputc('\n', context->fp);
+    for (i = 0; i < 500; i++)
+    {
+        fputc('y', context->fp);
+    }
+    fputs("\nunterminated", context->fp);
+    fflush(context->fp);
+    contentsLength = (size_t) ftell(context->fp);
+    rewind(context->fp);
+
+    fd = mkstemp(path);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to create temporary file.\n");
+        return false;
+    }
+    fp = fdopen(fd, "wb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Failed to open temporary file.\n");
+        close(fd);
+        success = false;
+        goto exit;
+    }
+
+    contents = malloc(contentsLength + 1);
+    joined = malloc(contentsLength + 1);
+    if (contents == NULL || joined == NULL)
+    {
+        fprintf(stderr, "Out of memory.\n");
+        success = false;
+        goto exit;
+    }
+    success &= EXPECT(fread(contents, 1, contentsLength, context->fp)
+                      == contentsLength);
+    fwrite(contents, 1, contentsLength, fp);
+    fclose(fp);
+    fp = NULL;
+
+    for (i = 0; i < ARRAY_LENGTH(chunkSizes) && success; i++)
+    {
+        LineChunker* chunker = linechunker_open(path, '\n', chunkSizes[i]);
+        LineChunk* workers[2] = { NULL, NULL };
+        size_t joinedLength = 0;
+        unsigned long expectedSequence = 0;
+        int turn = 0;
+
+        success &= EXPECT(chunker != NULL);
+        if (chunker == NULL)
+        {
+            break;
+        }
+        workers[0] = linechunk_new(chunker);
+        workers[1] = linechunk_new(chunker);
+        success &= EXPECT(workers[0] != NULL && workers[1] != NULL);
+
+        /* Alternate claims between two workers.  Concatenating the lines of
+         * every chunk in sequence order must reproduce the file.
+         */
+        while (success)
+        {
+            LineChunk* worker = workers[turn];
+            unsigned long sequence;
+            const char* line;
+            ssize_t length;
+            int claimed = linechunk_claim(worker, &sequence);
+
+            success &= EXPECT(claimed >= 0);
+            if (claimed <= 0)
+            {
+                break;
+            }
+            success &= EXPECT_VAL(sequence, expectedSequence, "%lu");
+            expectedSequence++;
+
+            while ((length = linechunk_next(worker, &line)) >= 0)
+            {
+                const char* found = memchr(line, '\n', (size_t) length);
+                success &= EXPECT(   found == NULL
+                                  || found == &line[length - 1]);
+                if (joinedLength + (size_t) length > contentsLength)
+                {
+                    success &= EXPECT(false);
+                    break;
+                }
+                memcpy(&joined[joinedLength], line, (size_t) length);
+                joinedLength += (size_t) length;
+            }
+            turn = !turn;
+        }
+
+        success &= EXPECT_VAL((unsigned long) joinedLength,
+                              (unsigned long) contentsLength, "%lu");
+        success &= EXPECT(   joinedLength != contentsLength
+                          || memcmp(joined, contents, contentsLength) == 0);
+
+        /* Every chunk has been claimed. */
+        success &= EXPECT(linechunk_claim(workers[0], NULL) == 0);
+
+        linechunk_free(workers[0]);
+        linechunk_free(workers[1]);
+        linechunker_close(chunker);
+    }
+
+    /* Data appended after opening is ignored, even by the chunk that holds
+     * the unterminated final line.
+     */
+    if (success)
+    {
+        LineChunker* chunker = linechunker_open(path, '\n', 7);
+        LineChunk* worker = (chunker == NULL) ? NULL : linechunk_new(chunker);
+        size_t joinedLength = 0;
+        int claimed;
+
+        success &= EXPECT(worker != NULL);
+        success &= append_to_file(path, " appended\nmore\n", false);
+
+        while (worker != NULL && (claimed = linechunk_claim(worker, NULL)) > 0)
+        {
+            const char* line;
+            ssize_t length;
+            while ((length = linechunk_next(worker, &line)) >= 0)
+            {
+                if (joinedLength + (size_t) length > contentsLength)
+                {
+                    success &= EXPECT(false);
+                    break;
+                }
+                memcpy(&joined[joinedLength], line, (size_t) length);
+                joinedLength += (size_t) length;
+            }
+        }
+
+        success &= EXPECT_VAL((unsigned long) joinedLength,
+                              (unsigned long) contentsLength, "%lu");
+        success &= EXPECT(   joinedLength != contentsLength
+                          || memcmp(joined, contents, contentsLength) == 0);
+
+        linechunk_free(worker);
+        linechunker_close(chunker);
+    }
+
+exit:
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+    free(contents);
+    free(joined);
+    remove(path);
+    return success;
+}
+#endif /* TEST_POSIX */
+
+
+#ifdef TEST_POSIX
+/** expect_long_line_failure
+  *
+  *     Creates a temporary file whose second line is 1 GiB long and calls
+  *     `callback` on its path in a child process whose address space is
+  *     limited, so that reading the line fails because memory cannot be
+  *     allocated for it.  The file is sparse and occupies no disk space.
+  *
+  *     Does nothing and succeeds if address space cannot be limited.
+  *
+  * RETURNS:
+  *     Returns true if `callback` returns true.
+  */
+static bool
+expect_long_line_failure(bool (*callback)(const char* path))
+{
+#ifdef TEST_MEMORY_LIMIT
+    static const char firstLine[] = "first\n";
+    const off_t fileSize = sizeof firstLine - 1 + ((off_t) 1 << 30);
+    const size_t headroom = (size_t) 384 << 20;
+    bool success = true;
+    char path[] = "/tmp/getline-test-XXXXXX";
+    pid_t pid;
+    int status;
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to create temporary file.\n");
+        return false;
+    }
+    if (   write(fd, firstLine, sizeof firstLine - 1)
+           != (ssize_t) (sizeof firstLine - 1)
+        || ftruncate(fd, fileSize) != 0)
+    {
+        fprintf(stderr, "Failed to write temporary file.\n");
+        close(fd);
+        remove(path);
+        return false;
+    }
+    close(fd);
+
+    fflush(NULL);
+    pid = fork();
+    if (pid == 0)
+    {
+        struct rlimit limit;
+        unsigned long numPages = 0;
+        FILE* statm = fopen("/proc/self/statm", "r");
+        if (statm == NULL || fscanf(statm, "%lu", &numPages) != 1)
+        {
+            _exit(2);
+        }
+        fclose(statm);
+
+        limit.rlim_cur = (rlim_t) numPages * (rlim_t) sysconf(_SC_PAGESIZE)
+                         + headroom;
+        limit.rlim_max = limit.rlim_cur;
+        if (setrlimit(RLIMIT_AS, &limit) != 0)
+        {
+            _exit(2);
+        }
+        success = callback(path);
+        fflush(NULL);
+        _exit(success ? 0 : 1);
+    }
+
+    success &= EXPECT(pid > 0);
+    if (pid > 0 && EXPECT(waitpid(pid, &status, 0) == pid))
+    {
+        success &= EXPECT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    else
+    {
+        success = false;
+    }
+    remove(path);
+    return success;
+#else
+    (void) callback;
+    return true;
+#endif
+}
+#endif /* TEST_POSIX */
+
+
+#ifdef TEST_POSIX
+typedef struct
+{
+    char* output;
+    size_t length;
+    size_t capacity;
+    size_t numBatches;
+    size_t failAfter;
+} PipeSinkState;
+
+
+static int
+uppercase_batch(const LineBatch* input, LineBatch* output, void* context)
+{
+    char buffer[256];
+    size_t i;
+    (void) context;
+
+    for (i = 0; i < input->count; i++)
+    {
+        size_t length;
+        const char* line = linebatch_line(input, i, &length);
+        size_t j;
+
+        assert(length <= sizeof buffer);
+        for (j = 0; j < length; j++)
+        {
+            buffer[j] = (char) toupper((unsigned char) line[j]);
+        }
+        if (linebatch_append(output, buffer, length) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+static int
+collect_batch(const LineBatch* batch, void* context)
+{
+    PipeSinkState* state = context;
+    size_t i;
+
+    state->numBatches++;
+    if (state->failAfter > 0 && state->numBatches >= state->failAfter)
+    {
+        errno = ERANGE;
+        return -1;
+    }
+
+    for (i = 0; i < batch->count; i++)
+    {
+        size_t length;
+        const char* line = linebatch_line(batch, i, &length);
+        if (state->length + length > state->capacity)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+        memcpy(&state->output[state->length], line, length);
+        state->length += length;
+    }
+    return 0;
+}
+
+
+/** prepare_uppercase_test
+  *
+  *     Writes `numLines` random lines to `fp` and rewinds it, and allocates
+  *     the output buffer of `state`.
+  *
+  * RETURNS:
+  *     Returns the contents of `fp` converted to uppercase, which the caller
+  *     must free, and stores its length in `expectedLength`.  Returns NULL
+  *     on failure.
+  */
+static char*
+prepare_uppercase_test(FILE* fp, size_t numLines, PipeSinkState* state,
+                       size_t* expectedLength)
+{
+    char* expected;
+    size_t i;
+
+    write_random_lines(fp, numLines, false);
+    fseek(fp, 0, SEEK_END);
+    *expectedLength = (size_t) ftell(fp);
+    rewind(fp);
+
+    memset(state, 0, sizeof *state);
+    state->capacity = *expectedLength;
+    state->output = malloc(*expectedLength + 1);
+    expected = malloc(*expectedLength + 1);
+    if (state->output == NULL || expected == NULL)
+    {
+        fprintf(stderr, "Out of memory.\n");
+        goto fail;
+    }
+
+    if (!EXPECT(fread(expected, 1, *expectedLength, fp) == *expectedLength))
+    {
+        goto fail;
+    }
+    for (i = 0; i < *expectedLength; i++)
+    {
+        expected[i] = (char) toupper((unsigned char) expected[i]);
+    }
+    rewind(fp);
+    return expected;
+
+fail:
+    free(state->output);
+    state->output = NULL;
+    free(expected);
+    return NULL;
+}
+
+
+static bool
+pipe_long_line(const char* path)
+{
+    bool success = true;
+    LinePipeOptions options;
+    PipeSinkState state;
+    char output[16];
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Failed to open %s.\n", path);
+        return false;
+    }
+
+    memset(&state, 0, sizeof state);
+    state.output = output;
+    state.capacity = sizeof output;
+
+    linepipe_init_options(&options);
+    options.sink = collect_batch;
+    options.sinkContext = &state;
+
+    errno = 0;
+    success &= EXPECT(linepipe_run(fp, &options) == -1);
+    success &= EXPECT(errno == ENOMEM);
+    fclose(fp);
+    return success;
+}
+
+
+/** test_linepipe_slow_writer
+  *
+  *     Runs a pipeline on a pipe whose writer pauses between lines for long
+  *     enough that idle stages go to sleep.
+  */
+static bool
+test_linepipe_slow_writer(void)
+{
+    static const char expected[] = "SLOW 0\nSLOW 1\nSLOW 2\n";
+    bool success = true;
+    LinePipeOptions options;
+    PipeSinkState state;
+    char output[sizeof expected];
+    int fds[2];
+    pid_t pid;
+    int status;
+    FILE* fp;
+
+    if (pipe(fds) != 0)
+    {
+        fprintf(stderr, "Failed to create pipe.\n");
+        return false;
+    }
+
+    fflush(NULL);
+    pid = fork();
+    if (pid == 0)
+    {
+        struct timespec delay;
+        int i;
+
+        close(fds[0]);
+        delay.tv_sec = 0;
+        delay.tv_nsec = 20000000;
+        for (i = 0; i < 3; i++)
+        {
+            char line[16];
+            int length = sprintf(line, "slow %d\n", i);
+            nanosleep(&delay, NULL);
+            if (write(fds[1], line, (size_t) length) != length)
+            {
+                _exit(1);
+            }
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+
+    fp = (pid > 0) ? fdopen(fds[0], "rb") : NULL;
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Failed to start writer.\n");
+        close(fds[0]);
+        return false;
+    }
+
+    memset(&state, 0, sizeof state);
+    state.output = output;
+    state.capacity = sizeof output;
+
+    linepipe_init_options(&options);
+    options.batchLines = 1;
+    options.transform = uppercase_batch;
+    options.sink = collect_batch;
+    options.sinkContext = &state;
+
+    success &= EXPECT(linepipe_run(fp, &options) == 0);
+    success &= EXPECT_VAL((unsigned long) state.length,
+                          (unsigned long) (sizeof expected - 1), "%lu");
+    success &= EXPECT(   state.length != sizeof expected - 1
+                      || memcmp(output, expected, state.length) == 0);
+    fclose(fp);
+
+    success &= EXPECT(waitpid(pid, &status, 0) == pid);
+    return success;
+}
+
+
+static bool
+test_linepipe(TestContext* context)
+{
+    bool success = true;
+    LinePipeOptions options;
+    PipeSinkState state;
+    char* expected;
+    size_t expectedLength;
+
+    expected = prepare_uppercase_test(context->fp, 500, &state,
+                                      &expectedLength);
+    if (expected == NULL)
+    {
+        return false;
+    }
+
+    linepipe_init_options(&options);
+    options.batchLines = 7;
+    options.queueDepth = 2;
+    options.transform = uppercase_batch;
+    options.sink = collect_batch;
+    options.sinkContext = &state;
+
+    success &= EXPECT(linepipe_run(context->fp, &options) == 0);
+    success &= EXPECT_VAL((unsigned long) state.length,
+                          (unsigned long) expectedLength, "%lu");
+    success &= EXPECT(   state.length != expectedLength
+                      || memcmp(state.output, expected, expectedLength) == 0);
+
+    /* A failing stage stops the pipeline and reports its error. */
+    rewind(context->fp);
+    state.length = 0;
+    state.numBatches = 0;
+    state.failAfter = 3;
+    options.transform = NULL;
+    errno = 0;
+    success &= EXPECT(linepipe_run(context->fp, &options) == -1);
+    success &= EXPECT(errno == ERANGE);
+    success &= EXPECT_VAL((unsigned long) state.numBatches, 3UL, "%lu");
+
+    /* A line too long to buffer fails the pipeline instead of ending it. */
+    success &= expect_long_line_failure(pipe_long_line);
+
+    /* Stages that run out of work sleep until a slow writer catches up. */
+    success &= test_linepipe_slow_writer();
+
+    free(state.output);
+    free(expected);
+    return success;
+}
+#endif /* TEST_POSIX */
+
+
+#ifdef TEST_POSIX
+static int
+uppercase_line(const char* line, size_t length, LineBatch* results,
+               void* context)
+{
+    char buffer[256];
+    volatile unsigned long spin = 0;
+    size_t i;
+    (void) context;
+
+    if (length >= 4 && memcmp(line, "FAIL", 4) == 0)
+    {
+        errno = ERANGE;
+        return -1;
+    }
+
+    /* Make some lines much slower than others so that batches finish out of
+     * order.
+     */
+    if (length > 0 && line[0] < 'A')
+    {
+        while (spin < 20000)
+        {
+            spin++;
+        }
+    }
+
+    assert(length <= sizeof buffer);
+    for (i = 0; i < length; i++)
+    {
+        buffer[i] = (char) toupper((unsigned char) line[i]);
+    }
+    return linebatch_append(results, buffer, length);
+}
+
+
+static bool
+parallel_long_line(const char* path)
+{
+    bool success = true;
+    LineParallelOptions options;
+    PipeSinkState state;
+    char output[16];
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Failed to open %s.\n", path);
+        return false;
+    }
+
+    memset(&state, 0, sizeof state);
+    state.output = output;
+    state.capacity = sizeof output;
+
+    lineparallel_init_options(&options);
+    options.numThreads = 2;
+    options.sink = collect_batch;
+    options.sinkContext = &state;
+
+    errno = 0;
+    success &= EXPECT(parallel_for_each_line(fp, uppercase_line, NULL,
+                                             &options) == -1);
+    success &= EXPECT(errno == ENOMEM);
+    fclose(fp);
+    return success;
+}
+
+
+/* The state of the window test in `test_parallel_for_each_line`. */
+typedef struct
+{
+    pthread_mutex_t lock;
+    size_t numLines;
+    size_t windowLines;
+    size_t numLinesWhileSlow;
+} WindowState;
+
+
+static size_t
+count_window_lines(WindowState* state)
+{
+    size_t numLines;
+    pthread_mutex_lock(&state->lock);
+    numLines = state->numLines;
+    pthread_mutex_unlock(&state->lock);
+    return numLines;
+}
+
+
+static int
+count_window_line(const char* line, size_t length, LineBatch* results,
+                  void* context)
+{
+    WindowState* state = context;
+    (void) results;
+
+    pthread_mutex_lock(&state->lock);
+    state->numLines++;
+    pthread_mutex_unlock(&state->lock);
+
+    /* Hold up a batch until the rest of the window is processed, and then
+     * a little longer to see whether any more batches are read.
+     */
+    if (length >= 4 && memcmp(line, "SLOW", 4) == 0)
+    {
+        struct timespec delay;
+        size_t i;
+
+        delay.tv_sec = 0;
+        delay.tv_nsec = 1000000;
+        for (i = 0;
+             i < 5000 && count_window_lines(state) < state->windowLines;
+             i++)
+        {
+            nanosleep(&delay, NULL);
+        }
+        delay.tv_nsec = 50000000;
+        nanosleep(&delay, NULL);
+        state->numLinesWhileSlow = count_window_lines(state);
+    }
+    return 0;
+}
+
+
+static bool
+test_parallel_for_each_line(TestContext* context)
+{
+    bool success = true;
+    LineParallelOptions options;
+    PipeSinkState state;
+    char* expected;
+    size_t expectedLength;
+    FILE* windowFile;
+    size_t i;
+
+    expected = prepare_uppercase_test(context->fp, 1000, &state,
+                                      &expectedLength);
+    if (expected == NULL)
+    {
+        return false;
+    }
+
+    lineparallel_init_options(&options);
+    options.numThreads = 4;
+    options.batchLines = 3;
+    options.window = 5;
+    options.sink = collect_batch;
+    options.sinkContext = &state;
+
+    success &= EXPECT(parallel_for_each_line(context->fp, uppercase_line,
+                                             NULL, &options) == 0);
+    success &= EXPECT_VAL((unsigned long) state.length,
+                          (unsigned long) expectedLength, "%lu");
+    success &= EXPECT(   state.length != expectedLength
+                      || memcmp(state.output, expected, expectedLength) == 0);
+
+    /* A failure stops processing, and only the results of the lines before
+     * the failing one's batch are passed on.  (The final line gains a
+     * newline, which is not compared.)
+     */
+    fseek(context->fp, 0, SEEK_END);
+    fputs("\nFAIL\nafter\n", context->fp);
+    fflush(context->fp);
+    rewind(context->fp);
+    state.length = 0;
+    state.capacity = expectedLength + 1;
+
+    errno = 0;
+    success &= EXPECT(parallel_for_each_line(context->fp, uppercase_line,
+                                             NULL, &options) == -1);
+    success &= EXPECT(errno == ERANGE);
+    success &= EXPECT(memcmp(state.output, expected,
+                             (state.length < expectedLength)
+                             ? state.length
+                             : expectedLength) == 0);
+
+    /* A line too long to buffer is a failure, not the end of the stream. */
+    success &= expect_long_line_failure(parallel_long_line);
+
+    /* A slow batch stops reading once the window is full. */
+    windowFile = tmpfile();
+    if (windowFile == NULL)
+    {
+        fprintf(stderr, "Failed to create temporary file.\n");
+        success = false;
+    }
+    else
+    {
+        WindowState windowState;
+
+        /* The slow line ends the first batch. */
+        for (i = 0; i < 100; i++)
+        {
+            if (i == options.batchLines - 1)
+            {
+                fputs("SLOW\n", windowFile);
+            }
+            else
+            {
+                fprintf(windowFile, "%lu\n", (unsigned long) i);
+            }
+        }
+        rewind(windowFile);
+
+        memset(&windowState, 0, sizeof windowState);
+        pthread_mutex_init(&windowState.lock, NULL);
+        windowState.windowLines = options.window * options.batchLines;
+        options.sink = NULL;
+
+        success &= EXPECT(parallel_for_each_line(windowFile,
+                                                 count_window_line,
+                                                 &windowState,
+                                                 &options) == 0);
+        success &= EXPECT_VAL((unsigned long) windowState.numLinesWhileSlow,
+                              (unsigned long) windowState.windowLines,
+                              "%lu");
+        success &= EXPECT_VAL((unsigned long) windowState.numLines, 100UL,
+                              "%lu");
+        pthread_mutex_destroy(&windowState.lock);
+        fclose(windowFile);
+    }
+
+    free(state.output);
+    free(expected);
+    return success;
+}
+#endif /* TEST_POSIX */
+
+
+#ifdef TEST_POSIX
+enum
+{
+    numIngestFiles = 12,
+    ingestLinesPerFile = 7
+};
+
+
+/* The state of each file in `test_for_each_line_in_files`.  Every file is
+ * read by a single thread, so only the counts of files being read, which
+ * are shared, need `ingestLock`.
+ */
+typedef struct
+{
+    size_t lines[numIngestFiles];
+    bool started[numIngestFiles];
+    bool done[numIngestFiles];
+    bool ordered;
+    size_t numReading;
+    size_t maxReading;
+} IngestState;
+
+static pthread_mutex_t ingestLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static int
+check_ingest_line(size_t file, const char* line, size_t length,
+                  void* context)
+{
+    IngestState* state = context;
+    char expected[64];
+    struct timespec delay;
+
+    if (file >= numIngestFiles)
+    {
+        state->ordered = false;
+        return 0;
+    }
+
+    sprintf(expected, "%lu:%lu\n", (unsigned long) file,
+            (unsigned long) state->lines[file]);
+    if (length != strlen(expected) || memcmp(line, expected, length) != 0)
+    {
+        if (length == 5 && memcmp(line, "FAIL\n", 5) == 0)
+        {
+            errno = ERANGE;
+            return -1;
+        }
+        state->ordered = false;
+    }
+    state->lines[file]++;
+
+    /* A file is open at least from its first line until it is done.  Lines
+     * are slow enough that workers read several files at once.
+     */
+    delay.tv_sec = 0;
+    delay.tv_nsec = 100000;
+    nanosleep(&delay, NULL);
+    if (!state->started[file])
+    {
+        state->started[file] = true;
+        pthread_mutex_lock(&ingestLock);
+        state->numReading++;
+        if (state->numReading > state->maxReading)
+        {
+            state->maxReading = state->numReading;
+        }
+        pthread_mutex_unlock(&ingestLock);
+    }
+    return 0;
+}
+
+
+static int
+mark_ingest_file_done(size_t file, void* context)
+{
+    IngestState* state = context;
+    if (file < numIngestFiles)
+    {
+        state->done[file] = true;
+        if (state->started[file])
+        {
+            pthread_mutex_lock(&ingestLock);
+            state->numReading--;
+            pthread_mutex_unlock(&ingestLock);
+        }
+    }
+    return 0;
+}
+
+
+static bool
+ingest_long_line(const char* path)
+{
+    bool success = true;
+    LineIngestOptions options;
+    IngestState state;
+
+    lineingest_init_options(&options);
+    options.numThreads = 1;
+    options.fileDone = mark_ingest_file_done;
+
+    memset(&state, 0, sizeof state);
+    errno = 0;
+    success &= EXPECT(for_each_line_in_files(&path, 1, check_ingest_line,
+                                             &state, &options) == -1);
+    success &= EXPECT(errno == ENOMEM);
+    success &= EXPECT(!state.done[0]);
+    return success;
+}
+
+
+static bool
+test_for_each_line_in_files(TestContext* context)
+{
+    bool success = true;
+    char paths[numIngestFiles][32];
+    const char* pathList[numIngestFiles + 1];
+    size_t numCreated = 0;
+    LineIngestOptions options;
+    IngestState state;
+    size_t i;
+    size_t j;
+
+    (void) context;
+
+    /* File `i` has `i * ingestLinesPerFile` lines, so the first is empty. */
+    for (numCreated = 0; numCreated < numIngestFiles; numCreated++)
+    {
+        FILE* fp;
+        int fd;
+
+        strcpy(paths[numCreated], "/tmp/getline-test-XXXXXX");
+        pathList[numCreated] = paths[numCreated];
+        fd = mkstemp(paths[numCreated]);
+        if (fd < 0)
+        {
+            fprintf(stderr, "Failed to create temporary file.\n");
+            success = false;
+            goto exit;
+        }
+        fp = fdopen(fd, "wb");
+        if (fp == NULL)
+        {
+            fprintf(stderr, "Failed to open temporary file.\n");
+            close(fd);
+            numCreated++;
+            success = false;
+            goto exit;
+        }
+        for (j = 0; j < numCreated * ingestLinesPerFile; j++)
+        {
+            fprintf(fp, "%lu:%lu\n", (unsigned long) numCreated,
+                    (unsigned long) j);
+        }
+        fclose(fp);
+    }
+
+    lineingest_init_options(&options);
+    options.numThreads = 3;
+    options.maxOpenFiles = 2;
+    options.fileDone = mark_ingest_file_done;
+
+    memset(&state, 0, sizeof state);
+    state.ordered = true;
+    success &= EXPECT(for_each_line_in_files(pathList, numIngestFiles,
+                                             check_ingest_line, &state,
+                                             &options) == 0);
+    success &= EXPECT(state.ordered);
+    for (i = 0; i < numIngestFiles; i++)
+    {
+        success &= EXPECT_VAL((unsigned long) state.lines[i],
+                              (unsigned long) (i * ingestLinesPerFile), "%lu");
+        success &= EXPECT(state.done[i]);
+    }
+    success &= EXPECT(state.maxReading >= 1);
+    success &= EXPECT(state.maxReading <= options.maxOpenFiles);
+
+    /* Defaults, and more open files than there are files. */
+    memset(&state, 0, sizeof state);
+    state.ordered = true;
+    success &= EXPECT(for_each_line_in_files(pathList, numIngestFiles,
+                                             check_ingest_line, &state,
+                                             NULL) == 0);
+    success &= EXPECT(state.ordered);
+    success &= EXPECT_VAL((unsigned long) state.lines[numIngestFiles - 1],
+                          (unsigned long) ((numIngestFiles - 1)
+                                           * ingestLinesPerFile),
+                          "%lu");
+
+    success &= EXPECT(for_each_line_in_files(NULL, 0, check_ingest_line,
+                                             &state, &options) == 0);
+
+    /* A file that cannot be opened stops the ingest. */
+    pathList[numIngestFiles] = pathList[0];
+    pathList[5] = "/nonexistent/getline-test";
+    memset(&state, 0, sizeof state);
+    errno = 0;
+    success &= EXPECT(for_each_line_in_files(pathList, numIngestFiles + 1,
+                                             check_ingest_line, &state,
+                                             &options) == -1);
+    success &= EXPECT(errno == ENOENT);
+    pathList[5] = paths[5];
+
+    /* So does a failing callback. */
+    success &= append_to_file(paths[3], "FAIL\n", false);
+    memset(&state, 0, sizeof state);
+    state.ordered = true;
+    errno = 0;
+    success &= EXPECT(for_each_line_in_files(pathList, numIngestFiles,
+                                             check_ingest_line, &state,
+                                             &options) == -1);
+    success &= EXPECT(errno == ERANGE);
+    success &= EXPECT(!state.done[3]);
+
+    /* So does a line too long to buffer. */
+    success &= expect_long_line_failure(ingest_long_line);
+
+exit:
+    for (i = 0; i < numCreated; i++)
+    {
+        remove(paths[i]);
+    }
+    return success;
+}
+#endif /* TEST_POSIX */
+
+
+int
+main(void)
+{
+    bool success = true;
+
+    size_t i;
+
+    #define ADD_TEST(testCallback) { #testCallback, testCallback }
+    struct
+    {
+        const char* description;
+        TestCallback callback;
+    } tests[] =
+    {
+        ADD_TEST(test_escape_string),
+        ADD_TEST(test_alloc_strcat),
+
+        ADD_TEST(test_getline_empty_file),
+        ADD_TEST(test_getline_single_terminated_line),
+        ADD_TEST(test_getline_multiple_terminated_lines),
+        ADD_TEST(test_getline_file_with_long_lines),
+        ADD_TEST(test_getline_file_without_newline),
+        ADD_TEST(test_getline_writes_into_existing_buffer),
+        ADD_TEST(test_getline_grows_existing_buffer),
+
+        ADD_TEST(test_getdelim_binary_data),
+        ADD_TEST(test_getdelimstr),
+        ADD_TEST(test_getdelim_bounded),
+        ADD_TEST(test_getdelim_sb),
+
+        ADD_TEST(test_fggets_single_terminated_line),
+        ADD_TEST(test_fggets_multiple_terminated_lines),
+        ADD_TEST(test_fggets_file_without_newline),
+
+        ADD_TEST(test_getline_univ_lf),
+        ADD_TEST(test_getline_univ_cr),
+        ADD_TEST(test_getline_univ_crlf),
+        ADD_TEST(test_getline_univ_without_newline),
+        ADD_TEST(test_fggets_univ_lf),
+        ADD_TEST(test_fggets_univ_cr),
+        ADD_TEST(test_fggets_univ_crlf),
+        ADD_TEST(test_fggets_univ_without_newline),
+
+        ADD_TEST(test_count_lines),
+        ADD_TEST(test_count_lines_univ),
+        ADD_TEST(test_skip_lines_lf),
+        ADD_TEST(test_skip_lines_univ),
+
+        ADD_TEST(test_linereader_next_univ),
+        ADD_TEST(test_linereader_next_fields),
+        ADD_TEST(test_linereader_next_csv),
+        ADD_TEST(test_linereader_next_str),
+        ADD_TEST(test_linereader_next_ndjson),
+        ADD_TEST(test_linereader_next_containing),
+        ADD_TEST(test_linereader_next_prefix),
+        ADD_TEST(test_linereader_getdelim_continuations),
+        ADD_TEST(test_linereader_getdelim_transforms),
+        ADD_TEST(test_linereader_next_record),
+        ADD_TEST(test_linereader_stats),
+        ADD_TEST(test_linereader_low_latency),
+        ADD_TEST(test_linereader_next_column),
+        ADD_TEST(test_linereader_next_interned),
+
+        ADD_TEST(test_lineindex_read_line_n),
+        ADD_TEST(test_lineindex_univ_extend),
+        ADD_TEST(test_lineindex_corrupt_header),
+
+        ADD_TEST(test_getline_rev),
+
+    #ifdef TEST_POSIX
+        ADD_TEST(test_getline_follow),
+        ADD_TEST(test_low_latency_records),
+        ADD_TEST(test_linechunk),
+        ADD_TEST(test_linepipe),
+        ADD_TEST(test_parallel_for_each_line),
+        ADD_TEST(test_for_each_line_in_files),
+    #endif
     };
     #undef ADD_TEST
 